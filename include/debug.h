@@ -1,70 +1,570 @@
 #ifndef DEBUG_H
 #define DEBUG_H
 
+#include <stdatomic.h>
 #include <stdint.h>
 #include <stdio.h>
-#include <string.h>
-#include <time.h>
+
+// debug.c is built into the dll, the tools link it in directly and build with
+// INPT_STATIC.
+#ifndef LIBINPT
+#if defined(DLL_EXPORT)
+#define LIBINPT __declspec(dllexport)
+#elif defined(INPT_STATIC)
+#define LIBINPT
+#else
+#define LIBINPT __declspec(dllimport)
+#endif
+#endif
+
+// thread locals can't be imported from a dll, outside of it the calling
+// thread's ring and shard are looked up through debug_ring_register and
+// debug_shard_register instead.
+#if defined(DLL_EXPORT) || defined(INPT_STATIC)
+#define DEBUG_THREAD_LOCAL
+#endif
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || \
+	defined(_M_IX86)
+#define DEBUG_HAS_TSC
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
+
+// Scoped profiler.
+//
+// DEBUG_TIME_START / DEBUG_TIME_STOP mark a zone. Every call site registers
+// itself once as a static zone id, after that a zone costs two timestamp reads
+// and one 24 byte write into a ring owned by the calling thread, no locks, no
+// strings and no printing. Timestamps are raw ticks (the TSC on x86) and are
+// only converted to nanoseconds when the rings are collected.
+//
+// debug_prof_collect drains the rings of every thread into per zone totals
+// and debug_prof_print prints them indented by nesting depth. Call them from
+// wherever printing doesn't hurt, like a background thread or the end of a
+// run. A ring that fills up before it is collected drops new events and
+// counts them, while a trace is running a background thread collects every
+// DEBUG_TRACE_COLLECT_MS so that only happens to very busy threads.
+//
+// DEBUG_MARK records an instant event, like a device being plugged in, that
+// shows up as a marker in traces.
+//
+// With tracing on, debug_prof_collect also keeps the last events it drained
+// so they can be written out as chrome trace event json (chrome://tracing,
+// ui.perfetto.dev) or as a compact binary trace that tools/trace.c turns into
+// json later.
+//
+// Metrics are always on, with or without DEBUG_TIME. DEBUG_COUNT, DEBUG_GAUGE
+// and DEBUG_HIST register a named counter, gauge or histogram the first time a
+// call site runs. Counters and histograms are written to a shard owned by the
+// calling thread with plain relaxed stores, so an update costs a few
+// nanoseconds and never contends, and debug_metrics_snapshot sums the shards
+// when something reads them. Histograms are log linear, DEBUG_HIST_SUB buckets
+// per power of two, which keeps any value within 25% of its bucket from 0 up
+// to UINT64_MAX in 252 buckets.
+//
+// DEBUG_LOG and its level shorthands never print on the calling thread. They
+// copy the format pointer and up to DEBUG_LOG_ARG_MAX arguments, tagged by
+// type with _Generic, into a lock-free ring, and a background thread started
+// by the first record formats them and writes them out. String arguments are
+// copied, so stack buffers are fine, other pointers have to be cast to void*.
+// Levels below DEBUG_LOG_LEVEL compile out and debug_log_level filters the
+// rest at runtime. A full ring drops records and counts them.
+
+#define DEBUG_PROF_ZONE_MAX 256
+#define DEBUG_PROF_THREAD_MAX 32
+// Events per thread. Must be a power of two.
+#define DEBUG_PROF_RING_COUNT 16384
+
+#define DEBUG_TRACE_MAGIC "DBGT"
+#define DEBUG_TRACE_VERSION 1
+// How often a running trace collects the rings.
+#define DEBUG_TRACE_COLLECT_MS 10
+
+// Records waiting to be written. Must be a power of two.
+#define DEBUG_LOG_RING_COUNT 1024
+#define DEBUG_LOG_ARG_MAX 8
+// Bytes of string arguments a record can hold, longer strings are cut.
+#define DEBUG_LOG_TEXT_MAX 128
+// Lowest level that is compiled in.
+#ifndef DEBUG_LOG_LEVEL
+#define DEBUG_LOG_LEVEL DEBUG_LOG_DEBUG
+#endif
+
+#define DEBUG_METRIC_COUNTER_MAX 64
+#define DEBUG_METRIC_GAUGE_MAX 32
+#define DEBUG_METRIC_HIST_MAX 16
+// Histogram buckets per power of two is 1 << DEBUG_HIST_SUB_BITS.
+#define DEBUG_HIST_SUB_BITS 2
+#define DEBUG_HIST_SUB (1 << DEBUG_HIST_SUB_BITS)
+#define DEBUG_HIST_BUCKETS ((64 - DEBUG_HIST_SUB_BITS + 1) * DEBUG_HIST_SUB)
+// Largest text debug_metrics_format writes for a full registry.
+#define DEBUG_METRICS_TEXT_MAX 16384
+
+enum debug_zone_kind_t {
+	DEBUG_ZONE_SCOPE = 0,
+	DEBUG_ZONE_MARK,
+};
+
+enum debug_log_level_t {
+	DEBUG_LOG_TRACE = 0,
+	DEBUG_LOG_DEBUG,
+	DEBUG_LOG_INFO,
+	DEBUG_LOG_WARN,
+	DEBUG_LOG_ERROR,
+	DEBUG_LOG_OFF,
+};
+
+enum debug_log_type_t {
+	DEBUG_LOG_I64 = 0,
+	DEBUG_LOG_U64,
+	DEBUG_LOG_F64,
+	DEBUG_LOG_STR,
+	DEBUG_LOG_PTR,
+};
+
+enum debug_trace_format_t {
+	DEBUG_TRACE_JSON = 0,
+	DEBUG_TRACE_BINARY,
+};
+
+typedef struct debug_log_arg_t {
+	enum debug_log_type_t type;
+	union {
+		int64_t		i;
+		uint64_t	u;
+		double		f;
+		const char* s;
+		const void* p;
+	};
+} debug_log_arg_t;
+
+typedef struct debug_event_t {
+	uint64_t start;
+	uint64_t end;
+	uint16_t zone;
+	uint16_t depth;
+	uint32_t thread;
+} debug_event_t;
+
+typedef struct debug_ring_t {
+	// written by the owning thread only.
+	atomic_uint_fast64_t head;
+	atomic_uint_fast64_t dropped;
+	// last tail seen, only reloaded when the ring looks full.
+	uint_fast64_t		 tail_cached;
+	int					 depth;
+	uint64_t			 last;
+	uint32_t			 thread;
+	const char*			 name;
+
+	// written by the collector only, kept off the producer's cache line.
+	_Alignas(64) atomic_uint_fast64_t tail;
+
+	debug_event_t events[DEBUG_PROF_RING_COUNT];
+} debug_ring_t;
+
+typedef struct debug_zone_t {
+	const char*			   name;
+	const char*			   file;
+	int					   line;
+	enum debug_zone_kind_t kind;
+
+	// filled in by debug_prof_collect, in ticks.
+	int		 depth;
+	uint64_t count;
+	uint64_t total;
+	uint64_t min;
+	uint64_t max;
+} debug_zone_t;
+
+// Metrics written by one thread. Threads past DEBUG_PROF_THREAD_MAX share one
+// shard and add atomically.
+typedef struct debug_shard_t {
+	int shared;
+
+	atomic_uint_fast64_t counters[DEBUG_METRIC_COUNTER_MAX];
+	struct {
+		atomic_uint_fast64_t sum;
+		atomic_uint_fast64_t buckets[DEBUG_HIST_BUCKETS];
+	} hists[DEBUG_METRIC_HIST_MAX];
+} debug_shard_t;
+
+typedef struct debug_hist_t {
+	uint64_t count;
+	uint64_t sum;
+	uint64_t buckets[DEBUG_HIST_BUCKETS];
+} debug_hist_t;
+
+// Every shard summed at one point in time.
+typedef struct debug_metrics_t {
+	int			 counter_count;
+	int			 gauge_count;
+	int			 hist_count;
+	uint64_t	 counters[DEBUG_METRIC_COUNTER_MAX];
+	int64_t		 gauges[DEBUG_METRIC_GAUGE_MAX];
+	debug_hist_t hists[DEBUG_METRIC_HIST_MAX];
+} debug_metrics_t;
 
 struct debug_t {
-	int	 max_name_size;
-	int	 cur_name_size;
-	char name_spacing_buffer[128];
-
-	struct debug_time_t {
-#define DEBUG_TIME_MESSAGE_LEVELS 16
-#define DEBUG_TIME_MESSAGE_MAX 128
-#define DEBUG_TIME_MESSAGE_LENGTH_MAX 256
-		int	 level;
-		char messages[DEBUG_TIME_MESSAGE_LEVELS][DEBUG_TIME_MESSAGE_MAX]
-					 [DEBUG_TIME_MESSAGE_LENGTH_MAX];
-		const char messge_popped[DEBUG_TIME_MESSAGE_LENGTH_MAX];
-
-		double last_ms;
-	} time;
-
-	double last_ms;
+	debug_zone_t zones[DEBUG_PROF_ZONE_MAX];
+	atomic_int	 zone_count;
+	atomic_flag	 zone_lock;
+
+	debug_ring_t* rings[DEBUG_PROF_THREAD_MAX];
+	atomic_int	  ring_count;
+
+	// ticks and nanoseconds at the first zone, to work out the tick rate.
+	uint64_t ticks_start;
+	uint64_t ns_start;
+
+	// metric registry, ids index the names and the shard arrays.
+	atomic_flag	 metric_lock;
+	const char*	 counter_names[DEBUG_METRIC_COUNTER_MAX];
+	atomic_int	 counter_count;
+	const char*	 gauge_names[DEBUG_METRIC_GAUGE_MAX];
+	atomic_int	 gauge_count;
+	atomic_int_fast64_t gauges[DEBUG_METRIC_GAUGE_MAX];
+	const char*	 hist_names[DEBUG_METRIC_HIST_MAX];
+	atomic_int	 hist_count;
+
+	debug_shard_t* shards[DEBUG_PROF_THREAD_MAX];
+	atomic_int	   shard_count;
+
+	// lowest level logged at runtime, DEBUG_LOG_INFO unless changed.
+	atomic_int log_level;
 };
 
-extern struct debug_t debug;
+extern LIBINPT struct debug_t debug;
+#ifdef DEBUG_THREAD_LOCAL
+extern _Thread_local debug_ring_t* debug_ring;
+extern _Thread_local debug_shard_t* debug_shard;
+#endif
+
+// Monotonic clock in nanoseconds.
+LIBINPT uint64_t debug_time_ns();
+LIBINPT uint64_t debug_ticks_to_ns(uint64_t ticks);
 
-long debug_time_now();
+// Returns the id of the zone at file:line, registering it the first time.
+LIBINPT int debug_zone(const char* name, const char* file, const int line,
+					   const enum debug_zone_kind_t kind);
+// Returns the calling thread's ring, registering it the first time.
+LIBINPT debug_ring_t* debug_ring_register();
+// Names the calling thread in traces. name has to outlive the trace.
+LIBINPT void debug_thread_name(const char* name);
 
-int	 debug_time_lvl();
-void debug_time_lvl_next();
-void debug_time_lvl_prev();
+// Drains every thread's ring into the zone totals, one thread at a time.
+// Returns the number of events drained.
+LIBINPT int	 debug_prof_collect();
+LIBINPT void debug_prof_print(FILE* file);
+LIBINPT void debug_prof_reset();
 
-void		debug_time_push(const char* msg);
-const char* debug_time_pop(int level);
+// Duration of the last zone the calling thread closed.
+LIBINPT double debug_time_last_ms();
 
-void   debug_time_set_last_ms(double ms);
-double debug_time_last_ms();
+// Keeps the last capacity events from every collect for a trace. If path
+// isn't NULL the trace is written there at exit, as binary unless it ends in
+// ".json".
+LIBINPT int	 debug_trace_start(const int capacity, const char* path);
+LIBINPT void debug_trace_stop();
+// Collects and writes the events kept so far.
+LIBINPT int debug_trace_write(const char*					  path,
+							  const enum debug_trace_format_t format);
+
+// Return the id of the metric called name, registering it the first time.
+// Past the maximum every new name shares the last id.
+LIBINPT int debug_counter(const char* name);
+LIBINPT int debug_gauge(const char* name);
+LIBINPT int debug_hist(const char* name);
+// Returns the calling thread's shard, registering it the first time.
+LIBINPT debug_shard_t* debug_shard_register();
+
+// Sums every thread's shard into snapshot.
+LIBINPT void debug_metrics_snapshot(debug_metrics_t* snapshot);
+// Value below which q of the recorded values fall, q from 0 to 1. Returns the
+// upper bound of the bucket the value is in.
+LIBINPT uint64_t debug_hist_quantile(const debug_hist_t* hist, const double q);
+// Writes snapshot as text, one "name value" line per counter and gauge and one
+// "name count sum p50 p90 p99 max" line per histogram. Returns the length
+// written, which is cut at the last whole line that fits in size.
+LIBINPT int debug_metrics_format(const debug_metrics_t* snapshot,
+								 char* buffer, const int size);
+LIBINPT int debug_metrics_print(FILE* file);
+
+// Sets the lowest level that is logged.
+LIBINPT void debug_log_level(const enum debug_log_level_t level);
+// Where the log goes, stderr unless changed.
+LIBINPT void debug_log_file(FILE* file);
+// Queues a record, use DEBUG_LOG instead.
+LIBINPT void debug_log_write(const enum debug_log_level_t level,
+							 const char* format, const debug_log_arg_t* args,
+							 const int arg_count);
+// Stops the background thread and writes every queued record, later records
+// are written right away on the calling thread. Runs at exit.
+LIBINPT void debug_log_stop();
+
+static inline uint64_t debug_ticks() {
+#ifdef DEBUG_HAS_TSC
+	return __rdtsc();
+#else
+	return debug_time_ns();
+#endif
+}
+
+static inline debug_ring_t* debug_ring_get() {
+#ifdef DEBUG_THREAD_LOCAL
+	return debug_ring != NULL ? debug_ring : debug_ring_register();
+#else
+	return debug_ring_register();
+#endif
+}
+
+static inline void debug_prof_write(debug_ring_t* ring, const int zone,
+									const uint64_t start, const uint64_t end) {
+	uint_fast64_t head =
+		atomic_load_explicit(&ring->head, memory_order_relaxed);
+	if(head - ring->tail_cached >= DEBUG_PROF_RING_COUNT) {
+		ring->tail_cached =
+			atomic_load_explicit(&ring->tail, memory_order_acquire);
+	}
+	if(head - ring->tail_cached >= DEBUG_PROF_RING_COUNT) {
+		atomic_store_explicit(
+			&ring->dropped,
+			atomic_load_explicit(&ring->dropped, memory_order_relaxed) + 1,
+			memory_order_relaxed);
+		return;
+	}
+
+	debug_event_t* event = &ring->events[head & (DEBUG_PROF_RING_COUNT - 1)];
+	event->start		 = start;
+	event->end			 = end;
+	event->zone			 = zone;
+	event->depth		 = ring->depth;
+	event->thread		 = ring->thread;
+
+	atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+static inline void debug_prof_record(debug_ring_t* ring, const int zone,
+									 const uint64_t start, const uint64_t end) {
+	ring->depth--;
+	ring->last = end - start;
+	debug_prof_write(ring, zone, start, end);
+}
+
+static inline debug_shard_t* debug_shard_get() {
+#ifdef DEBUG_THREAD_LOCAL
+	return debug_shard != NULL ? debug_shard : debug_shard_register();
+#else
+	return debug_shard_register();
+#endif
+}
+
+static inline void debug_metric_add(debug_shard_t*		  shard,
+									atomic_uint_fast64_t* value,
+									const uint64_t		  amount) {
+	if(shard->shared) {
+		atomic_fetch_add_explicit(value, amount, memory_order_relaxed);
+		return;
+	}
+
+	// only this thread writes value, the reader only needs it untorn.
+	atomic_store_explicit(
+		value, atomic_load_explicit(value, memory_order_relaxed) + amount,
+		memory_order_relaxed);
+}
+
+static inline void debug_counter_add(const int counter, const uint64_t amount) {
+	debug_shard_t* shard = debug_shard_get();
+	debug_metric_add(shard, &shard->counters[counter], amount);
+}
+
+static inline void debug_gauge_set(const int gauge, const int64_t value) {
+	atomic_store_explicit(&debug.gauges[gauge], value, memory_order_relaxed);
+}
+
+static inline int debug_hist_bucket(const uint64_t value) {
+	if(value < DEBUG_HIST_SUB) {
+		return (int) value;
+	}
+
+#if defined(__GNUC__) || defined(__clang__)
+	int top = 63 - __builtin_clzll(value);
+#else
+	int top = DEBUG_HIST_SUB_BITS;
+	while(top < 63 && (value >> (top + 1)) != 0) {
+		top++;
+	}
+#endif
+
+	return (top - DEBUG_HIST_SUB_BITS + 1) * DEBUG_HIST_SUB +
+		   (int) ((value >> (top - DEBUG_HIST_SUB_BITS)) &
+				  (DEBUG_HIST_SUB - 1));
+}
+
+static inline void debug_hist_record(const int hist, const uint64_t value) {
+	debug_shard_t* shard = debug_shard_get();
+	debug_metric_add(shard,
+					 &shard->hists[hist].buckets[debug_hist_bucket(value)], 1);
+	debug_metric_add(shard, &shard->hists[hist].sum, value);
+}
+
+#define DEBUG_METRIC_ID(id, reg, name) \
+	static _Atomic int id = -1;         \
+	if(id < 0) {                        \
+		id = reg(name);                 \
+	}
+
+#define DEBUG_COUNT(name, amount)                           \
+	{                                                       \
+		DEBUG_METRIC_ID(dbgm_counter, debug_counter, name); \
+		debug_counter_add(dbgm_counter, amount);            \
+	}
+
+#define DEBUG_GAUGE(name, value)                        \
+	{                                                   \
+		DEBUG_METRIC_ID(dbgm_gauge, debug_gauge, name); \
+		debug_gauge_set(dbgm_gauge, value);             \
+	}
+
+#define DEBUG_HIST(name, value)                       \
+	{                                                 \
+		DEBUG_METRIC_ID(dbgm_hist, debug_hist, name); \
+		debug_hist_record(dbgm_hist, value);          \
+	}
+
+static inline debug_log_arg_t debug_log_i64(const int64_t value) {
+	return (debug_log_arg_t){.type = DEBUG_LOG_I64, .i = value};
+}
+
+static inline debug_log_arg_t debug_log_u64(const uint64_t value) {
+	return (debug_log_arg_t){.type = DEBUG_LOG_U64, .u = value};
+}
+
+static inline debug_log_arg_t debug_log_f64(const double value) {
+	return (debug_log_arg_t){.type = DEBUG_LOG_F64, .f = value};
+}
+
+static inline debug_log_arg_t debug_log_str(const char* value) {
+	return (debug_log_arg_t){.type = DEBUG_LOG_STR, .s = value};
+}
+
+static inline debug_log_arg_t debug_log_ptr(const void* value) {
+	return (debug_log_arg_t){.type = DEBUG_LOG_PTR, .p = value};
+}
+
+#define DEBUG_LOG_ARG(x)                                                   \
+	_Generic((x),                                                          \
+		char*: debug_log_str,                                              \
+		const char*: debug_log_str,                                        \
+		void*: debug_log_ptr,                                              \
+		const void*: debug_log_ptr,                                        \
+		float: debug_log_f64,                                              \
+		double: debug_log_f64,                                             \
+		unsigned char: debug_log_u64,                                      \
+		unsigned short: debug_log_u64,                                     \
+		unsigned int: debug_log_u64,                                       \
+		unsigned long: debug_log_u64,                                      \
+		unsigned long long: debug_log_u64,                                 \
+		default: debug_log_i64)(x)
+
+// the format is the first argument so a record without arguments doesn't
+// need an empty __VA_ARGS__.
+#define DEBUG_LOG_CAT(a, b) DEBUG_LOG_CAT_(a, b)
+#define DEBUG_LOG_CAT_(a, b) a##b
+#define DEBUG_LOG_FORMAT(...) DEBUG_LOG_FORMAT_(__VA_ARGS__, ~)
+#define DEBUG_LOG_FORMAT_(format, ...) format
+#define DEBUG_LOG_COUNT(...) \
+	DEBUG_LOG_COUNT_(__VA_ARGS__, 8, 7, 6, 5, 4, 3, 2, 1, 0, ~)
+#define DEBUG_LOG_COUNT_(f, _1, _2, _3, _4, _5, _6, _7, _8, n, ...) n
+#define DEBUG_LOG_ARGS(...)                                     \
+	DEBUG_LOG_CAT(DEBUG_LOG_ARGS_, DEBUG_LOG_COUNT(__VA_ARGS__)) \
+	(__VA_ARGS__)
+
+#define DEBUG_LOG_ARGS_0(f) NULL, 0
+#define DEBUG_LOG_ARGS_1(f, a) (debug_log_arg_t[]){DEBUG_LOG_ARG(a)}, 1
+#define DEBUG_LOG_ARGS_2(f, a, b) \
+	(debug_log_arg_t[]){DEBUG_LOG_ARG(a), DEBUG_LOG_ARG(b)}, 2
+#define DEBUG_LOG_ARGS_3(f, a, b, c)                                  \
+	(debug_log_arg_t[]){DEBUG_LOG_ARG(a), DEBUG_LOG_ARG(b),           \
+						DEBUG_LOG_ARG(c)},                            \
+		3
+#define DEBUG_LOG_ARGS_4(f, a, b, c, d)                               \
+	(debug_log_arg_t[]){DEBUG_LOG_ARG(a), DEBUG_LOG_ARG(b),           \
+						DEBUG_LOG_ARG(c), DEBUG_LOG_ARG(d)},          \
+		4
+#define DEBUG_LOG_ARGS_5(f, a, b, c, d, e)                            \
+	(debug_log_arg_t[]){DEBUG_LOG_ARG(a), DEBUG_LOG_ARG(b),           \
+						DEBUG_LOG_ARG(c), DEBUG_LOG_ARG(d),           \
+						DEBUG_LOG_ARG(e)},                            \
+		5
+#define DEBUG_LOG_ARGS_6(f, a, b, c, d, e, g)                         \
+	(debug_log_arg_t[]){DEBUG_LOG_ARG(a), DEBUG_LOG_ARG(b),           \
+						DEBUG_LOG_ARG(c), DEBUG_LOG_ARG(d),           \
+						DEBUG_LOG_ARG(e), DEBUG_LOG_ARG(g)},          \
+		6
+#define DEBUG_LOG_ARGS_7(f, a, b, c, d, e, g, h)                      \
+	(debug_log_arg_t[]){DEBUG_LOG_ARG(a), DEBUG_LOG_ARG(b),           \
+						DEBUG_LOG_ARG(c), DEBUG_LOG_ARG(d),           \
+						DEBUG_LOG_ARG(e), DEBUG_LOG_ARG(g),           \
+						DEBUG_LOG_ARG(h)},                            \
+		7
+#define DEBUG_LOG_ARGS_8(f, a, b, c, d, e, g, h, i)                   \
+	(debug_log_arg_t[]){DEBUG_LOG_ARG(a), DEBUG_LOG_ARG(b),           \
+						DEBUG_LOG_ARG(c), DEBUG_LOG_ARG(d),           \
+						DEBUG_LOG_ARG(e), DEBUG_LOG_ARG(g),           \
+						DEBUG_LOG_ARG(h), DEBUG_LOG_ARG(i)},          \
+		8
+
+#define DEBUG_LOG(level, ...)                                             \
+	{                                                                     \
+		if((level) >= DEBUG_LOG_LEVEL &&                                  \
+		   (int) (level) >= atomic_load_explicit(&debug.log_level,        \
+												 memory_order_relaxed)) { \
+			debug_log_write(level, DEBUG_LOG_FORMAT(__VA_ARGS__),         \
+							DEBUG_LOG_ARGS(__VA_ARGS__));                 \
+		}                                                                 \
+	}
+
+#define DEBUG_LOG_TRC(...) DEBUG_LOG(DEBUG_LOG_TRACE, __VA_ARGS__)
+#define DEBUG_LOG_DBG(...) DEBUG_LOG(DEBUG_LOG_DEBUG, __VA_ARGS__)
+#define DEBUG_LOG_INF(...) DEBUG_LOG(DEBUG_LOG_INFO, __VA_ARGS__)
+#define DEBUG_LOG_WRN(...) DEBUG_LOG(DEBUG_LOG_WARN, __VA_ARGS__)
+#define DEBUG_LOG_ERR(...) DEBUG_LOG(DEBUG_LOG_ERROR, __VA_ARGS__)
 
 #ifdef DEBUG_TIME
-#define DEBUG_PRINT_TIME(msg, time) printf("%s took %ld ms\n", msg, time);
-
-#define DEBUG_TIME_START(name) \
-	{                          \
-		debug_time_push(name); \
-		debug_time_lvl_next(); \
-		long dbgt_start = debug_time_now();
-
-#define DEBUG_TIME_STOP()                                            \
-	long		dbgt_diff = debug_time_now() - dbgt_start;           \
-	long		dbgt_ms	  = dbgt_diff;                               \
-	const char* msg;                                                 \
-	do {                                                             \
-		msg = debug_time_pop(debug_time_lvl());                      \
-		DEBUG_PRINT_TIME(msg, dbgt_ms);                              \
-	} while(msg != NULL);                                            \
-	DEBUG_PRINT_TIME(debug_time_pop(debug_time_lvl() - 1), dbgt_ms); \
-	debug_time_lvl_prev();                                           \
-	debug_time_set_last_ms(dbgt_ms);                                 \
+#define DEBUG_TIME_START(name)                                          \
+	{                                                                   \
+		static _Atomic int dbgt_zone = -1;                              \
+		if(dbgt_zone < 0) {                                             \
+			dbgt_zone =                                                 \
+				debug_zone(name, __FILE__, __LINE__, DEBUG_ZONE_SCOPE); \
+		}                                                               \
+		debug_ring_t* dbgt_ring = debug_ring_get();                     \
+		dbgt_ring->depth++;                                             \
+		uint64_t dbgt_start = debug_ticks();
+
+#define DEBUG_TIME_STOP()                                               \
+	debug_prof_record(dbgt_ring, dbgt_zone, dbgt_start, debug_ticks()); \
+	}
+
+#define DEBUG_MARK(name)                                                   \
+	{                                                                      \
+		static _Atomic int dbgt_mark = -1;                                 \
+		if(dbgt_mark < 0) {                                                \
+			dbgt_mark =                                                    \
+				debug_zone(name, __FILE__, __LINE__, DEBUG_ZONE_MARK);     \
+		}                                                                  \
+		uint64_t dbgt_now = debug_ticks();                                 \
+		debug_prof_write(debug_ring_get(), dbgt_mark, dbgt_now, dbgt_now); \
 	}
 #else
-#define DEBUG_PRINT_TIME(msg, time)
 #define DEBUG_TIME_START(name)
 #define DEBUG_TIME_STOP()
+#define DEBUG_MARK(name)
 #endif
 
 #endif
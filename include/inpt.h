@@ -26,7 +26,7 @@ typedef void (*inpt_act_value_evnt_t)(double value);
 
 #define BITFLD_GET(bitfield, i) bitfield[i / 8] & (1 << i % 8)
 #define BITFLD_SET(bitfield, i) bitfield[i / 8] |= (1 << i % 8)
-#define BITFLD_CLR(bitfield, i) bitfield[i / 8] |= ~(1 << i % 8)
+#define BITFLD_CLR(bitfield, i) bitfield[i / 8] &= ~(1 << i % 8)
 #define BITFLD_TGL(bitfield, i) bitfield[i / 8] ^= (1 << i % 8)
 
 enum inpt_btn_state_t {
@@ -54,11 +54,17 @@ enum inpt_act_type_t {
 	INPT_ACT_STATE_CHANGE = 1,
 	INPT_ACT_TRIGGER,
 	INPT_ACT_VALUE,
+
+	// gestures, these report through the trigger events.
+	INPT_ACT_CHORD,
+	INPT_ACT_SEQUENCE,
+	INPT_ACT_DOUBLE_TAP,
+	INPT_ACT_LONG_PRESS,
 };
 
 struct inpt_act_t {
 	char*				 name;
-	unsigned long		 name_hash;
+	int					 name_id;
 	enum inpt_act_type_t type;
 
 	uint8_t states[STATE_COUNT / 8];
@@ -66,8 +72,24 @@ struct inpt_act_t {
 	int input_mod;
 	int input;
 
-	int			  flags;
-	unsigned long new_state;
+	int flags;
+	int new_state;
+
+	// the highest wins when state changes fire on the same update.
+	int priority;
+
+	// gesture inputs, in order for sequences.
+#define INPT_ACT_INPUT_COUNT 8
+	int input_count;
+	int inputs[INPT_ACT_INPUT_COUNT];
+
+	// time allowed between presses, or how long a long press is held.
+	uint64_t window_ns;
+
+	// gesture state machine, only stepped when one of its inputs changes or
+	// its deadline passes.
+	int		 step;
+	uint64_t deadline_ns;
 
 #define INPT_ACT_POINT_COUNT 16
 	int point_count;
@@ -87,7 +109,27 @@ struct inpt_hid_id_t {
 struct inpt_t {
 	char version[8];
 
-	unsigned long states[STATE_COUNT];
+	// Interned state and action names. An id indexes names.ids, which also
+	// records the state and action slots holding that name, plus one so 0 is
+	// none. The strings live in the pool so callers don't have to keep them.
+#define MAX_NAMES 256
+#define NAME_SLOTS 512
+#define NAME_POOL_SIZE 8192
+	struct inpt_names_t {
+		int		count;
+		int		pool_used;
+		char	pool[NAME_POOL_SIZE];
+		int16_t slots[NAME_SLOTS];
+		struct inpt_name_t {
+			char*		  str;
+			unsigned long hash;
+			int			  state;
+			int			  action;
+		} ids[MAX_NAMES + 1];
+	} names;
+
+	// the interned name of each state, 0 for an empty slot.
+	int states[STATE_COUNT];
 
 #define ACTION_COUNT 128
 	inpt_act_t actions[ACTION_COUNT];
@@ -96,6 +138,32 @@ struct inpt_t {
 
 	int state_index;
 
+	// state changes queued during the action scan and applied after it, so
+	// every action sees the same state for the whole update.
+#define MAX_STATE_TRANSITIONS 16
+	struct {
+		int			state_index;
+		inpt_act_t* action;
+	} transitions[MAX_STATE_TRANSITIONS];
+	int transition_count;
+
+	// overlay states active on top of state_index.
+	uint8_t layers[STATE_COUNT / 8];
+
+	// The actions that can run for a set of active states. A list is built
+	// the first time its set is seen, so changing states just swaps which
+	// list the update walks.
+#define MAX_STATE_SETS 8
+	struct inpt_state_set_t {
+		uint8_t states[STATE_COUNT / 8];
+		int		generation;
+		int		action_count;
+		uint8_t actions[ACTION_COUNT];
+	} state_sets[MAX_STATE_SETS];
+	int						 state_set_next;
+	int						 state_generation;
+	struct inpt_state_set_t* state_set;
+
 	inpt_hid_t hid;
 	inpt_hid_t hid_prev;
 
@@ -129,6 +197,16 @@ struct inpt_t {
 
 	enum inpt_btn_state_t btn_states[MAX_BUTTONS];
 	enum inpt_btn_state_t btn_states_prev[MAX_BUTTONS];
+
+	// which gestures each button wakes, built as gestures are made.
+	uint8_t	 btn_gestures[MAX_BUTTONS][ACTION_COUNT / 8];
+	// buttons pressed this update. every press wakes the sequences, any
+	// button but the one they expect starts them over.
+	int		 btn_press_count;
+	uint8_t	 gestures_sequences[ACTION_COUNT / 8];
+	uint8_t	 gestures_dirty[ACTION_COUNT / 8];
+	uint8_t	 gestures_armed[ACTION_COUNT / 8];
+	uint64_t gestures_deadline;
 };
 
 LIBINPT const char* inpt_version();
@@ -137,9 +215,22 @@ LIBINPT int inpt_start();
 LIBINPT int inpt_stop();
 LIBINPT int inpt_update();
 
+// Names get a stable id, the *_id functions below skip looking them up.
+LIBINPT int			inpt_intern(const char* name);
+LIBINPT int			inpt_intern_find(const char* name);
+LIBINPT const char* inpt_intern_name(int id);
+
 LIBINPT int inpt_state_add(char* state);
 LIBINPT int inpt_state_del(char* state);
 LIBINPT int inpt_state_set(char* state, char* new_state);
+LIBINPT int inpt_state_layer_add(char* state);
+LIBINPT int inpt_state_layer_del(char* state);
+
+LIBINPT int inpt_state_add_id(int state);
+LIBINPT int inpt_state_del_id(int state);
+LIBINPT int inpt_state_set_id(int state, int new_state);
+LIBINPT int inpt_state_layer_add_id(int state);
+LIBINPT int inpt_state_layer_del_id(int state);
 
 LIBINPT inpt_act_t* inpt_act_new_state_change(char* name, char** states,
 											  int state_count, int input_mod,
@@ -151,8 +242,28 @@ LIBINPT inpt_act_t* inpt_act_new_trigger(char* name, char** states,
 LIBINPT inpt_act_t* inpt_act_new_value(char* name, char** states,
 									   int state_count, int input_mod,
 									   int input, int flags);
+
+// Gestures call the trigger events with INPT_BTN_PRESSED when they complete,
+// chords and long presses also with INPT_BTN_RELEASED when they let go.
+LIBINPT inpt_act_t* inpt_act_new_chord(char* name, char** states,
+									   int state_count, int input_mod,
+									   int* inputs, int input_count,
+									   int window_ms, int flags);
+LIBINPT inpt_act_t* inpt_act_new_sequence(char* name, char** states,
+										  int state_count, int input_mod,
+										  int* inputs, int input_count,
+										  int window_ms, int flags);
+LIBINPT inpt_act_t* inpt_act_new_double_tap(char* name, char** states,
+											int state_count, int input_mod,
+											int input, int window_ms,
+											int flags);
+LIBINPT inpt_act_t* inpt_act_new_long_press(char* name, char** states,
+											int state_count, int input_mod,
+											int input, int hold_ms, int flags);
 LIBINPT int			inpt_act_del(char* name);
 LIBINPT inpt_act_t* inpt_act_get(char* name);
+LIBINPT int			inpt_act_del_id(int name);
+LIBINPT inpt_act_t* inpt_act_get_id(int name);
 
 LIBINPT int inpt_act_set_name(inpt_act_t* action, char* name);
 LIBINPT int inpt_act_set_type(inpt_act_t* action, int type);
@@ -160,7 +271,11 @@ LIBINPT int inpt_act_set_type(inpt_act_t* action, int type);
 LIBINPT int inpt_act_set_input_mod(inpt_act_t* action, int input_mod);
 LIBINPT int inpt_act_set_input(inpt_act_t* action, int input);
 
+LIBINPT int inpt_act_set_inputs(inpt_act_t* action, int* inputs, int count);
+LIBINPT int inpt_act_set_window(inpt_act_t* action, int window_ms);
+
 LIBINPT int inpt_act_set_flags(inpt_act_t* action, int flags);
+LIBINPT int inpt_act_set_priority(inpt_act_t* action, int priority);
 
 LIBINPT int inpt_act_set_point(inpt_act_t* action, int index, int x, int y);
 
@@ -169,6 +284,8 @@ LIBINPT int inpt_act_del_point(inpt_act_t* action, int index);
 
 LIBINPT int inpt_act_add_state(inpt_act_t* action, char* state);
 LIBINPT int inpt_act_del_state(inpt_act_t* action, char* state);
+LIBINPT int inpt_act_add_state_id(inpt_act_t* action, int state);
+LIBINPT int inpt_act_del_state_id(inpt_act_t* action, int state);
 
 LIBINPT int inpt_act_on_state_change(inpt_act_t*				  action,
 									 inpt_act_state_change_evnt_t event);
@@ -180,9 +297,24 @@ LIBINPT int			   inpt_hid_count();
 LIBINPT inpt_hid_id_t* inpt_hid_list();
 LIBINPT char**		   inpt_hid_list_names();
 LIBINPT int			   inpt_hid_select(int vid, int pid);
+LIBINPT int			   inpt_hid_cache(const char* path);
 
 LIBINPT int inpt_hid_is_conn();
 
+// Rumble, LEDs and the like, sent by the next inpt_update.
+LIBINPT int inpt_hid_set_output(int page, int usage, int value);
+LIBINPT int inpt_hid_set_feature(int page, int usage, int value);
+
+// Bindings, see inpt_bind.h for the file format. Whatever loads is swapped in
+// by the next inpt_update and replaces every state and action, including the
+// ones made in code. Name ids stay the same across swaps. An action the new
+// bindings still have keeps its inpt_act_t* and listeners, pointers to any
+// other action are stale after the swap and their listeners are dropped.
+LIBINPT int inpt_bind_load(const char* path);
+LIBINPT int inpt_bind_compile_file(const char* path, const char* out_path);
+LIBINPT int inpt_bind_watch(const char* path, int interval_ms);
+LIBINPT int inpt_bind_unwatch();
+
 LIBINPT int inpt_hid_on_btn(inpt_hid_btn_evnt_t event);
 LIBINPT int inpt_hid_on_val(inpt_hid_val_evnt_t event);
 
@@ -0,0 +1,79 @@
+#ifndef INPT_BIND_H
+#define INPT_BIND_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "inpt.h"
+
+// Binding files describe the states and actions otherwise made with the
+// inpt_state_* and inpt_act_new_* functions. One declaration per line, fields
+// split by whitespace and anything after a # is a comment.
+//
+//	state      <name>
+//	change     <name> <states> <mod> <input>  <new state> <flags>
+//	trigger    <name> <states> <mod> <input>  <flags>
+//	value      <name> <states> <mod> <input>  <flags>
+//	chord      <name> <states> <mod> <inputs> <window ms> <flags>
+//	sequence   <name> <states> <mod> <inputs> <window ms> <flags>
+//	double_tap <name> <states> <mod> <input>  <window ms> <flags>
+//	long_press <name> <states> <mod> <input>  <hold ms>   <flags>
+//	priority   <priority>
+//	point      <x> <y>
+//
+// states and inputs are comma separated, states can also be "all". mod is a
+// button or - for none. flags are pressed, released and held joined by |.
+// priority and point apply to the action above them. States have to be
+// declared before they are used and the first one is where inpt starts.
+//
+// Text is compiled into the binary form below before loading. It can also be
+// compiled ahead of time with inpt_bind_compile_file, inpt_bind_load takes
+// either.
+
+#define INPT_BIND_MAGIC "INPB"
+// bump when inpt_bind_action_t changes meaning.
+#define INPT_BIND_VERSION 1
+
+// The header is followed by state_count name offsets, action_count actions
+// and then string_size bytes of nul terminated names. Every name is an offset
+// into those strings.
+typedef struct inpt_bind_header_t {
+	char	 magic[4];
+	uint32_t version;
+	uint32_t action_size;
+	uint32_t state_count;
+	uint32_t action_count;
+	uint32_t string_size;
+} inpt_bind_header_t;
+
+typedef struct inpt_bind_action_t {
+	uint32_t name;
+	uint8_t	 type;
+	uint8_t	 input_count;
+	uint8_t	 point_count;
+	int8_t	 input_mod;
+	uint8_t	 states[STATE_COUNT / 8];
+	int8_t	 inputs[INPT_ACT_INPUT_COUNT];
+	int32_t	 flags;
+	int32_t	 priority;
+	// index into the states, -1 when the action doesn't change state.
+	int32_t	 new_state;
+	uint32_t window_ms;
+	float	 points[INPT_ACT_POINT_COUNT][2];
+} inpt_bind_action_t;
+
+// Biggest a compiled binding can be.
+#define INPT_BIND_SIZE_MAX                                         \
+	(sizeof(inpt_bind_header_t) + STATE_COUNT * sizeof(uint32_t) + \
+	 ACTION_COUNT * sizeof(inpt_bind_action_t) + NAME_POOL_SIZE)
+
+// Compile binding text into out. Returns the compiled size or -1 on failure.
+LIBINPT int inpt_bind_compile(const char* text, size_t length, void* out,
+							  size_t size);
+
+// Build the tables for a compiled binding, from any thread. They are swapped
+// in by the next inpt_update. Returns 0 on success, 1 if the last build hasn't
+// been swapped in yet and -1 if the binding is invalid.
+LIBINPT int inpt_bind_build(const void* data, size_t size);
+
+#endif
@@ -0,0 +1,300 @@
+#ifndef RCAM_H
+#define RCAM_H
+
+#include <stdint.h>
+
+#include "rsoc.h"
+
+// Camera stream over rsoc UDP.
+//
+// The sender cuts every frame into fragments of at most RCAM_FRAGMENT_SIZE
+// bytes, each carrying the frame id, its index and the capture timestamp. The
+// receiver puts the fragments back together in a fixed pool of frame buffers
+// and holds finished frames in a small jitter buffer whose delay follows the
+// measured interarrival jitter. A frame that is still incomplete when a newer
+// one is complete is dropped, the stream never waits for a missing fragment.
+//
+// The receiver reports loss, receive rate and queueing delay back to the
+// sender every RCAM_FEEDBACK_INTERVAL_US. The sender paces fragments out at a
+// target rate that backs off on loss or growing delay and creeps back up to
+// the configured budget otherwise, and suggests the frame rate, resolution
+// and jpeg quality the camera should encode at to fit that rate. Traffic on
+// sockets shared with rcam_sender_share (the control channel) is taken out of
+// the budget first, so camera frames never crowd out control packets on the
+// radio. On a socket with a send scheduler the fragments are queued in a low
+// priority class instead of going straight to the kernel.
+
+#define RCAM_FRAGMENT_SIZE 1200
+#define RCAM_HEADER_SIZE 28
+#define RCAM_PACKET_MAX (RCAM_HEADER_SIZE + RCAM_FRAGMENT_SIZE)
+// Frames being assembled, waiting in the jitter buffer or held by the caller.
+#define RCAM_FRAME_COUNT 8
+// Largest frame the fragment index can address.
+#define RCAM_FRAME_MAX (RCAM_FRAGMENT_SIZE * 1024)
+// Packet buffers of the receive ring.
+#define RCAM_RING_COUNT 256
+
+// Bounds of the jitter buffer delay and how many jitters it waits for.
+#define RCAM_DELAY_MIN_US 5000
+#define RCAM_DELAY_MAX_US 200000
+#define RCAM_DELAY_JITTERS 3
+
+#define RCAM_FEEDBACK_INTERVAL_US 100000
+// Frames waiting to be paced out, including the one being sent.
+#define RCAM_SEND_QUEUE 2
+// Bounds of the sender target rate in bits per second.
+#define RCAM_RATE_MIN_BPS 200000
+#define RCAM_RATE_DEFAULT_BPS 4000000
+// Loss above which the sender backs off and below which it may speed up.
+#define RCAM_LOSS_HIGH 0.10
+#define RCAM_LOSS_LOW 0.02
+// Queueing delay at which the link is considered congested before it loses.
+#define RCAM_QUEUE_DELAY_MAX_US 30000
+// Sockets that can share the budget with the camera.
+#define RCAM_SHARE_MAX 4
+// The smallest transit is tracked over the last one to two windows so it
+// follows the drift between the sender and receiver clocks.
+#define RCAM_TRANSIT_WINDOW_US 5000000
+
+enum rcam_format_t {
+	RCAM_FORMAT_MJPEG = 1,
+	// Packed 24 bit RGB.
+	RCAM_FORMAT_RGB,
+	// 8 bit luminance.
+	RCAM_FORMAT_GRAY,
+};
+
+enum rcam_frame_state_t {
+	RCAM_FRAME_FREE = 0,
+	RCAM_FRAME_ASSEMBLING,
+	RCAM_FRAME_READY,
+	RCAM_FRAME_HELD,
+};
+
+// Camera errors.
+enum rcam_err_t {
+	// NULL argument.
+	RCAM_ERR_NULL = -255,
+	// The frame is empty or bigger than the maximum frame size.
+	RCAM_ERR_SIZE,
+	// Failed to allocate the frame or packet pool.
+	RCAM_ERR_ALLOC,
+	// rsoc failed to send or receive.
+	RCAM_ERR_SOCK,
+	// Sharing more sockets than RCAM_SHARE_MAX.
+	RCAM_ERR_FULL,
+};
+
+typedef struct rcam_frame_t	   rcam_frame_t;
+typedef struct rcam_stats_t	   rcam_stats_t;
+typedef struct rcam_params_t   rcam_params_t;
+typedef struct rcam_sender_t   rcam_sender_t;
+typedef struct rcam_receiver_t rcam_receiver_t;
+
+struct rcam_frame_t {
+	enum rcam_frame_state_t state;
+
+	uint32_t		   id;
+	enum rcam_format_t format;
+	int				   width;
+	int				   height;
+
+	uint8_t* data;
+	int		 size;
+
+	// sender clock, in microseconds.
+	uint32_t timestamp;
+	// receiver clock. capture_us is when the frame would have arrived over the
+	// fastest path seen so far.
+	uint64_t capture_us;
+	uint64_t first_us;
+	uint64_t complete_us;
+	uint64_t play_us;
+
+	// time from the first to the last fragment.
+	uint64_t assembly_us;
+	// time from capture to being handed out, measured against the fastest
+	// frame seen so far since the sender and receiver clocks aren't synced.
+	uint64_t latency_us;
+
+	int fragment_count;
+	int fragments_received;
+	// one bit per fragment.
+	uint8_t received[RCAM_FRAME_MAX / RCAM_FRAGMENT_SIZE / 8];
+};
+
+struct rcam_stats_t {
+	uint64_t frames_received;
+	// incomplete when a newer frame was due or out of buffers.
+	uint64_t frames_dropped;
+	// arrived after a newer frame was already handed out.
+	uint64_t frames_late;
+
+	uint64_t fragments_received;
+	uint64_t fragments_lost;
+	uint64_t bytes_received;
+
+	uint64_t latency_us;	  // of the last frame handed out
+	uint64_t latency_avg_us;  // smoothed
+	uint64_t jitter_us;		  // interarrival jitter, rfc 3550
+	uint64_t delay_us;		  // current jitter buffer delay
+};
+
+// What the camera should encode the next frames at. rcam doesn't encode, it
+// only picks these to fit the target rate.
+struct rcam_params_t {
+	int fps;
+	// width and height divisor: 1, 2 or 4.
+	int scale;
+	// jpeg quality, 1 to 100.
+	int quality;
+	// current target rate in bits per second.
+	uint64_t rate_bps;
+};
+
+struct rcam_sender_t {
+	rsoc_socket_t* sock;
+	uint32_t	   frame_id;
+	// class of the fragments when sock has a send scheduler, RSOC_CLASS_BULK
+	// unless changed after rcam_sender_init. feedback always goes out as
+	// RSOC_CLASS_CONTROL.
+	enum rsoc_class_t sched_class;
+
+	int		 frame_max;
+	uint8_t* frame_buffer;
+	// frames waiting to be paced out. queue[0] is being sent.
+	struct rcam_send_frame_t {
+		uint8_t* data;
+		int		 size;
+		uint32_t id;
+		uint32_t timestamp;
+		uint8_t	 format;
+		int		 width;
+		int		 height;
+		int		 fragment_next;
+		int		 fragment_count;
+	} queue[RCAM_SEND_QUEUE];
+	int queue_count;
+
+	// pacing. tokens are bytes that may be sent right now.
+	double	 tokens;
+	uint64_t pace_us;
+
+	// control sockets sharing the link, their traffic comes off the budget.
+	rsoc_socket_t* shared[RCAM_SHARE_MAX];
+	uint64_t	   shared_bytes[RCAM_SHARE_MAX];
+	int			   shared_count;
+
+	// rate control.
+	uint64_t budget_bps;
+	int		 fps_max;
+	uint64_t target_bps;
+	int		 level;
+	// smoothed size of a frame at full resolution and quality, learned from
+	// the frames sent at the current params.
+	double frame_bytes_full;
+
+	// last feedback from the receiver.
+	uint64_t feedback_us;
+	double	 loss;
+	uint64_t receive_bps;
+	uint64_t queue_delay_us;
+
+	uint64_t frames_sent;
+	uint64_t frames_skipped;
+	uint64_t bytes_sent;
+};
+
+struct rcam_transit_t {
+	int		 has;
+	uint32_t min;
+	uint32_t min_next;
+	uint64_t window_us;
+};
+
+struct rcam_receiver_t {
+	rsoc_socket_t* sock;
+	rsoc_ring_t	   ring;
+
+	int			 frame_max;
+	uint8_t*	 frame_buffer;
+	rcam_frame_t frames[RCAM_FRAME_COUNT];
+
+	// newest frame handed out.
+	uint32_t last_id;
+	int		 has_last;
+	// newest frame given up on.
+	uint32_t drop_id;
+	int		 has_drop;
+	// last frame counted as late, so it's only counted once, and how many
+	// late fragments came in a row.
+	uint32_t late_id;
+	int		 late_count;
+
+	// jitter buffer state. transit is local arrival time minus sender
+	// timestamp, which includes the unknown clock offset, so only
+	// differences between transits are meaningful. frame transits go from
+	// capture to the last fragment, network transits from each fragment
+	// leaving the sender to it arriving.
+	struct rcam_transit_t transit;
+	struct rcam_transit_t net_transit;
+	uint32_t			  transit_prev;
+	double				  jitter_us;
+
+	// feedback state, counters at the start of the current interval.
+	uint64_t feedback_us;
+	uint64_t feedback_fragments_received;
+	uint64_t feedback_fragments_lost;
+	uint64_t feedback_bytes;
+	uint64_t queue_delay_sum;
+	int		 queue_delay_count;
+	uint32_t newest_id;
+
+	rcam_stats_t stats;
+};
+
+// SENDER FUNCTIONS
+
+// frame_max is the biggest frame expected, 0 for RCAM_FRAME_MAX. The sender
+// owns all reads on sock, rcam_sender_update drains it and throws away
+// anything that isn't receiver feedback, so other traffic needs its own
+// socket.
+int rcam_sender_init(rcam_sender_t* sender, rsoc_socket_t* sock,
+					 const int frame_max);
+// Bandwidth budget of the whole link in bits per second, camera and shared
+// sockets together, and the highest frame rate the camera can do.
+int rcam_sender_budget(rcam_sender_t* sender, const uint64_t budget_bps,
+					   const int fps_max);
+// Counts the traffic sent on sock against the budget before the camera's.
+int rcam_sender_share(rcam_sender_t* sender, rsoc_socket_t* sock);
+// Queues a whole frame to be paced out by rcam_sender_update. The timestamp is
+// taken now. A frame that is still waiting when the next one comes in is
+// skipped.
+int rcam_send_frame(rcam_sender_t* sender, const uint8_t* data,
+					const int data_size, enum rcam_format_t format,
+					const int width, const int height);
+// Reads the receiver feedback, adjusts the target rate and sends the fragments
+// the pacer allows. Call this often, at least every millisecond or two while
+// frames are queued. Returns the number of fragments sent.
+int	 rcam_sender_update(rcam_sender_t* sender);
+int	 rcam_sender_params(rcam_sender_t* sender, rcam_params_t* params);
+void rcam_sender_free(rcam_sender_t* sender);
+
+// RECEIVER FUNCTIONS
+
+// frame_max is the biggest frame expected, 0 for RCAM_FRAME_MAX.
+int rcam_receiver_init(rcam_receiver_t* receiver, rsoc_socket_t* sock,
+					   const int frame_max);
+// Reads every waiting packet, waiting up to timeout_ms for the first one,
+// drops frames that can't make it anymore and sends feedback to the sender
+// when it's due. Returns the number of frames in the jitter buffer or a
+// negative value on error.
+int rcam_receiver_update(rcam_receiver_t* receiver, const int timeout_ms);
+// Returns the next frame whose playout time has come or NULL. Older frames
+// that are still incomplete are dropped.
+rcam_frame_t* rcam_receiver_acquire(rcam_receiver_t* receiver);
+void rcam_receiver_release(rcam_receiver_t* receiver, rcam_frame_t* frame);
+int	 rcam_receiver_stats(rcam_receiver_t* receiver, rcam_stats_t* stats);
+void rcam_receiver_free(rcam_receiver_t* receiver);
+
+#endif
@@ -148,6 +148,7 @@ typedef struct {
 
 	char product_name[127];
 	char manufacturer_name[127];
+	char serial_number[127];
 
 	int	  report_size;
 	char* report;
@@ -161,9 +162,12 @@ typedef struct {
 		uint16_t page;
 		uint16_t usage;
 		int		 index;
+		// the value descriptor of the hat switch a virtual d-pad button is
+		// decoded from, -1 for real buttons.
+		int hat;
 	} button_descriptors[MAX_BUTTON_COUNT];
 
-#define MAX_VALUE_COUNT 16
+#define MAX_VALUE_COUNT 32
 	struct rhid_value_descriptor_t {
 		uint8_t	 report_id;
 		int page;
@@ -171,19 +175,88 @@ typedef struct {
 		int		 logical_min;
 		int		 logical_max;
 		int		 index;
+		// the data index HidP_GetData reports the value under, -1 for the
+		// elements of value arrays.
+		int data_index;
+		// value arrays are report_count elements of bit_size bits under one
+		// usage, read whole at their element 0.
+		int array_index;
+		int report_count;
+		int bit_size;
 	} value_descriptors[MAX_VALUE_COUNT];
 
 	int button_count;
 	int value_count;
 
+// open addressed tables from (page, usage) to the descriptor index, -1 marks
+// an empty slot. built by rhid_open.
+#define RHID_LOOKUP_BITS 6
+#define RHID_LOOKUP_SIZE (1 << RHID_LOOKUP_BITS)
+	int8_t button_lookup[RHID_LOOKUP_SIZE];
+	int8_t value_lookup[RHID_LOOKUP_SIZE];
+
 	uint8_t*  buttons;
 	uint32_t* values;
 } rhid_device_t;
 
+// HID interfaces rhid keeps track of.
+#define RHID_DEVICE_MAX 64
+// Unread device changes, the oldest are dropped past this.
+#define RHID_CHANGE_MAX 32
+
+enum rhid_change_type_t {
+	RHID_CHANGE_ADDED = 0,
+	RHID_CHANGE_REMOVED,
+};
+
+typedef struct rhid_change_t {
+	enum rhid_change_type_t type;
+	char					path[256];
+	uint16_t				vendor_id;
+	uint16_t				product_id;
+} rhid_change_t;
+
+// Filters rhid_set_filters takes at most.
+#define RHID_FILTER_MAX 8
+
+// Decides which HID interfaces are enumerated at all. Fields left at zero and
+// empty strings match anything.
+typedef struct rhid_filter_t {
+	uint16_t vendor_id;
+	uint16_t product_id;
+	uint16_t usage_page;
+	uint16_t usage;
+	// part of the interface path, case insensitive.
+	char path[64];
+	// the serial number is only known once the interface is opened.
+	char serial_number[64];
+} rhid_filter_t;
+
 typedef int (*rhid_select_func_t)(uint16_t page, uint16_t usage);
 
+// Number of known HID interfaces. The interfaces are only walked again after
+// one was plugged in or removed, otherwise this is a lookup.
 int rhid_get_device_count();
+// Walks the HID interfaces and only opens and probes the ones whose path
+// wasn't seen before, interfaces that are gone are forgotten. Returns the
+// number of interfaces added or removed.
+int rhid_refresh();
+// Copies up to count known interfaces into devices, refreshing first if one
+// was plugged in or removed. Returns the number copied.
 int rhid_get_devices(rhid_device_t* devices, int count);
+// Moves up to count of the oldest unread additions and removals into changes.
+// Returns the number moved.
+int rhid_get_changes(rhid_change_t* changes, int count);
+// Keeps the capabilities of every probed model in the file at path, keyed by
+// vendor id, product id, version and top level collection. Interfaces of a
+// known model aren't opened to be probed. The file is mapped read only and
+// rewritten after a refresh probed new models. NULL stops using a cache.
+// Returns the number of models in the file.
+int rhid_cache_open(const char* path);
+// Only enumerates interfaces matching one of the filters, checked on the
+// interface path and hardware ids before anything is opened. Known interfaces
+// that don't match are removed. A count of 0 enumerates everything again.
+int rhid_set_filters(const rhid_filter_t* filters, int count);
 
 int rhid_select_count(rhid_device_t* devices, int count,
 					  rhid_select_func_t select_func);
@@ -197,6 +270,10 @@ int rhid_select_devices(rhid_device_t* devices, int count,
 int rhid_open(rhid_device_t* device);
 int rhid_close(rhid_device_t* device);
 
+// Decodes the reports that arrived since the last call without waiting. Each
+// report only updates the buttons and values of its own report id, so the
+// state adds up across report ids. Reading a report consumes it, so every one
+// is decoded whatever its id and report_id is ignored.
 int rhid_report(rhid_device_t* device, uint8_t report_id);
 int rhid_report_buttons(rhid_device_t* device, uint8_t report_id);
 int rhid_report_values(rhid_device_t* device, uint8_t report_id);
@@ -207,8 +284,26 @@ int rhid_get_values_state(rhid_device_t* device, uint32_t* values, int size);
 int rhid_get_buttons_usage(rhid_device_t* device, uint16_t* usages, int size);
 int rhid_get_values_usage(rhid_device_t* device, uint16_t* usages, int size);
 
-int rhid_get_button(rhid_device_t* device, uint16_t usage);
-int rhid_get_value(rhid_device_t* device, uint16_t usage);
+enum rhid_report_type_t {
+	RHID_REPORT_OUTPUT = 0,
+	RHID_REPORT_FEATURE,
+};
+
+// Sets an output or feature usage in the report that is sent next, a button
+// usage is on for any value but 0. Setting usages of a report that wasn't sent
+// yet only changes what will be sent. Returns -1 if the device has no such
+// usage.
+int rhid_set_usage(rhid_device_t* device, enum rhid_report_type_t type,
+				   uint16_t page, uint16_t usage, uint32_t value);
+// Starts sending one changed output or feature report without waiting, once
+// the last one finished. Meant to be called once per update. Returns 1 when a
+// report was sent, 0 when nothing was.
+int rhid_write(rhid_device_t* device);
+
+// State of the button or value with the usage, -1 if the device isn't open or
+// has no such usage.
+int rhid_get_button(rhid_device_t* device, uint16_t page, uint16_t usage);
+int rhid_get_value(rhid_device_t* device, uint16_t page, uint16_t usage);
 
 int rhid_get_button_count(rhid_device_t* device);
 int rhid_get_value_count(rhid_device_t* device);
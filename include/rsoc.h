@@ -3,6 +3,7 @@
 #ifndef RSOC_H
 #define RSOC_H
 
+#include <stdatomic.h>
 #include <stdint.h>
 #include <WinSock2.h>
 
@@ -127,8 +128,161 @@ enum rsoc_error_host_t {
 	RSOC_ERR_HOST_NOBLOCK,
 };
 
+// mDNS errors.
+enum rsoc_err_mdns_t {
+	// The name is empty, too long or has a label longer than 63 characters.
+	RSOC_ERR_MDNS_NAME = -255,
+	// Failed to create, bind or join the multicast socket.
+	RSOC_ERR_MDNS_SOCKET,
+	// Failed to send a query or an announcement.
+	RSOC_ERR_MDNS_SEND,
+	// Nobody answered the query before the last retry timed out.
+	RSOC_ERR_MDNS_TIMEOUT,
+	// The host table is full.
+	RSOC_ERR_MDNS_FULL,
+};
+
+// Send scheduler errors.
+enum rsoc_err_sched_t {
+	// rsoc_sched_init wasn't called on the socket.
+	RSOC_ERR_SCHED_NULL = -255,
+	// Not one of the rsoc_class_t values.
+	RSOC_ERR_SCHED_CLASS,
+	// The datagram is bigger than the scheduler's packet size.
+	RSOC_ERR_SCHED_SIZE,
+	// Failed to allocate a class queue.
+	RSOC_ERR_SCHED_ALLOC,
+	// rsoc_send failed.
+	RSOC_ERR_SCHED_SEND,
+};
+
+// Traffic classes of the send scheduler, highest priority first. A class only
+// gets to send when every class above it has nothing left to send or ran out
+// of its own tokens.
+enum rsoc_class_t {
+	// Joystick packets, enable and disable.
+	RSOC_CLASS_CONTROL = 0,
+	// Robot state updates.
+	RSOC_CLASS_STATE,
+	// Logs and graphs.
+	RSOC_CLASS_TELEMETRY,
+	// Camera frames and file transfers.
+	RSOC_CLASS_BULK,
+	RSOC_CLASS_COUNT,
+};
+
+// Datagrams a class can queue until rsoc_sched_class says otherwise.
+#define RSOC_SCHED_QUEUE_DEFAULT 64
+// Kernel send buffer of a scheduled socket. Kept small so the queueing happens
+// in the scheduler where control packets can skip it, not in the kernel.
+#define RSOC_SCHED_SNDBUF 16384
+
 typedef struct rsoc_socket_t rsoc_socket_t;
 typedef struct rsoc_packet_t rsoc_packet_t;
+typedef struct rsoc_stats_t	 rsoc_stats_t;
+
+typedef void (*rsoc_stats_evnt_t)(rsoc_socket_t*	   sock,
+								  const rsoc_stats_t* stats);
+
+// Link quality of a single socket. Counters are totals since the socket was
+// created. Rates and loss cover the last stats period (see rsoc_on_stats) or
+// the time since the previous rsoc_get_stats call if no period is set.
+struct rsoc_stats_t {
+	uint64_t bytes_sent;
+	uint64_t bytes_received;
+	uint64_t packets_sent;
+	uint64_t packets_received;
+	uint64_t send_errors;
+	uint64_t receive_errors;
+
+	// Only counted for traffic that reports sequence numbers through
+	// rsoc_stats_seq, like rsoc_chan.
+	uint64_t packets_lost;
+	uint64_t packets_reordered;
+	uint64_t packets_duplicated;
+
+	// Smoothed round trip time and its jitter (mean deviation between
+	// consecutive samples, as in rfc 3550) from rsoc_stats_rtt.
+	uint64_t rtt_us;
+	uint64_t jitter_us;
+
+	// Bytes waiting to be read from the socket.
+	int receive_queue;
+	// Datagrams waiting in the send scheduler and datagrams it dropped because
+	// their class queue was full.
+	int		 send_queue;
+	uint64_t send_dropped;
+
+	double send_rate;	 // bytes per second
+	double receive_rate; // bytes per second
+	double loss;		 // lost / expected packets, 0 to 1
+};
+
+// A datagram sitting in a rsoc_ring_t buffer. Only valid between
+// rsoc_ring_acquire and rsoc_ring_release.
+struct rsoc_packet_t {
+	uint8_t* data;
+	int		 size;
+
+	// who sent it.
+	struct sockaddr_storage addr;
+	int						addr_size;
+
+	// rsoc_time_us when it was read from the socket.
+	uint64_t time_us;
+};
+
+// Fixed pool of packet buffers used as a ring. rsoc_ring_receive reads
+// datagrams straight into the next free buffer and rsoc_ring_acquire hands
+// them out by reference, so receiving never allocates or copies after
+// rsoc_ring_init. One thread may receive while another acquires and releases.
+typedef struct rsoc_ring_t {
+	int count;
+	int packet_size;
+
+	uint8_t*	   buffer;
+	rsoc_packet_t* packets;
+	atomic_int*	   states;
+
+	// next slot to fill and next slot to hand out. slots are used in order so
+	// a packet that is held for a long time stops the ring from filling past
+	// it.
+	unsigned int head;
+	unsigned int tail;
+} rsoc_ring_t;
+
+// Token bucket pacing for one class. Tokens are bytes, a datagram may go
+// out while there is at least one left so the bucket can dip below zero.
+struct rsoc_sched_class_t {
+	uint64_t rate_bps; // 0 for no limit but the link's
+	int		 burst;
+	double	 tokens;
+
+	// queued datagrams, oldest at head.
+	uint8_t*	   buffer;
+	rsoc_packet_t* packets;
+	int			   count;
+	unsigned int   head;
+	int			   queued;
+
+	uint64_t sent;
+	uint64_t dropped;
+};
+
+typedef struct rsoc_sched_t {
+	int enabled;
+	int packet_size;
+
+	// bucket of the whole link, shared by every class and by rsoc_send.
+	uint64_t link_bps; // 0 for no limit
+	int		 burst;
+	double	 tokens;
+	uint64_t refill_us;
+	// stats.bytes_sent already charged to the link bucket.
+	uint64_t bytes_charged;
+
+	struct rsoc_sched_class_t classes[RSOC_CLASS_COUNT];
+} rsoc_sched_t;
 
 struct rsoc_socket_t {
 	int port;
@@ -145,10 +299,34 @@ struct rsoc_socket_t {
 	int role;
 
 	int fd;
+
+	rsoc_stats_t stats;
+	struct rsoc_stats_state_t {
+		rsoc_stats_evnt_t event;
+		uint64_t		  period_us;
+		uint64_t		  window_us;
+
+		// totals at the start of the current window.
+		uint64_t bytes_sent;
+		uint64_t bytes_received;
+		uint64_t packets_received;
+		uint64_t packets_lost;
+
+		int		 has_seq;
+		uint16_t seq;
+		uint32_t seq_bits;
+		int		 has_rtt;
+		uint64_t rtt_prev_us;
+	} stats_state;
+
+	rsoc_sched_t sched;
 };
 
 int rsoc_init();
 
+// Monotonic time in microseconds. Only useful for measuring intervals.
+uint64_t rsoc_time_us();
+
 // CLIENT FUNCTIONS
 
 // TODO Figure out if getaddrinfo resolves mdns address (both linux and
@@ -157,6 +335,9 @@ int rsoc_init();
 // just for portibility. (see: https://github.com/mjansson/mdns)
 // getaddrinfo uses the OS's DNS resolving meaning if avahi is installed on
 // linux or bonjour on windows / osx, then it should work.
+//
+// rsoc_resolve_mdns uses the built-in mDNS engine below instead so it works
+// the same on every laptop. The port to connect to is taken from sock->port.
 int rsoc_resolve_mdns(char* addr, const int addr_size, rsoc_socket_t* sock);
 int rsoc_resolve_ip(char* addr, const int addr_size, const int port,
 				   rsoc_socket_t* sock);
@@ -164,15 +345,138 @@ int rsoc_resolve_ip(char* addr, const int addr_size, const int port,
 // HOST FUNCTIONS
 
 int rsoc_host(const int port, rsoc_socket_t* sock);
+// Hosts on port and answers mDNS queries for addr (e.g.
+// "roborio-1234-frc.local") with this machine's address. rsoc_mdns_update has
+// to be called to answer.
 int rsoc_host_mdns(char* addr, const int addr_size, const int port,
 				  rsoc_socket_t* sock);
 
+// MDNS FUNCTIONS
+
+// A small IPv4-only mDNS (RFC 6762) engine. It only knows A records: enough to
+// find the robot by name and to answer for our own names. Resolved records are
+// cached until their TTL runs out so repeat lookups don't send anything.
+//
+// To test it on loopback, run a host and a resolver in two processes on the
+// same machine. Both bind 5353 with address reuse and multicast loopback on.
+
+#define RSOC_MDNS_ADDR "224.0.0.251"
+#define RSOC_MDNS_PORT 5353
+#define RSOC_MDNS_NAME_MAX 256
+#define RSOC_MDNS_CACHE_COUNT 16
+#define RSOC_MDNS_HOST_COUNT 4
+// How many queries are sent before giving up. Each retry doubles the wait.
+#define RSOC_MDNS_QUERY_RETRIES 3
+#define RSOC_MDNS_QUERY_TIMEOUT_MS 250
+// TTL we answer with, in seconds. 120 is what RFC 6762 recommends for A
+// records.
+#define RSOC_MDNS_TTL 120
+
+// Looks up name in the cache and on the network. Returns 0 and fills addr on
+// success.
+int rsoc_mdns_query(const char* name, struct in_addr* addr);
+// Reads every pending mDNS packet, waiting up to timeout_ms for the first one.
+// Answers queries for hosted names and caches answers seen on the network.
+// Returns the number of packets handled or a negative value on error.
+int rsoc_mdns_update(const int timeout_ms);
+// Stops answering for name. The record is sent once more with a TTL of 0 so
+// other caches drop it.
+int rsoc_mdns_unhost(const char* name);
+// Drops every cached record.
+void rsoc_mdns_flush();
+// Stops answering for every name and closes the multicast socket.
+int rsoc_mdns_close();
+
 // GENERIC FUNCTIONS
 
 int rsoc_send(rsoc_socket_t* sock, uint8_t* data, const int data_size);
 int rsoc_receive(rsoc_socket_t* sock, uint8_t* data, const int data_size);
 int rsoc_peek(rsoc_socket_t* sock, uint8_t* data, const int data_size);
+// Waits up to timeout_ms for data to arrive. Returns 1 if rsoc_receive won't
+// block, 0 on timeout and -1 on error.
+int rsoc_poll(rsoc_socket_t* sock, const int timeout_ms);
 
 int rsoc_close(rsoc_socket_t* sock);
 
+// RING FUNCTIONS
+
+// Allocates count buffers of packet_size bytes, count has to be a power of
+// two. Datagrams bigger than packet_size are cut off.
+int rsoc_ring_init(rsoc_ring_t* ring, const int count, const int packet_size);
+// Waits up to timeout_ms for a datagram, then reads every datagram that is
+// waiting into free buffers. Returns the number of packets read, 0 if nothing
+// arrived or the ring is full, and -1 on error.
+int rsoc_ring_receive(rsoc_socket_t* sock, rsoc_ring_t* ring,
+					  const int timeout_ms);
+// Returns the oldest received packet or NULL if there is none.
+rsoc_packet_t* rsoc_ring_acquire(rsoc_ring_t* ring);
+// Gives the buffer of an acquired packet back to the ring.
+void rsoc_ring_release(rsoc_ring_t* ring, rsoc_packet_t* packet);
+// Number of received packets that haven't been acquired yet.
+int	 rsoc_ring_count(rsoc_ring_t* ring);
+void rsoc_ring_free(rsoc_ring_t* ring);
+
+// SCHEDULER FUNCTIONS
+
+// rsoc_send writes straight to the socket, so a burst of telemetry ends up in
+// the kernel buffer ahead of the next joystick packet. The scheduler queues
+// datagrams per class instead and only hands them to the kernel as fast as the
+// link bucket allows, so the kernel queue stays short and a control datagram
+// never waits behind more than one burst.
+//
+// rsoc_send still works on a scheduled socket and goes out right away, ahead
+// of every class. What it sends is charged to the link bucket.
+
+// Sets up the scheduler with a link budget in bits per second (0 for none)
+// and the largest datagram that will be queued.
+int rsoc_sched_init(rsoc_socket_t* sock, const uint64_t link_bps,
+					const int packet_size);
+// Limits a class to rate_bps (0 for no limit) with bursts of up to burst
+// bytes and resizes its queue to queue_count datagrams. Queued datagrams of
+// the class are dropped.
+int rsoc_sched_class(rsoc_socket_t*			 sock,
+					 const enum rsoc_class_t sched_class,
+					 const uint64_t rate_bps, const int burst,
+					 const int queue_count);
+// Sends data right away if nothing of a higher or the same class is waiting
+// and the buckets allow it, otherwise queues it. A full queue drops its oldest
+// datagram. Returns the bytes sent, 0 if queued or a negative error.
+int rsoc_sched_send(rsoc_socket_t*			sock,
+					const enum rsoc_class_t sched_class, const uint8_t* data,
+					const int data_size);
+// Refills the buckets and sends whatever they allow, highest class first.
+// Call this every tick. Returns the number of datagrams sent.
+int rsoc_sched_update(rsoc_socket_t* sock);
+// Datagrams waiting in the queue of class.
+int	 rsoc_sched_pending(rsoc_socket_t*			 sock,
+						const enum rsoc_class_t sched_class);
+// Frees the queues. rsoc_close does this too.
+void rsoc_sched_free(rsoc_socket_t* sock);
+
+// STATS FUNCTIONS
+
+// Copies the current link statistics of sock into stats.
+int rsoc_get_stats(rsoc_socket_t* sock, rsoc_stats_t* stats);
+// Calls event with the link statistics every period_ms. The check happens in
+// rsoc_send, rsoc_receive and rsoc_stats_update. A NULL event stops it.
+int rsoc_on_stats(rsoc_socket_t* sock, rsoc_stats_evnt_t event,
+				  const int period_ms);
+// Fires the stats event if the period ran out. Call it from the main loop so
+// the event still fires when the link has gone quiet.
+int rsoc_stats_update(rsoc_socket_t* sock);
+// Reports the sequence number of a received packet for loss detection.
+void rsoc_stats_seq(rsoc_socket_t* sock, const uint16_t seq);
+// Reports a round trip time measurement.
+void rsoc_stats_rtt(rsoc_socket_t* sock, const uint64_t rtt_us);
+
+// METRICS FUNCTIONS
+
+// Largest datagram rsoc_send_metrics sends.
+#define RSOC_METRICS_PACKET 1200
+
+// Sends a snapshot of the debug metrics as text, one metric per line, split
+// into datagrams at line boundaries so each one can be read on its own.
+// Returns the number of datagrams sent or -1 on error.
+int rsoc_send_metrics(rsoc_socket_t* sock);
+
 #endif
\ No newline at end of file
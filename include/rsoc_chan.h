@@ -0,0 +1,140 @@
+#ifndef RSOC_CHAN_H
+#define RSOC_CHAN_H
+
+#include <stdint.h>
+
+#include "rsoc.h"
+
+// Channels multiplex several kinds of traffic over one rsoc UDP socket.
+// Joystick state can go out on an unreliable or sequenced channel at full rate
+// while state changes and config pushes ride a reliable channel on the same
+// socket instead of needing a second TCP connection.
+//
+// Every datagram carries a packet sequence number and acknowledges the last 33
+// packets received from the peer (ack + ack_bits) so acks ride along for free
+// with the regular traffic. Reliable messages are resent until a packet that
+// carried them is acked, and the round trip time of every acked packet feeds
+// the RTT estimate that decides when to resend.
+//
+// Only one peer per rsoc_chan_conn_t. As a host, that is whoever sent the last
+// datagram, same as rsoc_send.
+
+#define RSOC_CHAN_COUNT 8
+// Largest payload of a single message. Messages are never fragmented.
+#define RSOC_CHAN_MESSAGE_MAX 1024
+// Reliable messages that can be in flight (or waiting to be delivered in
+// order) per channel. Must be a power of two.
+#define RSOC_CHAN_WINDOW 32
+// Packets remembered for ack and RTT bookkeeping. Must be a power of two.
+#define RSOC_CHAN_SENT_COUNT 256
+// A bare ack is sent if we received something but sent nothing for this long.
+#define RSOC_CHAN_ACK_INTERVAL_US 20000
+// Bounds of the retransmission timeout.
+#define RSOC_CHAN_RTO_MIN_US 20000
+#define RSOC_CHAN_RTO_MAX_US 1000000
+
+#define RSOC_CHAN_HEADER_SIZE 12
+#define RSOC_CHAN_PACKET_MAX (RSOC_CHAN_HEADER_SIZE + RSOC_CHAN_MESSAGE_MAX)
+
+enum rsoc_chan_type_t {
+	// Delivered whenever it arrives, if it arrives.
+	RSOC_CHAN_UNRELIABLE = 1,
+	// Like unreliable but anything older than the newest message already
+	// delivered is dropped.
+	RSOC_CHAN_SEQUENCED,
+	// Resent until acked and delivered exactly once, in order.
+	RSOC_CHAN_RELIABLE,
+};
+
+// Channel errors.
+enum rsoc_err_chan_t {
+	// NULL conn argument or the conn isn't initialized.
+	RSOC_ERR_CHAN_NULCONN = -255,
+	// The channel doesn't exist.
+	RSOC_ERR_CHAN_INVALID,
+	// The message is bigger than RSOC_CHAN_MESSAGE_MAX or the buffer is too
+	// small for the received message.
+	RSOC_ERR_CHAN_SIZE,
+	// Every slot of the reliable window is waiting for an ack.
+	RSOC_ERR_CHAN_FULL,
+	// Failed to allocate the reliable buffers.
+	RSOC_ERR_CHAN_ALLOC,
+	// rsoc failed to send or receive.
+	RSOC_ERR_CHAN_SOCK,
+};
+
+typedef struct rsoc_chan_conn_t rsoc_chan_conn_t;
+
+struct rsoc_chan_message_t {
+	int		 in_use;
+	uint16_t seq;
+	int		 size;
+	uint64_t sent_us;
+	int		 retries;
+	uint8_t	 data[RSOC_CHAN_MESSAGE_MAX];
+};
+
+struct rsoc_chan_conn_t {
+	rsoc_socket_t* sock;
+
+	uint16_t local_seq;
+	uint16_t remote_seq;
+	uint32_t ack_bits;
+	int		 has_remote;
+	int		 ack_pending;
+	uint64_t last_send_us;
+
+	// round trip time estimate as in rfc 6298.
+	uint64_t srtt_us;
+	uint64_t rttvar_us;
+	uint64_t rto_us;
+
+	struct rsoc_chan_sent_t {
+		int		 in_use;
+		int		 acked;
+		uint16_t seq;
+		uint64_t sent_us;
+		// the reliable message this packet carried, or -1.
+		int		 channel;
+		uint16_t msg_seq;
+	} sent[RSOC_CHAN_SENT_COUNT];
+
+	struct rsoc_chan_t {
+		enum rsoc_chan_type_t type;
+
+		uint16_t send_seq;
+		// next sequence to deliver (reliable) or the newest one delivered
+		// (sequenced).
+		uint16_t recv_seq;
+		int		 has_recv;
+
+		// only allocated for reliable channels.
+		struct rsoc_chan_message_t* send_window;
+		struct rsoc_chan_message_t* recv_window;
+	} channels[RSOC_CHAN_COUNT];
+	int channel_count;
+};
+
+int rsoc_chan_init(rsoc_chan_conn_t* conn, rsoc_socket_t* sock);
+// Adds a channel and returns its index. Both peers have to add the same
+// channels in the same order.
+int rsoc_chan_add(rsoc_chan_conn_t* conn, enum rsoc_chan_type_t type);
+
+int rsoc_chan_send(rsoc_chan_conn_t* conn, const int channel,
+				   const uint8_t* data, const int data_size);
+// Returns the size of the next message and stores the channel it arrived on in
+// channel. Returns 0 if there is nothing to deliver right now. Never blocks.
+int rsoc_chan_receive(rsoc_chan_conn_t* conn, int* channel, uint8_t* data,
+					  const int data_size);
+// Resends reliable messages whose timeout ran out and sends a bare ack when
+// there was no traffic to piggyback it on. Call this every tick.
+int rsoc_chan_update(rsoc_chan_conn_t* conn);
+
+// Smoothed round trip time in microseconds, 0 until the first ack.
+uint64_t rsoc_chan_rtt(rsoc_chan_conn_t* conn);
+// Reliable messages sent but not acked yet on channel.
+int rsoc_chan_pending(rsoc_chan_conn_t* conn, const int channel);
+
+int rsoc_chan_close(rsoc_chan_conn_t* conn);
+
+#endif
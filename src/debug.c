@@ -4,103 +4,1217 @@
 #include <string.h>
 #include <stdlib.h>
 
-struct debug_t debug = {0};
+struct debug_t debug = {.zone_lock	  = ATOMIC_FLAG_INIT,
+						.metric_lock = ATOMIC_FLAG_INIT,
+						.log_level	 = DEBUG_LOG_INFO};
+
+_Thread_local debug_ring_t*	 debug_ring	 = NULL;
+_Thread_local debug_shard_t* debug_shard = NULL;
+
+// threads past DEBUG_PROF_THREAD_MAX share this shard.
+static debug_shard_t _debug_shard_shared = {.shared = 1};
+
+// held while a thread drains the rings.
+static atomic_flag _debug_prof_lock = ATOMIC_FLAG_INIT;
+
+// events kept for a trace, the newest capacity of them.
+static struct {
+	debug_event_t* events;
+	int			   capacity;
+	uint64_t	   count;
+	const char*	   path;
+	int			   at_exit;
+	// set while the collector thread runs.
+	atomic_int	   collecting;
+} _debug_trace = {0};
+
+enum debug_log_state_t {
+	DEBUG_LOG_IDLE = 0,
+	DEBUG_LOG_STARTING,
+	DEBUG_LOG_RUNNING,
+	DEBUG_LOG_STOPPED,
+};
+
+typedef struct debug_log_record_t {
+	uint64_t		time_ns;
+	const char*		format;
+	uint8_t			level;
+	uint8_t			arg_count;
+	// string arguments hold an offset into text.
+	debug_log_arg_t args[DEBUG_LOG_ARG_MAX];
+	char			text[DEBUG_LOG_TEXT_MAX];
+} debug_log_record_t;
+
+// Bounded multi producer queue, every slot carries a sequence number that says
+// whether it is free for the producer at head or filled for the consumer at
+// tail, so producers only contend on the head.
+static struct {
+	struct {
+		atomic_uint_fast64_t seq;
+		debug_log_record_t	 record;
+	} slots[DEBUG_LOG_RING_COUNT];
+	atomic_uint_fast64_t head;
+	atomic_uint_fast64_t tail;
+
+	atomic_int			 state;
+	atomic_flag			 drain_lock;
+	atomic_uint_fast64_t dropped;
+	uint64_t			 dropped_reported;
+	_Atomic(FILE*)		 file;
+	uint64_t			 start_ns;
+} _debug_log = {.drain_lock = ATOMIC_FLAG_INIT};
+
+// threads past DEBUG_PROF_THREAD_MAX share this ring. it always looks full so
+// their events are only counted as dropped.
+static debug_ring_t _debug_ring_full = {.head = DEBUG_PROF_RING_COUNT};
 
 #ifdef WINDOWS
 
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
 
-#define BILLION (1E9)
+static void	  _debug_log_thread();
+static HANDLE _debug_log_thread_handle = NULL;
 
-static BOOL			 g_first_time = 1;
-static LARGE_INTEGER g_counts_per_sec;
+static DWORD WINAPI _debug_log_thread_win(LPVOID arg) {
+	_debug_log_thread();
+	return 0;
+}
 
-int clock_gettime(int dummy, struct timespec* ct) {
-	LARGE_INTEGER count;
+static int _debug_log_thread_start() {
+	_debug_log_thread_handle =
+		CreateThread(NULL, 0, _debug_log_thread_win, NULL, 0, NULL);
+	return _debug_log_thread_handle != NULL ? 0 : -1;
+}
 
-	if(g_first_time) {
-		g_first_time = 0;
+static void _debug_log_thread_join() {
+	WaitForSingleObject(_debug_log_thread_handle, INFINITE);
+	CloseHandle(_debug_log_thread_handle);
+	_debug_log_thread_handle = NULL;
+}
 
-		if(0 == QueryPerformanceFrequency(&g_counts_per_sec)) {
-			g_counts_per_sec.QuadPart = 0;
-		}
+static void _debug_sleep_ms(const int ms) {
+	Sleep(ms);
+}
+
+static void   _debug_trace_collect();
+static HANDLE _debug_trace_thread = NULL;
+
+static DWORD WINAPI _debug_trace_thread_win(LPVOID arg) {
+	_debug_trace_collect();
+	return 0;
+}
+
+static int _debug_trace_thread_start() {
+	_debug_trace_thread =
+		CreateThread(NULL, 0, _debug_trace_thread_win, NULL, 0, NULL);
+	return _debug_trace_thread != NULL ? 0 : -1;
+}
+
+static void _debug_trace_thread_join() {
+	WaitForSingleObject(_debug_trace_thread, INFINITE);
+	CloseHandle(_debug_trace_thread);
+	_debug_trace_thread = NULL;
+}
+
+uint64_t debug_time_ns() {
+	static LARGE_INTEGER frequency = {0};
+	LARGE_INTEGER		 count;
+
+	if(frequency.QuadPart == 0) {
+		QueryPerformanceFrequency(&frequency);
 	}
+	QueryPerformanceCounter(&count);
+
+	return (uint64_t) (count.QuadPart / frequency.QuadPart) * 1000000000 +
+		   (uint64_t) (count.QuadPart % frequency.QuadPart) * 1000000000 /
+			   frequency.QuadPart;
+}
+
+#else
+#include <pthread.h>
+#include <time.h>
+
+static void		 _debug_log_thread();
+static pthread_t _debug_log_thread_handle;
+
+static void* _debug_log_thread_posix(void* arg) {
+	_debug_log_thread();
+	return NULL;
+}
 
-	if((NULL == ct) || (g_counts_per_sec.QuadPart <= 0) ||
-	   (0 == QueryPerformanceCounter(&count))) {
+static int _debug_log_thread_start() {
+	if(pthread_create(&_debug_log_thread_handle, NULL, _debug_log_thread_posix,
+					  NULL) != 0) {
 		return -1;
 	}
 
-	ct->tv_sec	= count.QuadPart / g_counts_per_sec.QuadPart;
-	ct->tv_nsec = ((count.QuadPart % g_counts_per_sec.QuadPart) * BILLION) /
-				  g_counts_per_sec.QuadPart;
+	return 0;
+}
+
+static void _debug_log_thread_join() {
+	pthread_join(_debug_log_thread_handle, NULL);
+}
+
+static void _debug_sleep_ms(const int ms) {
+	struct timespec delay = {ms / 1000, (ms % 1000) * 1000000L};
+	nanosleep(&delay, NULL);
+}
+
+static void		 _debug_trace_collect();
+static pthread_t _debug_trace_thread;
+
+static void* _debug_trace_thread_posix(void* arg) {
+	_debug_trace_collect();
+	return NULL;
+}
+
+static int _debug_trace_thread_start() {
+	if(pthread_create(&_debug_trace_thread, NULL, _debug_trace_thread_posix,
+					  NULL) != 0) {
+		return -1;
+	}
 
 	return 0;
 }
 
-// #define CLOCK_REALTIME 0
+static void _debug_trace_thread_join() {
+	pthread_join(_debug_trace_thread, NULL);
+}
 
-// struct timespec { long tv_sec; long tv_nsec; };
+uint64_t debug_time_ns() {
+	struct timespec tp;
+	clock_gettime(CLOCK_MONOTONIC, &tp);
 
-#else
-#include <time.h>
+	return (uint64_t) tp.tv_sec * 1000000000 + tp.tv_nsec;
+}
 #endif
 
-long debug_time_now() {
-	struct timespec tp;
-	clock_gettime(0, &tp);
+// The tick rate is measured between the first zone and now, the longer the
+// program runs the closer it gets.
+uint64_t debug_ticks_to_ns(uint64_t ticks) {
+#ifdef DEBUG_HAS_TSC
+	uint64_t elapsed_ticks = debug_ticks() - debug.ticks_start;
+	uint64_t elapsed_ns	   = debug_time_ns() - debug.ns_start;
+	if(debug.ns_start == 0 || elapsed_ticks == 0) {
+		return 0;
+	}
 
-	return tp.tv_nsec / 1000000 + tp.tv_sec * 1000;
+	return (uint64_t) ((double) ticks * elapsed_ns / elapsed_ticks);
+#else
+	return ticks;
+#endif
 }
 
-int debug_time_lvl() {
-	return debug.time.level;
+int debug_zone(const char* name, const char* file, const int line,
+			   const enum debug_zone_kind_t kind) {
+	while(atomic_flag_test_and_set_explicit(&debug.zone_lock,
+											memory_order_acquire)) {
+	}
+
+	if(debug.ns_start == 0) {
+		debug.ns_start	  = debug_time_ns();
+		debug.ticks_start = debug_ticks();
+	}
+
+	// two threads can race to register the same call site.
+	int count = atomic_load(&debug.zone_count);
+	int zone  = -1;
+	for(int i = 0; i < count; i++) {
+		if(debug.zones[i].line == line &&
+		   strcmp(debug.zones[i].file, file) == 0) {
+			zone = i;
+			break;
+		}
+	}
+
+	if(zone < 0 && count < DEBUG_PROF_ZONE_MAX) {
+		zone					= count;
+		debug.zones[zone].name	= name;
+		debug.zones[zone].file	= file;
+		debug.zones[zone].line	= line;
+		debug.zones[zone].kind	= kind;
+		debug.zones[zone].min	= UINT64_MAX;
+		debug.zones[zone].depth = -1;
+		atomic_store(&debug.zone_count, count + 1);
+	}
+
+	atomic_flag_clear_explicit(&debug.zone_lock, memory_order_release);
+
+	// out of zones, the last one collects the rest.
+	return zone < 0 ? DEBUG_PROF_ZONE_MAX - 1 : zone;
 }
 
-void debug_time_lvl_next() {
-	debug.time.level++;
+debug_ring_t* debug_ring_register() {
+	if(debug_ring != NULL) {
+		return debug_ring;
+	}
+
+	int index = atomic_fetch_add(&debug.ring_count, 1);
+	if(index >= DEBUG_PROF_THREAD_MAX) {
+		debug_ring = &_debug_ring_full;
+		return debug_ring;
+	}
+
+	debug_ring_t* ring = calloc(1, sizeof(debug_ring_t));
+	if(ring == NULL) {
+		debug_ring = &_debug_ring_full;
+		return debug_ring;
+	}
+
+	ring->thread		= index;
+	debug.rings[index]	= ring;
+	debug_ring			= ring;
+
+	return ring;
 }
 
-void debug_time_lvl_prev() {
-	debug.time.level--;
+void debug_thread_name(const char* name) {
+	debug_ring_get()->name = name;
 }
 
-void debug_time_push(const char* msg) {
-	for(int i = 0; i < DEBUG_TIME_MESSAGE_MAX; i++) {
-		if(debug.time.messages[debug.time.level][i][0] != '\0') {
+// Drains the rings, the caller holds _debug_prof_lock.
+static int _debug_prof_drain() {
+	int collected = 0;
+	int count	  = atomic_load(&debug.ring_count);
+	if(count > DEBUG_PROF_THREAD_MAX) {
+		count = DEBUG_PROF_THREAD_MAX;
+	}
+
+	for(int i = 0; i < count; i++) {
+		debug_ring_t* ring = debug.rings[i];
+		// registered but not stored yet.
+		if(ring == NULL) {
 			continue;
 		}
 
-		for(int j = 0; j < debug.time.level; j++) {
-			debug.time.messages[debug.time.level][i][j] = '\t';
+		uint_fast64_t head =
+			atomic_load_explicit(&ring->head, memory_order_acquire);
+		uint_fast64_t tail =
+			atomic_load_explicit(&ring->tail, memory_order_relaxed);
+
+		for(; tail != head; tail++) {
+			debug_event_t* event =
+				&ring->events[tail & (DEBUG_PROF_RING_COUNT - 1)];
+			debug_zone_t* zone	   = &debug.zones[event->zone];
+			uint64_t	  duration = event->end - event->start;
+
+			if(_debug_trace.events != NULL) {
+				_debug_trace.events[_debug_trace.count %
+									_debug_trace.capacity] = *event;
+				_debug_trace.count++;
+			}
+
+			zone->count++;
+			zone->total += duration;
+			if(duration < zone->min) {
+				zone->min = duration;
+			}
+			if(duration > zone->max) {
+				zone->max = duration;
+			}
+			if(zone->depth < 0 || event->depth < zone->depth) {
+				zone->depth = event->depth;
+			}
+
+			collected++;
 		}
 
-		memcpy(debug.time.messages[debug.time.level][i] + debug.time.level, msg,
-			   strlen(msg));
-		break;
+		atomic_store_explicit(&ring->tail, tail, memory_order_release);
+	}
+
+	return collected;
+}
+
+static void _debug_prof_lock_take() {
+	while(atomic_flag_test_and_set_explicit(&_debug_prof_lock,
+											memory_order_acquire)) {
 	}
 }
 
-const char* debug_time_pop(int level) {
-	for(int i = 0; i < DEBUG_TIME_MESSAGE_MAX; i++) {
-		if(debug.time.messages[level][i][0] == '\0') {
+static void _debug_prof_lock_give() {
+	atomic_flag_clear_explicit(&_debug_prof_lock, memory_order_release);
+}
+
+int debug_prof_collect() {
+	_debug_prof_lock_take();
+	int collected = _debug_prof_drain();
+	_debug_prof_lock_give();
+
+	return collected;
+}
+
+void debug_prof_print(FILE* file) {
+	// the totals stay put while printing, a running trace collects too.
+	_debug_prof_lock_take();
+	_debug_prof_drain();
+
+	uint64_t dropped = 0;
+	int		 count	 = atomic_load(&debug.ring_count);
+	for(int i = 0; i < count && i < DEBUG_PROF_THREAD_MAX; i++) {
+		if(debug.rings[i] != NULL) {
+			dropped += atomic_load(&debug.rings[i]->dropped);
+		}
+	}
+	dropped += atomic_load(&_debug_ring_full.dropped);
+
+	fprintf(file, "%-40s %10s %12s %12s %12s\n", "zone", "count", "avg us",
+			"min us", "max us");
+
+	count = atomic_load(&debug.zone_count);
+	for(int i = 0; i < count; i++) {
+		debug_zone_t* zone = &debug.zones[i];
+		if(zone->count == 0) {
+			continue;
+		}
+
+		int indent = zone->depth * 2;
+		if(zone->kind == DEBUG_ZONE_MARK) {
+			fprintf(file, "%*s%-*s %10llu\n", indent, "", 40 - indent,
+					zone->name, (unsigned long long) zone->count);
 			continue;
 		}
 
-		memcpy(debug.time.messge_popped, debug.time.messages[level][i],
-			   DEBUG_TIME_MESSAGE_LENGTH_MAX);
-		memset(debug.time.messages[level][i], '\0',
-			   DEBUG_TIME_MESSAGE_LENGTH_MAX);
-		return debug.time.messge_popped;
+		fprintf(file, "%*s%-*s %10llu %12.3f %12.3f %12.3f\n", indent, "",
+				40 - indent, zone->name, (unsigned long long) zone->count,
+				debug_ticks_to_ns(zone->total / zone->count) / 1000.0,
+				debug_ticks_to_ns(zone->min) / 1000.0,
+				debug_ticks_to_ns(zone->max) / 1000.0);
 	}
 
-	return NULL;
+	if(dropped > 0) {
+		fprintf(file, "%llu events dropped, collect more often.\n",
+				(unsigned long long) dropped);
+	}
+
+	_debug_prof_lock_give();
 }
 
-void debug_time_set_last_ms(double ms) {
-	debug.time.last_ms = ms;
+void debug_prof_reset() {
+	_debug_prof_lock_take();
+	_debug_prof_drain();
+
+	int count = atomic_load(&debug.zone_count);
+	for(int i = 0; i < count; i++) {
+		debug.zones[i].count = 0;
+		debug.zones[i].total = 0;
+		debug.zones[i].min	 = UINT64_MAX;
+		debug.zones[i].max	 = 0;
+		debug.zones[i].depth = -1;
+	}
+
+	_debug_prof_lock_give();
 }
+
 double debug_time_last_ms() {
-	return debug.time.last_ms;
+	if(debug_ring == NULL) {
+		return 0.0;
+	}
+
+	return debug_ticks_to_ns(debug_ring->last) / 1000000.0;
+}
+
+// METRIC FUNCTIONS
+
+static int _debug_metric_register(const char** names, atomic_int* count,
+								  const int max, const char* name) {
+	while(atomic_flag_test_and_set_explicit(&debug.metric_lock,
+											memory_order_acquire)) {
+	}
+
+	int metric = -1;
+	int current = atomic_load(count);
+	for(int i = 0; i < current; i++) {
+		if(strcmp(names[i], name) == 0) {
+			metric = i;
+			break;
+		}
+	}
+
+	if(metric < 0 && current < max) {
+		metric		  = current;
+		names[metric] = name;
+		atomic_store(count, current + 1);
+	}
+
+	atomic_flag_clear_explicit(&debug.metric_lock, memory_order_release);
+
+	return metric < 0 ? max - 1 : metric;
+}
+
+int debug_counter(const char* name) {
+	return _debug_metric_register(debug.counter_names, &debug.counter_count,
+								  DEBUG_METRIC_COUNTER_MAX, name);
+}
+
+int debug_gauge(const char* name) {
+	return _debug_metric_register(debug.gauge_names, &debug.gauge_count,
+								  DEBUG_METRIC_GAUGE_MAX, name);
+}
+
+int debug_hist(const char* name) {
+	return _debug_metric_register(debug.hist_names, &debug.hist_count,
+								  DEBUG_METRIC_HIST_MAX, name);
+}
+
+debug_shard_t* debug_shard_register() {
+	if(debug_shard != NULL) {
+		return debug_shard;
+	}
+
+	int index = atomic_fetch_add(&debug.shard_count, 1);
+	if(index >= DEBUG_PROF_THREAD_MAX) {
+		debug_shard = &_debug_shard_shared;
+		return debug_shard;
+	}
+
+	debug_shard_t* shard = calloc(1, sizeof(debug_shard_t));
+	if(shard == NULL) {
+		debug_shard = &_debug_shard_shared;
+		return debug_shard;
+	}
+
+	debug.shards[index] = shard;
+	debug_shard			= shard;
+
+	return shard;
+}
+
+static void _debug_shard_sum(debug_metrics_t* snapshot, debug_shard_t* shard) {
+	for(int i = 0; i < snapshot->counter_count; i++) {
+		snapshot->counters[i] +=
+			atomic_load_explicit(&shard->counters[i], memory_order_relaxed);
+	}
+
+	for(int i = 0; i < snapshot->hist_count; i++) {
+		debug_hist_t* hist = &snapshot->hists[i];
+		hist->sum +=
+			atomic_load_explicit(&shard->hists[i].sum, memory_order_relaxed);
+		for(int j = 0; j < DEBUG_HIST_BUCKETS; j++) {
+			uint64_t count = atomic_load_explicit(&shard->hists[i].buckets[j],
+												  memory_order_relaxed);
+			hist->buckets[j] += count;
+			hist->count += count;
+		}
+	}
+}
+
+void debug_metrics_snapshot(debug_metrics_t* snapshot) {
+	memset(snapshot, 0, sizeof(debug_metrics_t));
+	snapshot->counter_count = atomic_load(&debug.counter_count);
+	snapshot->gauge_count	= atomic_load(&debug.gauge_count);
+	snapshot->hist_count	= atomic_load(&debug.hist_count);
+
+	int count = atomic_load(&debug.shard_count);
+	for(int i = 0; i < count && i < DEBUG_PROF_THREAD_MAX; i++) {
+		// registered but not stored yet.
+		if(debug.shards[i] != NULL) {
+			_debug_shard_sum(snapshot, debug.shards[i]);
+		}
+	}
+	_debug_shard_sum(snapshot, &_debug_shard_shared);
+
+	for(int i = 0; i < snapshot->gauge_count; i++) {
+		snapshot->gauges[i] =
+			atomic_load_explicit(&debug.gauges[i], memory_order_relaxed);
+	}
+}
+
+// Largest value that lands in bucket.
+static uint64_t _debug_hist_bucket_max(const int bucket) {
+	if(bucket < DEBUG_HIST_SUB) {
+		return bucket;
+	}
+
+	int		 top   = bucket / DEBUG_HIST_SUB + DEBUG_HIST_SUB_BITS - 1;
+	uint64_t sub   = bucket % DEBUG_HIST_SUB;
+	uint64_t width = (uint64_t) 1 << (top - DEBUG_HIST_SUB_BITS);
+
+	return ((DEBUG_HIST_SUB + sub) << (top - DEBUG_HIST_SUB_BITS)) + width - 1;
+}
+
+uint64_t debug_hist_quantile(const debug_hist_t* hist, const double q) {
+	if(hist->count == 0) {
+		return 0;
+	}
+
+	uint64_t rank = (uint64_t) (q * hist->count);
+	if(rank >= hist->count) {
+		rank = hist->count - 1;
+	}
+
+	uint64_t seen = 0;
+	for(int i = 0; i < DEBUG_HIST_BUCKETS; i++) {
+		seen += hist->buckets[i];
+		if(seen > rank) {
+			return _debug_hist_bucket_max(i);
+		}
+	}
+
+	return UINT64_MAX;
+}
+
+int debug_metrics_format(const debug_metrics_t* snapshot, char* buffer,
+						 const int size) {
+	int	 length = 0;
+	char line[256];
+
+	// every metric is one line, a line that doesn't fit ends the text.
+	for(int i = 0; i < snapshot->counter_count + snapshot->gauge_count +
+						   snapshot->hist_count;
+		i++) {
+		int line_length;
+		if(i < snapshot->counter_count) {
+			line_length = snprintf(line, sizeof(line), "%s %llu\n",
+								   debug.counter_names[i],
+								   (unsigned long long) snapshot->counters[i]);
+		}
+		else if(i < snapshot->counter_count + snapshot->gauge_count) {
+			int gauge	= i - snapshot->counter_count;
+			line_length = snprintf(line, sizeof(line), "%s %lld\n",
+								   debug.gauge_names[gauge],
+								   (long long) snapshot->gauges[gauge]);
+		}
+		else {
+			int hist = i - snapshot->counter_count - snapshot->gauge_count;
+			const debug_hist_t* h = &snapshot->hists[hist];
+			line_length			  = snprintf(
+				  line, sizeof(line), "%s %llu %llu %llu %llu %llu %llu\n",
+				  debug.hist_names[hist], (unsigned long long) h->count,
+				  (unsigned long long) h->sum,
+				  (unsigned long long) debug_hist_quantile(h, 0.5),
+				  (unsigned long long) debug_hist_quantile(h, 0.9),
+				  (unsigned long long) debug_hist_quantile(h, 0.99),
+				  (unsigned long long) debug_hist_quantile(h, 1.0));
+		}
+
+		if(line_length < 0 || line_length >= (int) sizeof(line) ||
+		   length + line_length >= size) {
+			break;
+		}
+
+		memcpy(buffer + length, line, line_length);
+		length += line_length;
+	}
+
+	if(size > 0) {
+		buffer[length] = '\0';
+	}
+
+	return length;
+}
+
+int debug_metrics_print(FILE* file) {
+	debug_metrics_t* snapshot = malloc(sizeof(debug_metrics_t));
+	char*			 buffer	  = malloc(DEBUG_METRICS_TEXT_MAX);
+	if(snapshot == NULL || buffer == NULL) {
+		free(snapshot);
+		free(buffer);
+		return -1;
+	}
+
+	debug_metrics_snapshot(snapshot);
+	int length = debug_metrics_format(snapshot, buffer, DEBUG_METRICS_TEXT_MAX);
+	fputs(buffer, file);
+
+	free(snapshot);
+	free(buffer);
+
+	return length;
+}
+
+// LOG FUNCTIONS
+
+static const char* _debug_log_level_names[] = {"TRACE", "DEBUG", "INFO",
+											   "WARN", "ERROR"};
+
+static long long _debug_log_arg_int(const debug_log_arg_t* arg) {
+	switch(arg->type) {
+		case DEBUG_LOG_U64:
+			return (long long) arg->u;
+		case DEBUG_LOG_F64:
+			return (long long) arg->f;
+		case DEBUG_LOG_I64:
+			return arg->i;
+		default:
+			return (long long) (uintptr_t) arg->p;
+	}
+}
+
+static double _debug_log_arg_double(const debug_log_arg_t* arg) {
+	switch(arg->type) {
+		case DEBUG_LOG_U64:
+			return (double) arg->u;
+		case DEBUG_LOG_I64:
+			return (double) arg->i;
+		case DEBUG_LOG_F64:
+			return arg->f;
+		default:
+			return 0.0;
+	}
+}
+
+// Prints the record one conversion at a time. The arguments were widened to
+// 64 bits when they were queued so every integer conversion loses its length
+// modifier and gets "ll" instead.
+static void _debug_log_print(FILE* file, const debug_log_record_t* record) {
+	fprintf(file, "%12.6f %-5s ",
+			(record->time_ns - _debug_log.start_ns) / 1000000000.0,
+			_debug_log_level_names[record->level]);
+
+	const char* format = record->format;
+	int			arg	   = 0;
+	while(*format != '\0') {
+		size_t literal = strcspn(format, "%");
+		fwrite(format, 1, literal, file);
+		format += literal;
+		if(*format == '\0') {
+			break;
+		}
+
+		if(format[1] == '%') {
+			fputc('%', file);
+			format += 2;
+			continue;
+		}
+
+		char   spec[32] = "%";
+		size_t length	= 1;
+		format++;
+		while(*format != '\0' && strchr("-+ #0123456789.", *format) != NULL &&
+			  length < sizeof(spec) - 4) {
+			spec[length++] = *format++;
+		}
+		while(*format != '\0' && strchr("hljztL", *format) != NULL) {
+			format++;
+		}
+
+		char conversion = *format;
+		if(conversion == '\0') {
+			break;
+		}
+		format++;
+
+		if(arg >= record->arg_count) {
+			fwrite(spec, 1, length, file);
+			fputc(conversion, file);
+			continue;
+		}
+		const debug_log_arg_t* value = &record->args[arg++];
+
+		switch(conversion) {
+			case 'd':
+			case 'i':
+			case 'u':
+			case 'o':
+			case 'x':
+			case 'X':
+				spec[length++] = 'l';
+				spec[length++] = 'l';
+				spec[length++] = conversion;
+				spec[length]   = '\0';
+				fprintf(file, spec, _debug_log_arg_int(value));
+				break;
+
+			case 'c':
+				spec[length++] = 'c';
+				spec[length]   = '\0';
+				fprintf(file, spec, (int) _debug_log_arg_int(value));
+				break;
+
+			case 'f':
+			case 'F':
+			case 'e':
+			case 'E':
+			case 'g':
+			case 'G':
+			case 'a':
+			case 'A':
+				spec[length++] = conversion;
+				spec[length]   = '\0';
+				fprintf(file, spec, _debug_log_arg_double(value));
+				break;
+
+			case 's':
+				spec[length++] = 's';
+				spec[length]   = '\0';
+				fprintf(file, spec,
+						value->type == DEBUG_LOG_STR
+							? record->text + value->u
+							: "(not a string)");
+				break;
+
+			case 'p':
+				fprintf(file, "%p", value->type == DEBUG_LOG_PTR
+										? value->p
+										: (const void*) NULL);
+				break;
+
+			default:
+				fwrite(spec, 1, length, file);
+				fputc(conversion, file);
+		}
+	}
+
+	fputc('\n', file);
+}
+
+static FILE* _debug_log_output() {
+	FILE* file = atomic_load(&_debug_log.file);
+	return file != NULL ? file : stderr;
+}
+
+// Writes every filled slot. Only one thread may drain at a time.
+static int _debug_log_drain() {
+	FILE*		  file	= _debug_log_output();
+	int			  count = 0;
+	uint_fast64_t tail =
+		atomic_load_explicit(&_debug_log.tail, memory_order_relaxed);
+
+	while(1) {
+		uint_fast64_t seq = atomic_load_explicit(
+			&_debug_log.slots[tail & (DEBUG_LOG_RING_COUNT - 1)].seq,
+			memory_order_acquire);
+		if(seq != tail + 1) {
+			break;
+		}
+
+		_debug_log_print(
+			file, &_debug_log.slots[tail & (DEBUG_LOG_RING_COUNT - 1)].record);
+
+		// free for the producer one lap later.
+		atomic_store_explicit(
+			&_debug_log.slots[tail & (DEBUG_LOG_RING_COUNT - 1)].seq,
+			tail + DEBUG_LOG_RING_COUNT, memory_order_release);
+		tail++;
+		count++;
+	}
+	atomic_store_explicit(&_debug_log.tail, tail, memory_order_relaxed);
+
+	uint64_t dropped = atomic_load(&_debug_log.dropped);
+	if(dropped != _debug_log.dropped_reported) {
+		fprintf(file, "%llu log records dropped.\n",
+				(unsigned long long) (dropped - _debug_log.dropped_reported));
+		_debug_log.dropped_reported = dropped;
+	}
+
+	if(count > 0) {
+		fflush(file);
+	}
+
+	return count;
+}
+
+static void _debug_log_thread() {
+	while(atomic_load(&_debug_log.state) == DEBUG_LOG_RUNNING) {
+		int count = 0;
+		if(atomic_flag_test_and_set_explicit(&_debug_log.drain_lock,
+											 memory_order_acquire) == 0) {
+			count = _debug_log_drain();
+			atomic_flag_clear_explicit(&_debug_log.drain_lock,
+									   memory_order_release);
+		}
+
+		if(count == 0) {
+			_debug_sleep_ms(1);
+		}
+	}
+}
+
+static void _debug_log_start() {
+	int idle = DEBUG_LOG_IDLE;
+	if(atomic_compare_exchange_strong(&_debug_log.state, &idle,
+									  DEBUG_LOG_STARTING) == 0) {
+		// another thread is setting the ring up.
+		while(atomic_load(&_debug_log.state) == DEBUG_LOG_STARTING) {
+		}
+		return;
+	}
+
+	_debug_log.start_ns = debug_time_ns();
+	for(int i = 0; i < DEBUG_LOG_RING_COUNT; i++) {
+		atomic_store_explicit(&_debug_log.slots[i].seq, i,
+							  memory_order_relaxed);
+	}
+
+	atexit(debug_log_stop);
+
+	atomic_store(&_debug_log.state, DEBUG_LOG_RUNNING);
+	if(_debug_log_thread_start() < 0) {
+		atomic_store(&_debug_log.state, DEBUG_LOG_STOPPED);
+	}
+}
+
+// Fills record, copying the string arguments into its text.
+static void _debug_log_fill(debug_log_record_t*		record,
+							const enum debug_log_level_t level,
+							const char* format, const debug_log_arg_t* args,
+							int arg_count) {
+	if(arg_count > DEBUG_LOG_ARG_MAX) {
+		arg_count = DEBUG_LOG_ARG_MAX;
+	}
+
+	record->time_ns	  = debug_time_ns();
+	record->format	  = format;
+	record->level	  = level;
+	record->arg_count = arg_count;
+
+	size_t text = 0;
+	for(int i = 0; i < arg_count; i++) {
+		record->args[i] = args[i];
+		if(args[i].type != DEBUG_LOG_STR) {
+			continue;
+		}
+
+		const char* str	   = args[i].s != NULL ? args[i].s : "(null)";
+		size_t		length = strlen(str);
+		if(length > DEBUG_LOG_TEXT_MAX - 1 - text) {
+			length = DEBUG_LOG_TEXT_MAX - 1 - text;
+		}
+
+		memcpy(record->text + text, str, length);
+		record->text[text + length] = '\0';
+		record->args[i].u			= text;
+		text += length + (text + length < DEBUG_LOG_TEXT_MAX - 1 ? 1 : 0);
+	}
+}
+
+void debug_log_level(const enum debug_log_level_t level) {
+	atomic_store(&debug.log_level, level);
+}
+
+void debug_log_file(FILE* file) {
+	atomic_store(&_debug_log.file, file);
+}
+
+void debug_log_write(const enum debug_log_level_t level, const char* format,
+					 const debug_log_arg_t* args, const int arg_count) {
+	if(level < DEBUG_LOG_TRACE || level >= DEBUG_LOG_OFF) {
+		return;
+	}
+
+	if(atomic_load_explicit(&_debug_log.state, memory_order_acquire) <
+	   DEBUG_LOG_RUNNING) {
+		_debug_log_start();
+	}
+
+	// nothing drains the ring anymore, print right here.
+	if(atomic_load_explicit(&_debug_log.state, memory_order_acquire) ==
+	   DEBUG_LOG_STOPPED) {
+		debug_log_record_t record;
+		_debug_log_fill(&record, level, format, args, arg_count);
+		_debug_log_print(_debug_log_output(), &record);
+		return;
+	}
+
+	uint_fast64_t head =
+		atomic_load_explicit(&_debug_log.head, memory_order_relaxed);
+	while(1) {
+		uint_fast64_t seq = atomic_load_explicit(
+			&_debug_log.slots[head & (DEBUG_LOG_RING_COUNT - 1)].seq,
+			memory_order_acquire);
+
+		if(seq == head) {
+			// the slot is free, claim it.
+			if(atomic_compare_exchange_weak_explicit(
+				   &_debug_log.head, &head, head + 1, memory_order_relaxed,
+				   memory_order_relaxed)) {
+				break;
+			}
+		}
+		else if(seq < head) {
+			// the consumer hasn't freed it yet, the ring is full.
+			atomic_fetch_add_explicit(&_debug_log.dropped, 1,
+									  memory_order_relaxed);
+			DEBUG_COUNT("debug.log_dropped", 1);
+			return;
+		}
+		else {
+			// another producer took it.
+			head = atomic_load_explicit(&_debug_log.head, memory_order_relaxed);
+		}
+	}
+
+	_debug_log_fill(&_debug_log.slots[head & (DEBUG_LOG_RING_COUNT - 1)].record,
+					level, format, args, arg_count);
+	atomic_store_explicit(
+		&_debug_log.slots[head & (DEBUG_LOG_RING_COUNT - 1)].seq, head + 1,
+		memory_order_release);
+}
+
+void debug_log_stop() {
+	int running = DEBUG_LOG_RUNNING;
+	if(atomic_compare_exchange_strong(&_debug_log.state, &running,
+									  DEBUG_LOG_STOPPED) == 0) {
+		return;
+	}
+
+	// the thread exits after its current drain, or at exit it may have been
+	// killed in the middle of one. either way it is gone once joined and
+	// whatever it left in the ring is written here.
+	_debug_log_thread_join();
+	atomic_flag_clear_explicit(&_debug_log.drain_lock, memory_order_release);
+
+	_debug_log_drain();
+}
+
+// TRACE FUNCTIONS
+
+// Binary trace layout, little endian:
+//
+//   char[4] magic "DBGT"
+//   u32     version
+//   u64     ticks per second
+//   u32     zone count, then per zone:
+//     u8  kind
+//     u16 name length, name
+//     u16 file length, file
+//     u32 line
+//   u32     thread count, then per thread:
+//     u16 name length, name (empty if unnamed)
+//   u64     event count, then per event 16 bytes:
+//     u64 start in ticks since the first zone was registered
+//     u32 duration in ticks, saturated
+//     u16 zone
+//     u8  depth, saturated
+//     u8  thread, saturated
+
+static void _debug_write_u8(FILE* file, uint8_t value) {
+	fputc(value, file);
+}
+
+static void _debug_write_u16(FILE* file, uint16_t value) {
+	fputc(value & 0xFF, file);
+	fputc(value >> 8, file);
+}
+
+static void _debug_write_u32(FILE* file, uint32_t value) {
+	_debug_write_u16(file, value & 0xFFFF);
+	_debug_write_u16(file, value >> 16);
+}
+
+static void _debug_write_u64(FILE* file, uint64_t value) {
+	_debug_write_u32(file, value & 0xFFFFFFFF);
+	_debug_write_u32(file, value >> 32);
+}
+
+static void _debug_write_str(FILE* file, const char* str) {
+	size_t length = str != NULL ? strlen(str) : 0;
+	if(length > UINT16_MAX) {
+		length = UINT16_MAX;
+	}
+
+	_debug_write_u16(file, length);
+	fwrite(str, 1, length, file);
+}
+
+// Writes str as a json string, escaping what json needs escaped.
+static void _debug_json_str(FILE* file, const char* str) {
+	fputc('"', file);
+	for(; str != NULL && *str != '\0'; str++) {
+		if(*str == '"' || *str == '\\') {
+			fputc('\\', file);
+			fputc(*str, file);
+		}
+		else if((unsigned char) *str < 0x20) {
+			fprintf(file, "\\u%04x", *str);
+		}
+		else {
+			fputc(*str, file);
+		}
+	}
+	fputc('"', file);
+}
+
+static void _debug_trace_json(FILE* file, uint64_t first, uint64_t count) {
+	fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n", file);
+
+	int threads = atomic_load(&debug.ring_count);
+	for(int i = 0; i < threads && i < DEBUG_PROF_THREAD_MAX; i++) {
+		if(debug.rings[i] == NULL || debug.rings[i]->name == NULL) {
+			continue;
+		}
+
+		fprintf(file,
+				"{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%i,"
+				"\"args\":{\"name\":",
+				i);
+		_debug_json_str(file, debug.rings[i]->name);
+		fputs("}},\n", file);
+	}
+
+	for(uint64_t i = first; i < count; i++) {
+		debug_event_t* event = &_debug_trace.events[i % _debug_trace.capacity];
+		debug_zone_t*  zone	 = &debug.zones[event->zone];
+		double		   ts =
+			debug_ticks_to_ns(event->start - debug.ticks_start) / 1000.0;
+
+		fputs("{\"name\":", file);
+		_debug_json_str(file, zone->name);
+		if(zone->kind == DEBUG_ZONE_MARK) {
+			fprintf(file, ",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f", ts);
+		}
+		else {
+			fprintf(file, ",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f", ts,
+					debug_ticks_to_ns(event->end - event->start) / 1000.0);
+		}
+		fprintf(file, ",\"pid\":1,\"tid\":%u,\"args\":{\"file\":",
+				event->thread);
+		_debug_json_str(file, zone->file);
+		fprintf(file, ",\"line\":%i}}%s\n", zone->line,
+				i + 1 < count ? "," : "");
+	}
+
+	fputs("]}\n", file);
+}
+
+static void _debug_trace_binary(FILE* file, uint64_t first, uint64_t count) {
+	fwrite(DEBUG_TRACE_MAGIC, 1, 4, file);
+	_debug_write_u32(file, DEBUG_TRACE_VERSION);
+	// nanoseconds per billion ticks, 0 before any zone was registered.
+	uint64_t ns = debug_ticks_to_ns(1000000000);
+	_debug_write_u64(file, ns > 0 ? (uint64_t) (1e18 / ns) : 1000000000);
+
+	int zones = atomic_load(&debug.zone_count);
+	_debug_write_u32(file, zones);
+	for(int i = 0; i < zones; i++) {
+		_debug_write_u8(file, debug.zones[i].kind);
+		_debug_write_str(file, debug.zones[i].name);
+		_debug_write_str(file, debug.zones[i].file);
+		_debug_write_u32(file, debug.zones[i].line);
+	}
+
+	int threads = atomic_load(&debug.ring_count);
+	if(threads > DEBUG_PROF_THREAD_MAX) {
+		threads = DEBUG_PROF_THREAD_MAX;
+	}
+	_debug_write_u32(file, threads);
+	for(int i = 0; i < threads; i++) {
+		_debug_write_str(file,
+						 debug.rings[i] != NULL ? debug.rings[i]->name : NULL);
+	}
+
+	_debug_write_u64(file, count - first);
+	for(uint64_t i = first; i < count; i++) {
+		debug_event_t* event = &_debug_trace.events[i % _debug_trace.capacity];
+		uint64_t	   duration = event->end - event->start;
+
+		_debug_write_u64(file, event->start - debug.ticks_start);
+		_debug_write_u32(file, duration > UINT32_MAX ? UINT32_MAX : duration);
+		_debug_write_u16(file, event->zone);
+		_debug_write_u8(file, event->depth > UINT8_MAX ? UINT8_MAX
+													   : event->depth);
+		_debug_write_u8(file, event->thread > UINT8_MAX ? UINT8_MAX
+														: event->thread);
+	}
+}
+
+static void _debug_trace_collect() {
+	while(atomic_load(&_debug_trace.collecting)) {
+		// an explicit collect is already draining, catch up next time.
+		if(atomic_flag_test_and_set_explicit(&_debug_prof_lock,
+											 memory_order_acquire) == 0) {
+			_debug_prof_drain();
+			_debug_prof_lock_give();
+		}
+
+		_debug_sleep_ms(DEBUG_TRACE_COLLECT_MS);
+	}
+}
+
+static void _debug_trace_collect_stop() {
+	if(atomic_exchange(&_debug_trace.collecting, 0) == 0) {
+		return;
+	}
+
+	_debug_trace_thread_join();
+}
+
+static void _debug_trace_at_exit() {
+	if(_debug_trace.path == NULL || _debug_trace.events == NULL) {
+		return;
+	}
+
+	// at exit the collector may have been killed while draining. it is gone
+	// once joined, so nothing else holds the lock.
+	_debug_trace_collect_stop();
+	atomic_flag_clear(&_debug_prof_lock);
+
+	size_t length = strlen(_debug_trace.path);
+	int	   json	  = length >= 5 &&
+				strcmp(_debug_trace.path + length - 5, ".json") == 0;
+
+	debug_trace_write(_debug_trace.path,
+					  json ? DEBUG_TRACE_JSON : DEBUG_TRACE_BINARY);
+}
+
+int debug_trace_start(const int capacity, const char* path) {
+	if(capacity <= 0) {
+		return -1;
+	}
+
+	debug_trace_stop();
+
+	_debug_trace.events = malloc((size_t) capacity * sizeof(debug_event_t));
+	if(_debug_trace.events == NULL) {
+		return -1;
+	}
+	_debug_trace.capacity = capacity;
+	_debug_trace.count	  = 0;
+	_debug_trace.path	  = path;
+
+	if(path != NULL && _debug_trace.at_exit == 0) {
+		atexit(_debug_trace_at_exit);
+		_debug_trace.at_exit = 1;
+	}
+
+	// without it the rings are only drained when someone collects.
+	atomic_store(&_debug_trace.collecting, 1);
+	if(_debug_trace_thread_start() < 0) {
+		atomic_store(&_debug_trace.collecting, 0);
+	}
+
+	return 0;
+}
+
+void debug_trace_stop() {
+	_debug_trace_collect_stop();
+
+	free(_debug_trace.events);
+	_debug_trace.events	  = NULL;
+	_debug_trace.capacity = 0;
+	_debug_trace.count	  = 0;
+	_debug_trace.path	  = NULL;
+}
+
+int debug_trace_write(const char*					 path,
+					  const enum debug_trace_format_t format) {
+	if(path == NULL || _debug_trace.events == NULL) {
+		return -1;
+	}
+
+	FILE* file = fopen(path, format == DEBUG_TRACE_JSON ? "w" : "wb");
+	if(file == NULL) {
+		return -1;
+	}
+
+	// the collector would keep adding events while they are written.
+	_debug_prof_lock_take();
+	_debug_prof_drain();
+
+	uint64_t count = _debug_trace.count;
+	uint64_t first = count > (uint64_t) _debug_trace.capacity
+						 ? count - _debug_trace.capacity
+						 : 0;
+
+	if(format == DEBUG_TRACE_JSON) {
+		_debug_trace_json(file, first, count);
+	}
+	else {
+		_debug_trace_binary(file, first, count);
+	}
+
+	_debug_prof_lock_give();
+
+	return fclose(file) == 0 ? 0 : -1;
 }
@@ -1,8 +1,10 @@
 #include "inpt.h"
 
 #include "debug.h"
+#include "inpt_bind.h"
 #include "rhid.h"
 
+#include <stdatomic.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -13,8 +15,17 @@
 
 static struct inpt_t inpt = {0};
 
+// Tables built from a binding by inpt_bind_build, maybe on another thread.
+// state goes 0 free, 1 building, 2 waiting for inpt_update to swap them in.
+static struct {
+	atomic_int			state;
+	struct inpt_names_t names;
+	int					states[STATE_COUNT];
+	inpt_act_t			actions[ACTION_COUNT];
+} inpt_staged = {0};
+
 // Hash function from http://www.cse.yorku.ca/~oz/hash.html
-static unsigned long inpt_hash(char* str) {
+static unsigned long inpt_hash(const char* str) {
 	unsigned long hash = 5381;
 	int			  c;
 
@@ -24,6 +35,100 @@ static unsigned long inpt_hash(char* str) {
 	return hash;
 }
 
+// Find the table slot holding name, or the empty slot it would go in. The
+// hash only picks where to start, names are always compared in full.
+static int inpt_name_slot(struct inpt_names_t* names, const char* name,
+						  unsigned long hash) {
+	int slot = hash & (NAME_SLOTS - 1);
+
+	while(names->slots[slot] != 0) {
+		struct inpt_name_t* entry = &names->ids[names->slots[slot]];
+		if(entry->hash == hash && strcmp(entry->str, name) == 0) {
+			break;
+		}
+
+		slot = (slot + 1) & (NAME_SLOTS - 1);
+	}
+
+	return slot;
+}
+
+static int inpt_name_intern(struct inpt_names_t* names, const char* name) {
+	if(name == NULL) {
+		return -1;
+	}
+
+	unsigned long hash = inpt_hash(name);
+	int			  slot = inpt_name_slot(names, name, hash);
+	if(names->slots[slot] != 0) {
+		return names->slots[slot];
+	}
+
+	int length = strlen(name) + 1;
+	if(names->count >= MAX_NAMES ||
+	   names->pool_used + length > NAME_POOL_SIZE) {
+		DEBUG_LOG_WRN("no room left to intern '%s'", name);
+		return -1;
+	}
+
+	int					id	  = ++names->count;
+	struct inpt_name_t* entry = &names->ids[id];
+
+	entry->str	= memcpy(names->pool + names->pool_used, name, length);
+	entry->hash = hash;
+	names->pool_used += length;
+	names->slots[slot] = id;
+
+	return id;
+}
+
+static int inpt_name_find(struct inpt_names_t* names, const char* name) {
+	if(name == NULL) {
+		return -1;
+	}
+
+	int id = names->slots[inpt_name_slot(names, name, inpt_hash(name))];
+	return id == 0 ? -1 : id;
+}
+
+static struct inpt_name_t* inpt_name_get(int id) {
+	if(id < 1 || id > inpt.names.count) {
+		return NULL;
+	}
+
+	return &inpt.names.ids[id];
+}
+
+// The slot of the state with this name, or -1 if it isn't a state.
+static int inpt_state_slot(int id) {
+	struct inpt_name_t* name = inpt_name_get(id);
+	if(name == NULL) {
+		return -1;
+	}
+
+	return name->state - 1;
+}
+
+/**
+ * @brief Intern a name. The same name always gets the same id.
+ *
+ * @param name the name to intern, it is copied.
+ * @return int the id of the name or -1 on failure.
+ */
+LIBINPT int inpt_intern(const char* name) {
+	return inpt_name_intern(&inpt.names, name);
+}
+
+// Same as inpt_intern but never adds the name.
+LIBINPT int inpt_intern_find(const char* name) {
+	return inpt_name_find(&inpt.names, name);
+}
+
+LIBINPT const char* inpt_intern_name(int id) {
+	struct inpt_name_t* name = inpt_name_get(id);
+	return name == NULL ? NULL : name->str;
+}
+
 LIBINPT const char* inpt_version() {
 	// C macros are dumb so macros are stringified before they are evaulated.
 	// To solve this, you can use another macro function to stringify and then
@@ -153,11 +258,275 @@ done:
 }
 #endif
 
+// Call the trigger events listening to a gesture, if it reports this edge.
+static void inpt_act_fire(inpt_act_t* action, int flag) {
+	if((action->flags & flag) == 0) {
+		return;
+	}
+
+	DEBUG_LOG_INF("triggered action %s", action->name);
+
+	for(int i = 0; i < MAX_ACT_TRIGGER_EVENTS; i++) {
+		if(inpt.on_act_triggers[i].event == NULL ||
+		   inpt.on_act_triggers[i].action != action) {
+			continue;
+		}
+
+		inpt.on_act_triggers[i].event(flag);
+	}
+}
+
+// Wake the gesture up again once its deadline passes.
+static void inpt_act_arm(inpt_act_t* action) {
+	int index = action - inpt.actions;
+	BITFLD_SET(inpt.gestures_armed, index);
+
+	if(inpt.gestures_deadline == 0 ||
+	   action->deadline_ns < inpt.gestures_deadline) {
+		inpt.gestures_deadline = action->deadline_ns;
+	}
+}
+
+// Advance a gesture's state machine. Only called on the ticks one of its
+// inputs is pressed or released, or after its deadline passes.
+static void inpt_act_step(inpt_act_t* action, uint64_t now) {
+	int down	 = 0;
+	int pressed	 = 0;
+	int released = 0;
+
+	for(int i = 0; i < action->input_count; i++) {
+		enum inpt_btn_state_t state = inpt.btn_states[action->inputs[i]];
+
+		down += (state & (INPT_BTN_PRESSED | INPT_BTN_HELD)) != 0;
+		pressed |= (state == INPT_BTN_PRESSED) << i;
+		released |= (state == INPT_BTN_RELEASED) << i;
+	}
+
+	DEBUG_COUNT("inpt.gesture_steps", 1);
+
+	switch(action->type) {
+		case INPT_ACT_CHORD: // CHORD
+			// 0 idle, 1 gathering buttons, 2 held.
+			// The chord breaks as soon as any of its buttons let go.
+			if(released) {
+				if(action->step == 2) {
+					inpt_act_fire(action, INPT_BTN_RELEASED);
+				}
+				action->step = 0;
+			}
+
+			if(pressed && action->step == 0) {
+				action->step		= 1;
+				action->deadline_ns = now + action->window_ns;
+			}
+
+			// Too slow stays gathering until something lets go.
+			if(action->step == 1 && down == action->input_count &&
+			   (action->window_ns == 0 || now <= action->deadline_ns)) {
+				action->step = 2;
+				inpt_act_fire(action, INPT_BTN_PRESSED);
+			}
+			break;
+
+		case INPT_ACT_SEQUENCE: // SEQUENCE
+			// step is the next input expected.
+			if(inpt.btn_press_count == 0) {
+				break;
+			}
+
+			// Any other button, in the sequence or not, or the right one too
+			// late starts over.
+			if(action->step > 0 &&
+			   (inpt.btn_press_count > ((pressed >> action->step) & 1) ||
+				(action->window_ns != 0 && now > action->deadline_ns))) {
+				action->step = 0;
+			}
+
+			if((pressed & (1 << action->step)) == 0) {
+				break;
+			}
+
+			action->step++;
+			action->deadline_ns = now + action->window_ns;
+
+			if(action->step == action->input_count) {
+				action->step = 0;
+				inpt_act_fire(action, INPT_BTN_PRESSED);
+			}
+			break;
+
+		case INPT_ACT_DOUBLE_TAP: // DOUBLE TAP
+			if(! pressed) {
+				break;
+			}
+
+			if(action->step == 1 && now <= action->deadline_ns) {
+				action->step = 0;
+				inpt_act_fire(action, INPT_BTN_PRESSED);
+				break;
+			}
+
+			action->step		= 1;
+			action->deadline_ns = now + action->window_ns;
+			break;
+
+		case INPT_ACT_LONG_PRESS: // LONG PRESS
+			// 0 idle, 1 waiting on the hold time, 2 held long enough.
+			if(pressed) {
+				action->step		= 1;
+				action->deadline_ns = now + action->window_ns;
+				inpt_act_arm(action);
+				break;
+			}
+
+			if(released) {
+				if(action->step == 2) {
+					inpt_act_fire(action, INPT_BTN_RELEASED);
+				}
+				action->step = 0;
+				break;
+			}
+
+			if(action->step != 1) {
+				break;
+			}
+
+			// Woken by another gesture's deadline.
+			if(now < action->deadline_ns) {
+				inpt_act_arm(action);
+				break;
+			}
+
+			action->step = 2;
+			inpt_act_fire(action, INPT_BTN_PRESSED);
+			break;
+
+		default:
+			break;
+	}
+}
+
+// Queue a state change to be applied after the action scan.
+static void inpt_state_queue(int state_index, inpt_act_t* action) {
+	if(inpt.transition_count >= MAX_STATE_TRANSITIONS) {
+		DEBUG_LOG_WRN("too many state changes, dropping '%s'", action->name);
+		DEBUG_COUNT("inpt.transitions_dropped", 1);
+		return;
+	}
+
+	inpt.transitions[inpt.transition_count].state_index = state_index;
+	inpt.transitions[inpt.transition_count].action		= action;
+	inpt.transition_count++;
+}
+
+// Apply the queued state changes. Changes to the current state are dropped,
+// then the highest priority wins and ties go to whichever queued first, which
+// is the lowest action index.
+static void inpt_state_commit() {
+	int winner = -1;
+	int count  = 0;
+
+	for(int i = 0; i < inpt.transition_count; i++) {
+		if(inpt.transitions[i].state_index == inpt.state_index) {
+			continue;
+		}
+
+		count++;
+
+		if(winner == -1 || inpt.transitions[i].action->priority >
+							   inpt.transitions[winner].action->priority) {
+			winner = i;
+		}
+	}
+
+	inpt.transition_count = 0;
+
+	if(winner == -1) {
+		return;
+	}
+
+	if(count > 1) {
+		DEBUG_LOG_INF("%i state changes on one update, '%s' won", count,
+					  inpt.transitions[winner].action->name);
+		DEBUG_COUNT("inpt.transition_conflicts", count - 1);
+	}
+
+	unsigned long state		= inpt.states[inpt.state_index];
+	unsigned long new_state = inpt.states[inpt.transitions[winner].state_index];
+
+	DEBUG_MARK("state change");
+	DEBUG_LOG_INF("state changed %lu -> %lu", state, new_state);
+
+	for(int i = 0; i < MAX_ACT_STATE_CHANGE_EVENTS; i++) {
+		if(inpt.on_act_state_changes[i] == NULL) {
+			continue;
+		}
+
+		inpt.on_act_state_changes[i](state, new_state);
+	}
+
+	inpt.state_index = inpt.transitions[winner].state_index;
+	inpt.state_set	 = NULL;
+}
+
+// Forget every action list, for when the actions or their states change.
+static void inpt_state_sets_clear() {
+	inpt.state_generation++;
+	inpt.state_set = NULL;
+}
+
+// Find the action list for the base state and the layers on top of it,
+// building it if this set of states hasn't been seen since the actions last
+// changed.
+static struct inpt_state_set_t* inpt_state_set_get() {
+	uint8_t states[STATE_COUNT / 8];
+	memcpy(states, inpt.layers, sizeof(states));
+	BITFLD_SET(states, inpt.state_index);
+
+	for(int i = 0; i < MAX_STATE_SETS; i++) {
+		struct inpt_state_set_t* set = &inpt.state_sets[i];
+		if(set->generation == inpt.state_generation &&
+		   memcmp(set->states, states, sizeof(states)) == 0) {
+			return set;
+		}
+	}
+
+	struct inpt_state_set_t* set = &inpt.state_sets[inpt.state_set_next];
+	inpt.state_set_next			 = (inpt.state_set_next + 1) % MAX_STATE_SETS;
+
+	memcpy(set->states, states, sizeof(states));
+	set->generation	  = inpt.state_generation;
+	set->action_count = 0;
+
+	for(int i = 0; i < ACTION_COUNT; i++) {
+		if(inpt.actions[i].name == NULL) {
+			continue;
+		}
+
+		for(int j = 0; j < STATE_COUNT / 8; j++) {
+			if(inpt.actions[i].states[j] & states[j]) {
+				set->actions[set->action_count++] = i;
+				break;
+			}
+		}
+	}
+
+	DEBUG_COUNT("inpt.state_set_builds", 1);
+
+	return set;
+}
+
+static void inpt_bind_swap();
+
 LIBINPT int inpt_update() {
-	// Update device list.
-	// TODO Since this might be expensive, consider doing ever x number of
-	// updates instead.
-	//		Better yet, do it on a timer.
+	uint64_t update_start = debug_time_ns();
+	inpt.btn_press_count  = 0;
+
+	// New bindings go in between updates so no action sees half of them.
+	inpt_bind_swap();
+
+	// Update device list. rhid only enumerates again after a hot-plug, so
+	// asking every tick is cheap.
 
 	// FIXME To continue the above TODO, doing rhid_get_devices will overwrite
 	// the previous devices.
@@ -199,6 +568,12 @@ LIBINPT int inpt_update() {
 		rhid_report(inpt.dev_selected, 0);
 		DEBUG_TIME_STOP();
 
+		// whatever outputs were set since the last update go out as one
+		// write, the read above never waits on it.
+		DEBUG_TIME_START("HID write");
+		rhid_write(inpt.dev_selected);
+		DEBUG_TIME_STOP();
+
 		DEBUG_TIME_START("state copy");
 		rhid_get_buttons_state(inpt.dev_selected, inpt.hid.btns,
 							   inpt.hid.btn_count);
@@ -221,6 +596,21 @@ LIBINPT int inpt_update() {
 
 			inpt.btn_states[i] = new_state;
 
+			// Wake the gestures listening to this button, and every sequence
+			// on a press so a button outside it starts it over.
+			if(new_state == INPT_BTN_PRESSED ||
+			   new_state == INPT_BTN_RELEASED) {
+				for(int j = 0; j < ACTION_COUNT / 8; j++) {
+					inpt.gestures_dirty[j] |= inpt.btn_gestures[i][j];
+				}
+			}
+			if(new_state == INPT_BTN_PRESSED) {
+				inpt.btn_press_count++;
+				for(int j = 0; j < ACTION_COUNT / 8; j++) {
+					inpt.gestures_dirty[j] |= inpt.gestures_sequences[j];
+				}
+			}
+
 			for(int j = 0; j < MAX_HID_BTN_EVENTS; j++) {
 				if(inpt.on_hid_btns[j] == NULL) {
 					continue;
@@ -250,14 +640,26 @@ LIBINPT int inpt_update() {
 	// Update actions.
 	DEBUG_TIME_START("updating actions");
 
-	for(int i = 0; i < ACTION_COUNT; i++) {
-		const inpt_act_t* action = &inpt.actions[i];
-
-		// Check to see if the action can run in the current state.
-		if(action == NULL || ! (BITFLD_GET(action->states, inpt.state_index))) {
-			continue;
+	// Wake the long presses whose hold time is up.
+	if(inpt.gestures_deadline != 0 && update_start >= inpt.gestures_deadline) {
+		for(int i = 0; i < ACTION_COUNT / 8; i++) {
+			inpt.gestures_dirty[i] |= inpt.gestures_armed[i];
 		}
 
+		memset(inpt.gestures_armed, 0, sizeof(inpt.gestures_armed));
+		inpt.gestures_deadline = 0;
+	}
+
+	// Only the actions that can run in the current states are walked.
+	if(inpt.state_set == NULL) {
+		inpt.state_set = inpt_state_set_get();
+	}
+
+	const struct inpt_state_set_t* set = inpt.state_set;
+	for(int k = 0; k < set->action_count; k++) {
+		int			i	   = set->actions[k];
+		inpt_act_t* action = &inpt.actions[i];
+
 		// Don't proccess actions that have an input mod but it isn't
 		// pressed.
 		if(action->input_mod != -1 &&
@@ -277,31 +679,11 @@ LIBINPT int inpt_update() {
 					break;
 				}
 
-				// Get the new state index as we switch states.
-				for(int i = 0; i < STATE_COUNT; i++) {
-					if(inpt.states[i] != action->new_state) {
-						continue;
-					}
-
-					printf("state changed %ld -> %ld\n",
-						   inpt.states[inpt.state_index], inpt.states[i]);
-
-					for(int j = 0; j < MAX_ACT_STATE_CHANGE_EVENTS; j++) {
-						if(inpt.on_act_state_changes[j] == NULL) {
-							continue;
-						}
-
-						inpt.on_act_state_changes[j](
-							inpt.states[inpt.state_index], action->new_state);
-					}
-
-					// TODO I doubt this is nessesary but it would probably
-					// be more correct to queue the change in state so other
-					// actions in the array aren't affected
-					// until next cycle.
-					inpt.state_index = i;
-
-					break;
+				// Get the new state index, the switch itself waits until
+				// every action has run.
+				int state = inpt_state_slot(action->new_state);
+				if(state != -1) {
+					inpt_state_queue(state, action);
 				}
 
 				break;
@@ -319,10 +701,11 @@ LIBINPT int inpt_update() {
 					break;
 				}
 
-				printf("triggered action %s\n", action->name);
+				DEBUG_LOG_INF("triggered action %s", action->name);
 
 				for(int j = 0; j < MAX_ACT_TRIGGER_EVENTS; j++) {
-					if(inpt.on_act_triggers[j].event == NULL) {
+					if(inpt.on_act_triggers[j].event == NULL ||
+					   inpt.on_act_triggers[j].action != action) {
 						continue;
 					}
 
@@ -338,11 +721,12 @@ LIBINPT int inpt_update() {
 					break;
 				}
 
-				printf("value action %s set to %d\n", action->name,
-					   inpt.hid.vals[action->input]);
+				DEBUG_LOG_INF("value action %s set to %d", action->name,
+							  inpt.hid.vals[action->input]);
 
 				for(int j = 0; j < MAX_ACT_VALUE_EVENTS; j++) {
-					if(inpt.on_act_values[j].event == NULL) {
+					if(inpt.on_act_values[j].event == NULL ||
+					   inpt.on_act_values[j].action != action) {
 						continue;
 					}
 
@@ -350,20 +734,54 @@ LIBINPT int inpt_update() {
 				}
 				break;
 
+			case INPT_ACT_CHORD:
+			case INPT_ACT_SEQUENCE:
+			case INPT_ACT_DOUBLE_TAP:
+			case INPT_ACT_LONG_PRESS: // GESTURES
+				// Idle gestures only cost this check.
+				if(! (BITFLD_GET(inpt.gestures_dirty, i))) {
+					break;
+				}
+
+				inpt_act_step(action, update_start);
+				BITFLD_CLR(inpt.gestures_dirty, i);
+				break;
+
 			default:
-				fprintf(stderr,
-						"inpt tried to call action '%s' but the action didn't "
-						"have a type.\n",
-						action->name);
+				DEBUG_LOG_WRN("inpt tried to call action '%s' but the action "
+							  "didn't have a type.",
+							  action->name);
 		}
 	}
 	DEBUG_TIME_STOP();
 
+	// Gestures woken while their states aren't active or their input mod
+	// isn't held start over, otherwise they would wait on an edge or a
+	// deadline that has already gone by.
+	for(int j = 0; j < ACTION_COUNT / 8; j++) {
+		if(inpt.gestures_dirty[j] == 0) {
+			continue;
+		}
+
+		for(int k = 0; k < 8; k++) {
+			if(inpt.gestures_dirty[j] & (1 << k)) {
+				inpt.actions[j * 8 + k].step = 0;
+			}
+		}
+		inpt.gestures_dirty[j] = 0;
+	}
+
+	inpt_state_commit();
+
 	// copy current hid data over to the previous hid data in preperation for
 	// the next cycle.
 	memcpy(&inpt.hid_prev, &inpt.hid, sizeof(inpt_hid_t));
 	memcpy(&inpt.btn_states_prev, &inpt.btn_states, sizeof(inpt.btn_states));
 
+	DEBUG_COUNT("inpt.updates", 1);
+	DEBUG_GAUGE("inpt.devices", inpt.dev_count);
+	DEBUG_HIST("inpt.update_ns", debug_time_ns() - update_start);
+
 	return 0;
 }
 
@@ -374,9 +792,46 @@ LIBINPT int inpt_update() {
  * @return int 0 on success and -1 on failure.
  */
 LIBINPT int inpt_state_add(char* state) {
+	return inpt_state_add_id(inpt_intern(state));
+}
+
+LIBINPT int inpt_state_del(char* state) {
+	return inpt_state_del_id(inpt_intern_find(state));
+}
+
+/**
+ * @brief Turn on a state as a layer over the current state. Actions in any
+ * active layer run as well as the ones in the current state.
+ *
+ * @param state the name of the state to layer.
+ * @return int 0 on success and -1 on failure.
+ */
+LIBINPT int inpt_state_layer_add(char* state) {
+	return inpt_state_layer_add_id(inpt_intern_find(state));
+}
+
+LIBINPT int inpt_state_layer_del(char* state) {
+	return inpt_state_layer_del_id(inpt_intern_find(state));
+}
+
+LIBINPT int inpt_state_set(char* state, char* new_state) {
+	return inpt_state_set_id(inpt_intern_find(state), inpt_intern(new_state));
+}
+
+LIBINPT int inpt_state_add_id(int state) {
+	struct inpt_name_t* name = inpt_name_get(state);
+	if(name == NULL) {
+		return -1;
+	}
+
+	if(name->state != 0) {
+		return 0;
+	}
+
 	for(int i = 0; i < STATE_COUNT; i++) {
 		if(inpt.states[i] == 0) {
-			inpt.states[i] = inpt_hash(state);
+			inpt.states[i] = state;
+			name->state	   = i + 1;
 			return 0;
 		}
 	}
@@ -384,30 +839,61 @@ LIBINPT int inpt_state_add(char* state) {
 	return -1;
 }
 
-LIBINPT int inpt_state_del(char* state) {
-	unsigned long hash = inpt_hash(state);
+LIBINPT int inpt_state_del_id(int state) {
+	int i = inpt_state_slot(state);
+	if(i == -1) {
+		return -1;
+	}
 
-	for(int i = 0; i < STATE_COUNT; i++) {
-		if(inpt.states[i] == hash) {
-			inpt.states[i] = 0;
-			return 0;
-		}
+	inpt.states[i]				= 0;
+	inpt.names.ids[state].state = 0;
+	BITFLD_CLR(inpt.layers, i);
+
+	// Whatever state gets this slot next starts without any actions.
+	for(int j = 0; j < ACTION_COUNT; j++) {
+		BITFLD_CLR(inpt.actions[j].states, i);
 	}
+	inpt_state_sets_clear();
 
-	return -1;
+	return 0;
 }
 
-LIBINPT int inpt_state_set(char* state, char* new_state) {
-	unsigned long hash = inpt_hash(state);
+LIBINPT int inpt_state_set_id(int state, int new_state) {
+	int					i	 = inpt_state_slot(state);
+	struct inpt_name_t* name = inpt_name_get(new_state);
+	if(i == -1 || name == NULL || name->state != 0) {
+		return -1;
+	}
 
-	for(int i = 0; i < STATE_COUNT; i++) {
-		if(inpt.states[i] == hash) {
-			inpt.states[i] = inpt_hash(new_state);
-			return 0;
-		}
+	inpt.states[i]				= new_state;
+	inpt.names.ids[state].state = 0;
+	name->state					= i + 1;
+
+	return 0;
+}
+
+LIBINPT int inpt_state_layer_add_id(int state) {
+	int i = inpt_state_slot(state);
+	if(i == -1) {
+		return -1;
 	}
 
-	return -1;
+	BITFLD_SET(inpt.layers, i);
+	inpt.state_set = NULL;
+
+	return 0;
+}
+
+LIBINPT int inpt_state_layer_del_id(int state) {
+	int i = inpt_state_slot(state);
+	if(i == -1) {
+		return -1;
+	}
+
+	BITFLD_CLR(inpt.layers, i);
+	inpt.state_set = NULL;
+
+	return 0;
 }
 
 LIBINPT inpt_act_t* inpt_act_new_state_change(char* name, char** states,
@@ -417,7 +903,9 @@ LIBINPT inpt_act_t* inpt_act_new_state_change(char* name, char** states,
 	for(int i = 0; i < ACTION_COUNT; i++) {
 		if(inpt.actions[i].name == NULL) {
 			// set name.
-			inpt_act_set_name(&inpt.actions[i], name);
+			if(inpt_act_set_name(&inpt.actions[i], name) < 0) {
+				return NULL;
+			}
 			inpt_act_set_type(&inpt.actions[i], INPT_ACT_STATE_CHANGE);
 
 			// add states.
@@ -431,7 +919,7 @@ LIBINPT inpt_act_t* inpt_act_new_state_change(char* name, char** states,
 
 			// set state change state.
 			// TODO add function to set new_state.
-			inpt.actions[i].new_state = inpt_hash(newstate);
+			inpt.actions[i].new_state = inpt_intern(newstate);
 
 			// set input flags.
 			inpt_act_set_flags(&inpt.actions[i], flags);
@@ -449,7 +937,9 @@ LIBINPT inpt_act_t* inpt_act_new_trigger(char* name, char** states,
 	for(int i = 0; i < ACTION_COUNT; i++) {
 		if(inpt.actions[i].name == NULL) {
 			// set name.
-			inpt_act_set_name(&inpt.actions[i], name);
+			if(inpt_act_set_name(&inpt.actions[i], name) < 0) {
+				return NULL;
+			}
 			inpt_act_set_type(&inpt.actions[i], INPT_ACT_TRIGGER);
 
 			// add states.
@@ -477,7 +967,9 @@ LIBINPT inpt_act_t* inpt_act_new_value(char* name, char** states,
 	for(int i = 0; i < ACTION_COUNT; i++) {
 		if(inpt.actions[i].name == NULL) {
 			// set name.
-			inpt_act_set_name(&inpt.actions[i], name);
+			if(inpt_act_set_name(&inpt.actions[i], name) < 0) {
+				return NULL;
+			}
 			inpt_act_set_type(&inpt.actions[i], INPT_ACT_VALUE);
 
 			// add states.
@@ -499,38 +991,170 @@ LIBINPT inpt_act_t* inpt_act_new_value(char* name, char** states,
 	return NULL;
 }
 
-LIBINPT int inpt_act_del(char* name) {
-	long hash = inpt_hash(name);
+// Rebuild which buttons wake the action at index.
+static void inpt_act_compile(int index) {
+	inpt_act_t* action = &inpt.actions[index];
+
+	for(int i = 0; i < MAX_BUTTONS; i++) {
+		inpt.btn_gestures[i][index / 8] &= ~(1 << index % 8);
+	}
+	BITFLD_CLR(inpt.gestures_sequences, index);
+
+	if(action->type < INPT_ACT_CHORD) {
+		return;
+	}
+
+	if(action->type == INPT_ACT_SEQUENCE) {
+		BITFLD_SET(inpt.gestures_sequences, index);
+	}
+
+	for(int i = 0; i < action->input_count; i++) {
+		BITFLD_SET(inpt.btn_gestures[action->inputs[i]], index);
+	}
+}
+
+static inpt_act_t* inpt_act_new_gesture(char* name, int type, char** states,
+										int state_count, int input_mod,
+										int* inputs, int input_count,
+										int window_ms, int flags) {
 	for(int i = 0; i < ACTION_COUNT; i++) {
-		if(inpt.actions[i].name_hash == hash) {
-			memset(&inpt.actions[i], 0, sizeof(inpt_act_t));
-			return 0;
+		if(inpt.actions[i].name == NULL) {
+			// set name.
+			if(inpt_act_set_name(&inpt.actions[i], name) < 0) {
+				return NULL;
+			}
+			inpt_act_set_type(&inpt.actions[i], type);
+
+			// add states.
+			for(int j = 0; j < state_count; j++) {
+				inpt_act_add_state(&inpt.actions[i], states[j]);
+			}
+
+			// set input mod and inputs, this also hooks the gesture up to its
+			// buttons.
+			inpt_act_set_input_mod(&inpt.actions[i], input_mod);
+			if(inpt_act_set_inputs(&inpt.actions[i], inputs, input_count) < 0) {
+				// give the name back too, or it still finds the empty slot.
+				inpt.names.ids[inpt.actions[i].name_id].action = 0;
+				memset(&inpt.actions[i], 0, sizeof(inpt_act_t));
+				inpt_state_sets_clear();
+				return NULL;
+			}
+			inpt_act_set_input(&inpt.actions[i], inputs[0]);
+
+			inpt_act_set_window(&inpt.actions[i], window_ms);
+
+			// set input flags.
+			inpt_act_set_flags(&inpt.actions[i], flags);
+
+			return &inpt.actions[i];
 		}
 	}
 
-	return -1;
+	return NULL;
+}
+
+LIBINPT inpt_act_t* inpt_act_new_chord(char* name, char** states,
+									   int state_count, int input_mod,
+									   int* inputs, int input_count,
+									   int window_ms, int flags) {
+	return inpt_act_new_gesture(name, INPT_ACT_CHORD, states, state_count,
+								input_mod, inputs, input_count, window_ms,
+								flags);
+}
+
+LIBINPT inpt_act_t* inpt_act_new_sequence(char* name, char** states,
+										  int state_count, int input_mod,
+										  int* inputs, int input_count,
+										  int window_ms, int flags) {
+	return inpt_act_new_gesture(name, INPT_ACT_SEQUENCE, states, state_count,
+								input_mod, inputs, input_count, window_ms,
+								flags);
+}
+
+LIBINPT inpt_act_t* inpt_act_new_double_tap(char* name, char** states,
+											int state_count, int input_mod,
+											int input, int window_ms,
+											int flags) {
+	return inpt_act_new_gesture(name, INPT_ACT_DOUBLE_TAP, states, state_count,
+								input_mod, &input, 1, window_ms, flags);
+}
+
+LIBINPT inpt_act_t* inpt_act_new_long_press(char* name, char** states,
+											int state_count, int input_mod,
+											int input, int hold_ms, int flags) {
+	return inpt_act_new_gesture(name, INPT_ACT_LONG_PRESS, states, state_count,
+								input_mod, &input, 1, hold_ms, flags);
+}
+
+LIBINPT int inpt_act_del(char* name) {
+	return inpt_act_del_id(inpt_intern_find(name));
 }
 
 inpt_act_t* inpt_act_get(char* name) {
-	unsigned long hash = inpt_hash(name);
+	return inpt_act_get_id(inpt_intern_find(name));
+}
 
-	for(int i = 0; i < ACTION_COUNT; i++) {
-		if(inpt.actions[i].name_hash == hash) {
-			return &inpt.actions[i];
+LIBINPT int inpt_act_del_id(int name) {
+	inpt_act_t* action = inpt_act_get_id(name);
+	if(action == NULL) {
+		return -1;
+	}
+
+	// nothing is left listening to the freed slot.
+	for(int j = 0; j < MAX_ACT_TRIGGER_EVENTS; j++) {
+		if(inpt.on_act_triggers[j].action == action) {
+			inpt.on_act_triggers[j].event  = NULL;
+			inpt.on_act_triggers[j].action = NULL;
+		}
+	}
+	for(int j = 0; j < MAX_ACT_VALUE_EVENTS; j++) {
+		if(inpt.on_act_values[j].action == action) {
+			inpt.on_act_values[j].event	 = NULL;
+			inpt.on_act_values[j].action = NULL;
 		}
 	}
 
-	return NULL;
+	int i = action - inpt.actions;
+	memset(action, 0, sizeof(inpt_act_t));
+	inpt.names.ids[name].action = 0;
+	inpt_act_compile(i);
+	inpt_state_sets_clear();
+
+	return 0;
+}
+
+LIBINPT inpt_act_t* inpt_act_get_id(int name) {
+	struct inpt_name_t* entry = inpt_name_get(name);
+	if(entry == NULL || entry->action == 0) {
+		return NULL;
+	}
+
+	return &inpt.actions[entry->action - 1];
 }
 
 LIBINPT int inpt_act_set_name(inpt_act_t* action, char* name) {
-	action->name	  = name;
-	action->name_hash = inpt_hash(name);
+	int id = inpt_intern(name);
+	if(id == -1) {
+		return -1;
+	}
+
+	int					index = action - inpt.actions;
+	struct inpt_name_t* old	  = inpt_name_get(action->name_id);
+	if(old != NULL && old->action == index + 1) {
+		old->action = 0;
+	}
+
+	action->name			   = inpt.names.ids[id].str;
+	action->name_id			   = id;
+	inpt.names.ids[id].action = index + 1;
+
 	return 0;
 }
 
 LIBINPT int inpt_act_set_type(inpt_act_t* action, int type) {
 	action->type = type;
+	inpt_state_sets_clear();
 	return 0;
 }
 
@@ -544,11 +1168,41 @@ LIBINPT int inpt_act_set_input(inpt_act_t* action, int input) {
 	return 0;
 }
 
+LIBINPT int inpt_act_set_inputs(inpt_act_t* action, int* inputs, int count) {
+	if(count < 1 || count > INPT_ACT_INPUT_COUNT) {
+		return -1;
+	}
+
+	for(int i = 0; i < count; i++) {
+		if(inputs[i] < 0 || inputs[i] >= MAX_BUTTONS) {
+			return -1;
+		}
+	}
+
+	memcpy(action->inputs, inputs, count * sizeof(int));
+	action->input_count = count;
+	action->step		= 0;
+
+	inpt_act_compile(action - inpt.actions);
+
+	return 0;
+}
+
+LIBINPT int inpt_act_set_window(inpt_act_t* action, int window_ms) {
+	action->window_ns = (uint64_t) window_ms * 1000000;
+	return 0;
+}
+
 LIBINPT int inpt_act_set_flags(inpt_act_t* action, int flags) {
 	action->flags = flags;
 	return 0;
 }
 
+LIBINPT int inpt_act_set_priority(inpt_act_t* action, int priority) {
+	action->priority = priority;
+	return 0;
+}
+
 LIBINPT int inpt_act_set_point(inpt_act_t* action, int index, int x, int y) {
 	if(index >= action->point_count || index >= INPT_ACT_POINT_COUNT) {
 		return -1;
@@ -629,63 +1283,54 @@ LIBINPT int inpt_act_del_point(inpt_act_t* action, int index) {
 }
 
 LIBINPT int inpt_act_add_state(inpt_act_t* action, char* state) {
-	unsigned long hash = inpt_hash(state);
-
 	// If the state string is "all" or the more novel "ALL!!!!", enable all of
-	// the states. Again if this was a bitfield instead we could just use a
-	// memset and be good to go.
-	if(hash == inpt_hash("all") || hash == inpt_hash("ALL")) {
-		// for(int i = 0; i < STATE_COUNT; i++) {
-		//     action->states[i] = inpt.states[i];
-		// }
-
-		memset(action->states, 1, sizeof(action->states));
-
-		return 0;
-	}
-
-	for(int i = 0; i < STATE_COUNT; i++) {
-		if(inpt.states[i] != hash) {
-			continue;
-		}
+	// the states.
+	if(strcmp(state, "all") == 0 || strcmp(state, "ALL") == 0) {
+		memset(action->states, 0xff, sizeof(action->states));
+		inpt_state_sets_clear();
 
-		BITFLD_SET(action->states, i);
 		return 0;
 	}
 
-	return -1;
+	return inpt_act_add_state_id(action, inpt_intern_find(state));
 }
 
 LIBINPT int inpt_act_del_state(inpt_act_t* action, char* state) {
-	unsigned long hash = inpt_hash(state);
-
 	// If state is one of all of the Alls, set everything to zero.
 	// See, we are being clever because all is usually used to allow everthing
 	// but if you delete all you have nothing. It isn't that clever actually...
-	if(hash == inpt_hash("all") || hash == inpt_hash("ALL")) {
+	if(strcmp(state, "all") == 0 || strcmp(state, "ALL") == 0) {
 		memset(action->states, 0, sizeof(action->states));
+		inpt_state_sets_clear();
 
 		return 0;
 	}
 
-	// Use search and destroy technology to find that hash and delete it.
-	for(int i = 0; i < STATE_COUNT; i++) {
-		// if(action->states[i] != hash) {
-		//     continue;
-		// }
+	return inpt_act_del_state_id(action, inpt_intern_find(state));
+}
+
+LIBINPT int inpt_act_add_state_id(inpt_act_t* action, int state) {
+	int i = inpt_state_slot(state);
+	if(i == -1) {
+		return -1;
+	}
 
-		// action->states[i] = 0;
-		// return 0;
+	BITFLD_SET(action->states, i);
+	inpt_state_sets_clear();
 
-		if(inpt.states[i] != hash) {
-			continue;
-		}
+	return 0;
+}
 
-		BITFLD_CLR(action->states, i);
-		return 0;
+LIBINPT int inpt_act_del_state_id(inpt_act_t* action, int state) {
+	int i = inpt_state_slot(state);
+	if(i == -1) {
+		return -1;
 	}
 
-	return -1;
+	BITFLD_CLR(action->states, i);
+	inpt_state_sets_clear();
+
+	return 0;
 }
 
 // TODO Listeners are difficult so I empore you to do them later.
@@ -697,8 +1342,10 @@ LIBINPT int inpt_act_on_state_change(inpt_act_t*				  action,
 		}
 
 		inpt.on_act_state_changes[i] = event;
+		return 0;
 	}
-	return 0;
+
+	return -1;
 }
 LIBINPT int inpt_act_on_trigger(inpt_act_t*				action,
 								inpt_act_trigger_evnt_t event) {
@@ -709,9 +1356,10 @@ LIBINPT int inpt_act_on_trigger(inpt_act_t*				action,
 
 		inpt.on_act_triggers[i].event  = event;
 		inpt.on_act_triggers[i].action = action;
+		return 0;
 	}
 
-	return 0;
+	return -1;
 }
 LIBINPT int inpt_act_on_value(inpt_act_t* action, inpt_act_value_evnt_t event) {
 	for(int i = 0; i < MAX_ACT_VALUE_EVENTS; i++) {
@@ -721,9 +1369,10 @@ LIBINPT int inpt_act_on_value(inpt_act_t* action, inpt_act_value_evnt_t event) {
 
 		inpt.on_act_values[i].event	 = event;
 		inpt.on_act_values[i].action = action;
+		return 0;
 	}
 
-	return 0;
+	return -1;
 }
 
 static int inpt_hid_open_and_select(rhid_device_t* device) {
@@ -776,6 +1425,10 @@ LIBINPT int inpt_hid_count() {
 	return real_count >= MAX_DEV_COUNT ? MAX_DEV_COUNT : real_count;
 }
 
+LIBINPT int inpt_hid_cache(const char* path) {
+	return rhid_cache_open(path);
+}
+
 LIBINPT inpt_hid_id_t* inpt_hid_list() {
 	inpt_hid_update_connected();
 
@@ -827,6 +1480,24 @@ LIBINPT int inpt_hid_is_conn() {
 	return 0;
 }
 
+LIBINPT int inpt_hid_set_output(int page, int usage, int value) {
+	if(inpt.dev_selected == NULL) {
+		return -1;
+	}
+
+	return rhid_set_usage(inpt.dev_selected, RHID_REPORT_OUTPUT, page, usage,
+						  value);
+}
+
+LIBINPT int inpt_hid_set_feature(int page, int usage, int value) {
+	if(inpt.dev_selected == NULL) {
+		return -1;
+	}
+
+	return rhid_set_usage(inpt.dev_selected, RHID_REPORT_FEATURE, page, usage,
+						  value);
+}
+
 LIBINPT int inpt_hid_on_btn(inpt_hid_btn_evnt_t event) {
 	for(int i = 0; i < MAX_HID_BTN_EVENTS; i++) {
 		if(inpt.on_hid_btns[i] != NULL) {
@@ -851,3 +1522,294 @@ LIBINPT int inpt_hid_on_val(inpt_hid_val_evnt_t event) {
 
 	return -1;
 }
+
+LIBINPT int inpt_bind_build(const void* data, size_t size) {
+	const inpt_bind_header_t* header = data;
+
+	if(size < sizeof(inpt_bind_header_t) ||
+	   memcmp(header->magic, INPT_BIND_MAGIC, 4) != 0 ||
+	   header->version != INPT_BIND_VERSION ||
+	   header->action_size != sizeof(inpt_bind_action_t) ||
+	   header->state_count > STATE_COUNT ||
+	   header->action_count > ACTION_COUNT || header->string_size == 0 ||
+	   size != sizeof(inpt_bind_header_t) +
+				   header->state_count * sizeof(uint32_t) +
+				   header->action_count * sizeof(inpt_bind_action_t) +
+				   header->string_size) {
+		DEBUG_LOG_ERR("not a binding this version of inpt can load");
+		return -1;
+	}
+
+	const uint32_t* states = (const uint32_t*) (header + 1);
+	const inpt_bind_action_t* actions =
+		(const inpt_bind_action_t*) (states + header->state_count);
+	const char* strings = (const char*) (actions + header->action_count);
+	if(strings[header->string_size - 1] != '\0') {
+		DEBUG_LOG_ERR("binding names aren't terminated");
+		return -1;
+	}
+
+	int expected = 0;
+	if(! atomic_compare_exchange_strong(&inpt_staged.state, &expected, 1)) {
+		return 1;
+	}
+
+	struct inpt_names_t* names = &inpt_staged.names;
+	memset(names, 0, sizeof(inpt_staged.names));
+	memset(inpt_staged.states, 0, sizeof(inpt_staged.states));
+	memset(inpt_staged.actions, 0, sizeof(inpt_staged.actions));
+
+	for(uint32_t i = 0; i < header->state_count; i++) {
+		if(states[i] >= header->string_size) {
+			goto invalid;
+		}
+
+		int id = inpt_name_intern(names, strings + states[i]);
+		if(id == -1 || names->ids[id].state != 0) {
+			goto invalid;
+		}
+
+		inpt_staged.states[i] = id;
+		names->ids[id].state  = i + 1;
+	}
+
+	for(uint32_t i = 0; i < header->action_count; i++) {
+		const inpt_bind_action_t* record = &actions[i];
+		inpt_act_t*				  action = &inpt_staged.actions[i];
+
+		if(record->name >= header->string_size ||
+		   record->type < INPT_ACT_STATE_CHANGE ||
+		   record->type > INPT_ACT_LONG_PRESS || record->input_count < 1 ||
+		   record->input_count > INPT_ACT_INPUT_COUNT ||
+		   record->point_count > INPT_ACT_POINT_COUNT ||
+		   record->input_mod < -1 || record->input_mod >= MAX_BUTTONS ||
+		   record->new_state < -1 ||
+		   record->new_state >= (int32_t) header->state_count) {
+			goto invalid;
+		}
+
+		// value actions read the values, everything else the buttons.
+		int input_max =
+			record->type == INPT_ACT_VALUE ? MAX_VALUES : MAX_BUTTONS;
+		for(int j = 0; j < record->input_count; j++) {
+			if(record->inputs[j] < 0 || record->inputs[j] >= input_max) {
+				goto invalid;
+			}
+
+			action->inputs[j] = record->inputs[j];
+		}
+
+		int id = inpt_name_intern(names, strings + record->name);
+		if(id == -1 || names->ids[id].action != 0) {
+			goto invalid;
+		}
+
+		action->name		  = names->ids[id].str;
+		action->name_id		  = id;
+		names->ids[id].action = i + 1;
+
+		action->type = record->type;
+		memcpy(action->states, record->states, sizeof(action->states));
+		action->input_mod	= record->input_mod;
+		action->input		= record->inputs[0];
+		action->input_count = record->input_count;
+		action->flags		= record->flags;
+		action->priority	= record->priority;
+		action->new_state =
+			record->new_state == -1 ? 0 : inpt_staged.states[record->new_state];
+		action->window_ns = (uint64_t) record->window_ms * 1000000;
+
+		action->point_count = record->point_count;
+		for(int j = 0; j < record->point_count; j++) {
+			action->points[j] =
+				(struct point_t){record->points[j][0], record->points[j][1]};
+		}
+	}
+
+	DEBUG_LOG_INF("built bindings with %u states and %u actions",
+				  header->state_count, header->action_count);
+
+	atomic_store(&inpt_staged.state, 2);
+	return 0;
+
+invalid:
+	DEBUG_LOG_ERR("binding is invalid");
+	atomic_store(&inpt_staged.state, 0);
+	return -1;
+}
+
+// The slot the staged action with this name is swapped into, -1 if the new
+// bindings don't have it.
+static int inpt_bind_follow(inpt_act_t* action, const int* slots) {
+	if(action == NULL || action->name == NULL) {
+		return -1;
+	}
+
+	int id = inpt_name_find(&inpt_staged.names, action->name);
+	if(id == -1 || inpt_staged.names.ids[id].action == 0) {
+		return -1;
+	}
+
+	return slots[inpt_staged.names.ids[id].action - 1];
+}
+
+// Swap in the tables inpt_bind_build made. The staged names are interned into
+// the live table so ids already handed out keep naming the same thing, and an
+// action that is still there keeps its slot so pointers to it stay good. The
+// current state, layers and listeners carry over by name where the new
+// bindings still have them.
+static void inpt_bind_swap() {
+	if(atomic_load(&inpt_staged.state) != 2) {
+		return;
+	}
+
+	struct inpt_names_t* names = &inpt_staged.names;
+
+	// nothing changes unless every new name fits.
+	int count = inpt.names.count;
+	int used  = inpt.names.pool_used;
+	for(int i = 1; i <= names->count; i++) {
+		if(inpt_name_find(&inpt.names, names->ids[i].str) == -1) {
+			count++;
+			used += strlen(names->ids[i].str) + 1;
+		}
+	}
+	if(count > MAX_NAMES || used > NAME_POOL_SIZE) {
+		DEBUG_LOG_ERR("no room left to intern the new bindings' names");
+		atomic_store(&inpt_staged.state, 0);
+		return;
+	}
+
+	int		state_index				= 0;
+	uint8_t layers[STATE_COUNT / 8] = {0};
+	for(int i = 0; i < STATE_COUNT; i++) {
+		if(inpt.states[i] == 0) {
+			continue;
+		}
+
+		int id = inpt_name_find(names, inpt.names.ids[inpt.states[i]].str);
+		if(id == -1 || names->ids[id].state == 0) {
+			continue;
+		}
+
+		int slot = names->ids[id].state - 1;
+		if(i == inpt.state_index) {
+			state_index = slot;
+		}
+		if(BITFLD_GET(inpt.layers, i)) {
+			BITFLD_SET(layers, slot);
+		}
+	}
+
+	// Actions that keep their name keep their slot, the rest fill the gaps.
+	int		slots[ACTION_COUNT];
+	uint8_t taken[ACTION_COUNT / 8] = {0};
+	for(int i = 0; i < ACTION_COUNT; i++) {
+		slots[i] = -1;
+		if(inpt_staged.actions[i].name == NULL) {
+			continue;
+		}
+
+		int id = inpt_name_find(&inpt.names, inpt_staged.actions[i].name);
+		if(id == -1 || inpt.names.ids[id].action == 0) {
+			continue;
+		}
+
+		int slot = inpt.names.ids[id].action - 1;
+		if(BITFLD_GET(taken, slot)) {
+			continue;
+		}
+
+		slots[i] = slot;
+		BITFLD_SET(taken, slot);
+	}
+	for(int i = 0, gap = 0; i < ACTION_COUNT; i++) {
+		if(inpt_staged.actions[i].name == NULL || slots[i] != -1) {
+			continue;
+		}
+
+		while(BITFLD_GET(taken, gap)) {
+			gap++;
+		}
+
+		slots[i] = gap;
+		BITFLD_SET(taken, gap);
+	}
+
+	for(int i = 0; i < MAX_ACT_TRIGGER_EVENTS; i++) {
+		if(inpt.on_act_triggers[i].event == NULL) {
+			continue;
+		}
+
+		int slot = inpt_bind_follow(inpt.on_act_triggers[i].action, slots);
+		if(slot == -1) {
+			inpt.on_act_triggers[i].event  = NULL;
+			inpt.on_act_triggers[i].action = NULL;
+			continue;
+		}
+
+		inpt.on_act_triggers[i].action = &inpt.actions[slot];
+	}
+	for(int i = 0; i < MAX_ACT_VALUE_EVENTS; i++) {
+		if(inpt.on_act_values[i].event == NULL) {
+			continue;
+		}
+
+		int slot = inpt_bind_follow(inpt.on_act_values[i].action, slots);
+		if(slot == -1) {
+			inpt.on_act_values[i].event  = NULL;
+			inpt.on_act_values[i].action = NULL;
+			continue;
+		}
+
+		inpt.on_act_values[i].action = &inpt.actions[slot];
+	}
+
+	// Interning only adds, ids from before stay put.
+	int ids[MAX_NAMES + 1] = {0};
+	for(int i = 1; i <= inpt.names.count; i++) {
+		inpt.names.ids[i].state	 = 0;
+		inpt.names.ids[i].action = 0;
+	}
+	for(int i = 1; i <= names->count; i++) {
+		ids[i] = inpt_name_intern(&inpt.names, names->ids[i].str);
+		inpt.names.ids[ids[i]].state = names->ids[i].state;
+	}
+
+	for(int i = 0; i < STATE_COUNT; i++) {
+		inpt.states[i] = ids[inpt_staged.states[i]];
+	}
+
+	memset(inpt.actions, 0, sizeof(inpt.actions));
+	memset(inpt.btn_gestures, 0, sizeof(inpt.btn_gestures));
+	memset(inpt.gestures_sequences, 0, sizeof(inpt.gestures_sequences));
+	for(int i = 0; i < ACTION_COUNT; i++) {
+		if(slots[i] == -1) {
+			continue;
+		}
+
+		inpt_act_t* action = &inpt.actions[slots[i]];
+		memcpy(action, &inpt_staged.actions[i], sizeof(inpt_act_t));
+
+		action->name_id	  = ids[action->name_id];
+		action->name	  = inpt.names.ids[action->name_id].str;
+		action->new_state = ids[action->new_state];
+		inpt.names.ids[action->name_id].action = slots[i] + 1;
+
+		inpt_act_compile(slots[i]);
+	}
+
+	inpt.state_index = state_index;
+	memcpy(inpt.layers, layers, sizeof(inpt.layers));
+
+	memset(inpt.gestures_dirty, 0, sizeof(inpt.gestures_dirty));
+	memset(inpt.gestures_armed, 0, sizeof(inpt.gestures_armed));
+	inpt.gestures_deadline = 0;
+	inpt.transition_count  = 0;
+	inpt_state_sets_clear();
+
+	atomic_store(&inpt_staged.state, 0);
+
+	DEBUG_LOG_INF("swapped in new bindings");
+	DEBUG_COUNT("inpt.bind_swaps", 1);
+}
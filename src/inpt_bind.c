@@ -0,0 +1,636 @@
+#include "inpt_bind.h"
+
+#include "debug.h"
+#include "inpt.h"
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#define INPT_BIND_LINE_MAX 256
+#define INPT_BIND_FIELD_MAX 16
+
+static struct {
+	char	   path[260];
+	int		   interval_ms;
+	atomic_int is_watching;
+} _inpt_bind = {0};
+
+// Everything compiled so far, written out once the whole text is read.
+typedef struct {
+	int				   state_count;
+	uint32_t		   states[STATE_COUNT];
+	int				   action_count;
+	inpt_bind_action_t actions[ACTION_COUNT];
+	uint32_t		   string_size;
+	char			   strings[NAME_POOL_SIZE];
+} _inpt_bind_scratch_t;
+
+static int _inpt_bind_string(_inpt_bind_scratch_t* scratch, const char* str) {
+	int length = strlen(str) + 1;
+	if(scratch->string_size + length > NAME_POOL_SIZE) {
+		return -1;
+	}
+
+	int offset = scratch->string_size;
+	memcpy(scratch->strings + offset, str, length);
+	scratch->string_size += length;
+
+	return offset;
+}
+
+static int _inpt_bind_state(_inpt_bind_scratch_t* scratch, const char* name) {
+	for(int i = 0; i < scratch->state_count; i++) {
+		if(strcmp(scratch->strings + scratch->states[i], name) == 0) {
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+// Split str on sep in place, returning how many parts there were.
+static int _inpt_bind_split(char* str, char sep, char** parts, int max) {
+	int count = 0;
+
+	while(count < max) {
+		parts[count++] = str;
+
+		str = strchr(str, sep);
+		if(str == NULL) {
+			return count;
+		}
+		*str++ = '\0';
+	}
+
+	return -1;
+}
+
+static int _inpt_bind_int(const char* str, int* value) {
+	char* end;
+	long  number = strtol(str, &end, 10);
+	if(end == str || *end != '\0') {
+		return -1;
+	}
+
+	*value = number;
+	return 0;
+}
+
+static int _inpt_bind_states(_inpt_bind_scratch_t* scratch, char* field,
+							 uint8_t* states) {
+	if(strcmp(field, "all") == 0 || strcmp(field, "ALL") == 0) {
+		memset(states, 0xff, STATE_COUNT / 8);
+		return 0;
+	}
+
+	char* names[STATE_COUNT];
+	int	  count = _inpt_bind_split(field, ',', names, STATE_COUNT);
+	for(int i = 0; i < count; i++) {
+		int state = _inpt_bind_state(scratch, names[i]);
+		if(state == -1) {
+			DEBUG_LOG_ERR("unknown state '%s'", names[i]);
+			return -1;
+		}
+
+		BITFLD_SET(states, state);
+	}
+
+	return count < 0 ? -1 : 0;
+}
+
+static int _inpt_bind_inputs(char* field, inpt_bind_action_t* action) {
+	char* inputs[INPT_ACT_INPUT_COUNT];
+	int	  count = _inpt_bind_split(field, ',', inputs, INPT_ACT_INPUT_COUNT);
+	if(count < 0) {
+		return -1;
+	}
+
+	// the same bound inpt_bind_build checks, values aren't buttons.
+	int input_max = action->type == INPT_ACT_VALUE ? MAX_VALUES : MAX_BUTTONS;
+	for(int i = 0; i < count; i++) {
+		int input;
+		if(_inpt_bind_int(inputs[i], &input) < 0 || input < 0 ||
+		   input >= input_max) {
+			return -1;
+		}
+
+		action->inputs[i] = input;
+	}
+
+	action->input_count = count;
+	return 0;
+}
+
+static int _inpt_bind_flags(char* field, int* flags) {
+	char* names[3];
+	int	  count = _inpt_bind_split(field, '|', names, 3);
+
+	*flags = 0;
+	for(int i = 0; i < count; i++) {
+		if(strcmp(names[i], "pressed") == 0) {
+			*flags |= INPT_BTN_PRESSED;
+		}
+		else if(strcmp(names[i], "released") == 0) {
+			*flags |= INPT_BTN_RELEASED;
+		}
+		else if(strcmp(names[i], "held") == 0) {
+			*flags |= INPT_BTN_HELD;
+		}
+		else {
+			return -1;
+		}
+	}
+
+	return count < 0 ? -1 : 0;
+}
+
+// The fields after the name of each action, by type.
+static const struct {
+	const char* kind;
+	int			type;
+	int			field_count;
+} _inpt_bind_kinds[] = {
+	{"change", INPT_ACT_STATE_CHANGE, 7},
+	{"trigger", INPT_ACT_TRIGGER, 6},
+	{"value", INPT_ACT_VALUE, 6},
+	{"chord", INPT_ACT_CHORD, 7},
+	{"sequence", INPT_ACT_SEQUENCE, 7},
+	{"double_tap", INPT_ACT_DOUBLE_TAP, 7},
+	{"long_press", INPT_ACT_LONG_PRESS, 7},
+};
+
+static int _inpt_bind_action(_inpt_bind_scratch_t* scratch, char** fields,
+							 int field_count) {
+	int kind	   = -1;
+	int kind_count = sizeof(_inpt_bind_kinds) / sizeof(*_inpt_bind_kinds);
+	for(int i = 0; i < kind_count; i++) {
+		if(strcmp(fields[0], _inpt_bind_kinds[i].kind) == 0) {
+			kind = i;
+			break;
+		}
+	}
+
+	if(kind == -1) {
+		DEBUG_LOG_ERR("unknown declaration '%s'", fields[0]);
+		return -1;
+	}
+
+	if(field_count != _inpt_bind_kinds[kind].field_count) {
+		DEBUG_LOG_ERR("'%s' takes %i fields", fields[0],
+					  _inpt_bind_kinds[kind].field_count - 1);
+		return -1;
+	}
+
+	if(scratch->action_count >= ACTION_COUNT) {
+		DEBUG_LOG_ERR("too many actions");
+		return -1;
+	}
+
+	for(int i = 0; i < scratch->action_count; i++) {
+		const char* name = scratch->strings + scratch->actions[i].name;
+		if(strcmp(name, fields[1]) == 0) {
+			DEBUG_LOG_ERR("repeated action '%s'", fields[1]);
+			return -1;
+		}
+	}
+
+	inpt_bind_action_t* action = &scratch->actions[scratch->action_count];
+	memset(action, 0, sizeof(inpt_bind_action_t));
+
+	int name = _inpt_bind_string(scratch, fields[1]);
+	if(name == -1) {
+		DEBUG_LOG_ERR("out of room for names");
+		return -1;
+	}
+
+	action->name	  = name;
+	action->type	  = _inpt_bind_kinds[kind].type;
+	action->new_state = -1;
+
+	int input_mod = -1;
+	if(_inpt_bind_states(scratch, fields[2], action->states) < 0 ||
+	   (strcmp(fields[3], "-") != 0 &&
+		_inpt_bind_int(fields[3], &input_mod) < 0) ||
+	   input_mod < -1 || input_mod >= MAX_BUTTONS ||
+	   _inpt_bind_inputs(fields[4], action) < 0 ||
+	   _inpt_bind_flags(fields[field_count - 1], &action->flags) < 0) {
+		DEBUG_LOG_ERR("bad fields for action '%s'", fields[1]);
+		return -1;
+	}
+	action->input_mod = input_mod;
+
+	// chords and sequences are the only ones with several inputs.
+	if(action->input_count > 1 && action->type != INPT_ACT_CHORD &&
+	   action->type != INPT_ACT_SEQUENCE) {
+		DEBUG_LOG_ERR("action '%s' only takes one input", fields[1]);
+		return -1;
+	}
+
+	if(action->type == INPT_ACT_STATE_CHANGE) {
+		action->new_state = _inpt_bind_state(scratch, fields[5]);
+		if(action->new_state == -1) {
+			DEBUG_LOG_ERR("unknown state '%s'", fields[5]);
+			return -1;
+		}
+	}
+	else if(action->type >= INPT_ACT_CHORD) {
+		int window_ms;
+		if(_inpt_bind_int(fields[5], &window_ms) < 0 || window_ms < 0) {
+			DEBUG_LOG_ERR("bad time for action '%s'", fields[1]);
+			return -1;
+		}
+		action->window_ms = window_ms;
+	}
+
+	scratch->action_count++;
+	return 0;
+}
+
+static int _inpt_bind_is_space(char c) {
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+// Compile one line, it gets split up in place.
+static int _inpt_bind_line(_inpt_bind_scratch_t* scratch, char* line) {
+	char* comment = strchr(line, '#');
+	if(comment != NULL) {
+		*comment = '\0';
+	}
+
+	// not strtok, lines can be compiled on the watcher thread too.
+	char* fields[INPT_BIND_FIELD_MAX];
+	int	  field_count = 0;
+	while(*line != '\0') {
+		if(_inpt_bind_is_space(*line)) {
+			*line++ = '\0';
+			continue;
+		}
+
+		if(field_count >= INPT_BIND_FIELD_MAX) {
+			return -1;
+		}
+
+		fields[field_count++] = line;
+		while(*line != '\0' && ! _inpt_bind_is_space(*line)) {
+			line++;
+		}
+	}
+
+	if(field_count == 0) {
+		return 0;
+	}
+
+	inpt_bind_action_t* last = NULL;
+	if(scratch->action_count > 0) {
+		last = &scratch->actions[scratch->action_count - 1];
+	}
+
+	if(strcmp(fields[0], "state") == 0) {
+		if(field_count != 2 || scratch->state_count >= STATE_COUNT ||
+		   _inpt_bind_state(scratch, fields[1]) != -1) {
+			DEBUG_LOG_ERR("bad or repeated state");
+			return -1;
+		}
+
+		int name = _inpt_bind_string(scratch, fields[1]);
+		if(name == -1) {
+			return -1;
+		}
+
+		scratch->states[scratch->state_count++] = name;
+		return 0;
+	}
+
+	if(strcmp(fields[0], "priority") == 0) {
+		int priority;
+		if(field_count != 2 || last == NULL ||
+		   _inpt_bind_int(fields[1], &priority) < 0) {
+			return -1;
+		}
+
+		last->priority = priority;
+		return 0;
+	}
+
+	if(strcmp(fields[0], "point") == 0) {
+		int x, y;
+		if(field_count != 3 || last == NULL ||
+		   last->point_count >= INPT_ACT_POINT_COUNT ||
+		   _inpt_bind_int(fields[1], &x) < 0 ||
+		   _inpt_bind_int(fields[2], &y) < 0) {
+			return -1;
+		}
+
+		last->points[last->point_count][0] = x;
+		last->points[last->point_count][1] = y;
+		last->point_count++;
+		return 0;
+	}
+
+	return _inpt_bind_action(scratch, fields, field_count);
+}
+
+LIBINPT int inpt_bind_compile(const char* text, size_t length, void* out,
+							  size_t size) {
+	// Too big for the stack of a watcher thread.
+	_inpt_bind_scratch_t* scratch = calloc(1, sizeof(_inpt_bind_scratch_t));
+	if(scratch == NULL) {
+		return -1;
+	}
+
+	int			line_number = 1;
+	const char* end			= text + length;
+	while(text < end) {
+		const char* next = memchr(text, '\n', end - text);
+		if(next == NULL) {
+			next = end;
+		}
+
+		char line[INPT_BIND_LINE_MAX];
+		if(next - text >= INPT_BIND_LINE_MAX) {
+			DEBUG_LOG_ERR("binding line %i is too long", line_number);
+			free(scratch);
+			return -1;
+		}
+
+		memcpy(line, text, next - text);
+		line[next - text] = '\0';
+
+		if(_inpt_bind_line(scratch, line) < 0) {
+			DEBUG_LOG_ERR("binding line %i is invalid", line_number);
+			free(scratch);
+			return -1;
+		}
+
+		text = next + 1;
+		line_number++;
+	}
+
+	if(scratch->state_count == 0 || scratch->string_size == 0) {
+		DEBUG_LOG_ERR("binding has no states");
+		free(scratch);
+		return -1;
+	}
+
+	size_t states_size	= scratch->state_count * sizeof(uint32_t);
+	size_t actions_size = scratch->action_count * sizeof(inpt_bind_action_t);
+	size_t total = sizeof(inpt_bind_header_t) + states_size + actions_size +
+				   scratch->string_size;
+	if(total > size) {
+		free(scratch);
+		return -1;
+	}
+
+	inpt_bind_header_t header = {
+		.magic		  = INPT_BIND_MAGIC,
+		.version	  = INPT_BIND_VERSION,
+		.action_size  = sizeof(inpt_bind_action_t),
+		.state_count  = scratch->state_count,
+		.action_count = scratch->action_count,
+		.string_size  = scratch->string_size,
+	};
+
+	char* data = out;
+	memcpy(data, &header, sizeof(header));
+	data += sizeof(header);
+	memcpy(data, scratch->states, states_size);
+	data += states_size;
+	memcpy(data, scratch->actions, actions_size);
+	data += actions_size;
+	memcpy(data, scratch->strings, scratch->string_size);
+
+	free(scratch);
+	return total;
+}
+
+// Read a whole file, the caller frees it.
+static char* _inpt_bind_read(const char* path, size_t* size) {
+	FILE* file = fopen(path, "rb");
+	if(file == NULL) {
+		DEBUG_LOG_ERR("couldn't open bindings '%s'", path);
+		return NULL;
+	}
+
+	fseek(file, 0, SEEK_END);
+	long length = ftell(file);
+	fseek(file, 0, SEEK_SET);
+
+	char* data = length < 0 ? NULL : malloc(length + 1);
+	if(data == NULL || fread(data, 1, length, file) != (size_t) length) {
+		free(data);
+		fclose(file);
+		return NULL;
+	}
+
+	fclose(file);
+	*size = length;
+	return data;
+}
+
+// Compile path if it is text. data is then the compiled form, the caller frees
+// it.
+static int _inpt_bind_read_compiled(const char* path, char** data,
+									size_t* size) {
+	*data = _inpt_bind_read(path, size);
+	if(*data == NULL) {
+		return -1;
+	}
+
+	if(*size >= 4 && memcmp(*data, INPT_BIND_MAGIC, 4) == 0) {
+		return 0;
+	}
+
+	int	  length   = -1;
+	char* compiled = malloc(INPT_BIND_SIZE_MAX);
+	if(compiled != NULL) {
+		length = inpt_bind_compile(*data, *size, compiled, INPT_BIND_SIZE_MAX);
+	}
+	free(*data);
+	*data = NULL;
+
+	if(length < 0) {
+		free(compiled);
+		return -1;
+	}
+
+	*data = compiled;
+	*size = length;
+	return 0;
+}
+
+/**
+ * @brief Load a binding file, text or compiled. It is swapped in by the next
+ * inpt_update.
+ *
+ * @param path the binding file.
+ * @return int 0 on success, 1 if the last load hasn't been swapped in yet and
+ * -1 on failure.
+ */
+LIBINPT int inpt_bind_load(const char* path) {
+	char*  data;
+	size_t size;
+	if(_inpt_bind_read_compiled(path, &data, &size) < 0) {
+		return -1;
+	}
+
+	int result = inpt_bind_build(data, size);
+	free(data);
+
+	return result;
+}
+
+LIBINPT int inpt_bind_compile_file(const char* path, const char* out_path) {
+	char*  data;
+	size_t size;
+	if(_inpt_bind_read_compiled(path, &data, &size) < 0) {
+		return -1;
+	}
+
+	FILE* file = fopen(out_path, "wb");
+	if(file == NULL) {
+		free(data);
+		return -1;
+	}
+
+	int result = fwrite(data, 1, size, file) == size ? 0 : -1;
+	fclose(file);
+	free(data);
+
+	return result;
+}
+
+static void _inpt_bind_watch();
+
+#ifdef WINDOWS
+
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+
+static HANDLE _inpt_bind_thread = NULL;
+
+static DWORD WINAPI _inpt_bind_watch_win(LPVOID arg) {
+	_inpt_bind_watch();
+	return 0;
+}
+
+static int _inpt_bind_thread_start() {
+	_inpt_bind_thread =
+		CreateThread(NULL, 0, _inpt_bind_watch_win, NULL, 0, NULL);
+	return _inpt_bind_thread != NULL ? 0 : -1;
+}
+
+static void _inpt_bind_thread_join() {
+	WaitForSingleObject(_inpt_bind_thread, INFINITE);
+	CloseHandle(_inpt_bind_thread);
+	_inpt_bind_thread = NULL;
+}
+
+static void _inpt_bind_sleep_ms(const int ms) {
+	Sleep(ms);
+}
+
+#else
+#include <pthread.h>
+#include <time.h>
+
+static pthread_t _inpt_bind_thread;
+
+static void* _inpt_bind_watch_posix(void* arg) {
+	_inpt_bind_watch();
+	return NULL;
+}
+
+static int _inpt_bind_thread_start() {
+	if(pthread_create(&_inpt_bind_thread, NULL, _inpt_bind_watch_posix,
+					  NULL) != 0) {
+		return -1;
+	}
+
+	return 0;
+}
+
+static void _inpt_bind_thread_join() {
+	pthread_join(_inpt_bind_thread, NULL);
+}
+
+static void _inpt_bind_sleep_ms(const int ms) {
+	struct timespec delay = {ms / 1000, (ms % 1000) * 1000000L};
+	nanosleep(&delay, NULL);
+}
+
+#endif
+
+static int _inpt_bind_same(const struct stat* a, const struct stat* b) {
+	return a->st_mtime == b->st_mtime && a->st_size == b->st_size;
+}
+
+// Loads the file once it changed and then kept its mtime and size for a whole
+// interval, a file caught half written can still parse. The file as it is
+// when watching starts is loaded right away. A load that fails, or finds the
+// last one not yet swapped in, tries again next time around.
+static void _inpt_bind_watch() {
+	debug_thread_name("inpt bindings");
+
+	struct stat loaded = {0};
+	struct stat last   = {0};
+	if(stat(_inpt_bind.path, &last) != 0) {
+		memset(&last, 0, sizeof(last));
+	}
+	while(atomic_load(&_inpt_bind.is_watching)) {
+		struct stat info;
+		if(stat(_inpt_bind.path, &info) == 0) {
+			if(! _inpt_bind_same(&info, &loaded) &&
+			   _inpt_bind_same(&info, &last) &&
+			   inpt_bind_load(_inpt_bind.path) == 0) {
+				loaded = info;
+			}
+			last = info;
+		}
+
+		_inpt_bind_sleep_ms(_inpt_bind.interval_ms);
+	}
+}
+
+/**
+ * @brief Load a binding file now and again every time it changes.
+ *
+ * @param path the binding file.
+ * @param interval_ms how often to check the file for changes.
+ * @return int 0 on success and -1 on failure.
+ */
+LIBINPT int inpt_bind_watch(const char* path, int interval_ms) {
+	if(atomic_load(&_inpt_bind.is_watching) ||
+	   strlen(path) >= sizeof(_inpt_bind.path)) {
+		return -1;
+	}
+
+	strcpy(_inpt_bind.path, path);
+	_inpt_bind.interval_ms = interval_ms;
+
+	atomic_store(&_inpt_bind.is_watching, 1);
+	if(_inpt_bind_thread_start() < 0) {
+		atomic_store(&_inpt_bind.is_watching, 0);
+		return -1;
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Stop watching the binding file. Returns once the watcher has exited,
+ * which can take up to the interval passed to inpt_bind_watch.
+ *
+ * @return int 0.
+ */
+LIBINPT int inpt_bind_unwatch() {
+	if(atomic_exchange(&_inpt_bind.is_watching, 0) == 0) {
+		return 0;
+	}
+
+	_inpt_bind_thread_join();
+	return 0;
+}
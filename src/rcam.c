@@ -0,0 +1,846 @@
+#include "rcam.h"
+
+#include "rsoc.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Fragment layout, all fields in network byte order:
+//
+//  0  u8  magic
+//  1  u8  packet type
+//  2  u8  format
+//  3  u8  reserved
+//  4  u32 frame id
+//  8  u16 fragment index
+// 10  u16 fragment count
+// 12  u32 frame size
+// 16  u32 capture timestamp, low 32 bits of the sender's rsoc_time_us
+// 20  u16 width
+// 22  u16 height
+// 24  u32 microseconds from the capture timestamp to sending this fragment
+// 28      payload, RCAM_FRAGMENT_SIZE bytes except for the last fragment
+//
+// Feedback layout, receiver to sender, RCAM_FEEDBACK_SIZE bytes:
+//
+//  0  u8  magic
+//  1  u8  packet type
+//  2  u16 reserved
+//  4  u32 newest frame id received
+//  8  u16 fragment loss over the last interval, 65535 is everything
+// 10  u16 reserved
+// 12  u32 receive rate in bytes per second
+// 16  u32 interarrival jitter in microseconds
+// 20  u32 average queueing delay in microseconds
+
+#define RCAM_MAGIC 0x43
+#define RCAM_PACKET_FRAGMENT 1
+#define RCAM_PACKET_FEEDBACK 2
+#define RCAM_FEEDBACK_SIZE 24
+
+static void _rcam_write_u16(uint8_t* data, uint16_t value) {
+	data[0] = value >> 8;
+	data[1] = value & 0xFF;
+}
+
+static void _rcam_write_u32(uint8_t* data, uint32_t value) {
+	data[0] = value >> 24;
+	data[1] = (value >> 16) & 0xFF;
+	data[2] = (value >> 8) & 0xFF;
+	data[3] = value & 0xFF;
+}
+
+static uint16_t _rcam_read_u16(const uint8_t* data) {
+	return (uint16_t) (data[0] << 8 | data[1]);
+}
+
+static uint32_t _rcam_read_u32(const uint8_t* data) {
+	return (uint32_t) data[0] << 24 | (uint32_t) data[1] << 16 |
+		   (uint32_t) data[2] << 8 | data[3];
+}
+
+// Goes through the send scheduler when the socket has one.
+static int _rcam_send(rsoc_socket_t* sock, enum rsoc_class_t sched_class,
+					  uint8_t* data, const int data_size) {
+	if(sock->sched.enabled) {
+		return rsoc_sched_send(sock, sched_class, data, data_size);
+	}
+
+	return rsoc_send(sock, data, data_size);
+}
+
+// Is frame id a newer than b, taking wrap around into account.
+static int _rcam_id_gt(uint32_t a, uint32_t b) {
+	return (int32_t) (a - b) > 0;
+}
+
+// Encoding levels from best to worst. A jpeg frame's size roughly follows
+// quality / scale^2, which is all the rate control needs to pick one.
+static const struct {
+	int scale;
+	int fps_div;
+	int quality;
+} _rcam_levels[] = {
+	{1, 1, 90}, {1, 1, 75}, {1, 1, 60}, {2, 1, 90}, {2, 1, 75}, {2, 1, 60},
+	{2, 2, 60}, {4, 2, 75}, {4, 2, 50}, {4, 4, 50}, {4, 6, 30},
+};
+
+#define RCAM_LEVEL_COUNT (int) (sizeof(_rcam_levels) / sizeof(_rcam_levels[0]))
+// udp and ip headers, counted against the budget with every fragment.
+#define RCAM_PACKET_OVERHEAD 28
+// the pacer never saves up more than this many bytes.
+#define RCAM_BURST_BYTES (4 * RCAM_PACKET_MAX)
+// no feedback for this long halves the rate.
+#define RCAM_FEEDBACK_TIMEOUT_US (10 * RCAM_FEEDBACK_INTERVAL_US)
+
+static double _rcam_level_cost(int level) {
+	int scale = _rcam_levels[level].scale;
+	return _rcam_levels[level].quality / 100.0 / (scale * scale);
+}
+
+static int _rcam_level_fps(rcam_sender_t* sender, int level) {
+	int fps = sender->fps_max / _rcam_levels[level].fps_div;
+	return fps > 0 ? fps : 1;
+}
+
+// Picks the best level whose estimated rate fits the target. Going up is only
+// done one level at a time and with some headroom so it doesn't flap.
+static void _rcam_pick_level(rcam_sender_t* sender) {
+	if(sender->frame_bytes_full <= 0) {
+		return;
+	}
+
+	double overhead = (double) (RCAM_HEADER_SIZE + RCAM_PACKET_OVERHEAD) /
+					  RCAM_FRAGMENT_SIZE;
+	int	   best		= RCAM_LEVEL_COUNT - 1;
+	for(int i = 0; i < RCAM_LEVEL_COUNT; i++) {
+		double bps = sender->frame_bytes_full * _rcam_level_cost(i) *
+					 (1.0 + overhead) * 8.0 * _rcam_level_fps(sender, i);
+		double limit = sender->target_bps * (i < sender->level ? 0.85 : 1.0);
+		if(bps <= limit) {
+			best = i;
+			break;
+		}
+	}
+
+	sender->level = best < sender->level ? sender->level - 1 : best;
+}
+
+static void _rcam_set_target(rcam_sender_t* sender, double target) {
+	if(target < RCAM_RATE_MIN_BPS) {
+		target = RCAM_RATE_MIN_BPS;
+	}
+	if(target > sender->budget_bps) {
+		target = sender->budget_bps;
+	}
+
+	sender->target_bps = (uint64_t) target;
+	_rcam_pick_level(sender);
+}
+
+// Loss based back off as in most udp video rate controls: cut in proportion
+// to heavy loss, cut a little when the queueing delay says the radio is
+// buffering, grow slowly when neither happens.
+static void _rcam_on_feedback(rcam_sender_t* sender, const uint8_t* data,
+							  uint64_t now) {
+	sender->loss		   = _rcam_read_u16(data + 8) / 65535.0;
+	sender->receive_bps	   = (uint64_t) _rcam_read_u32(data + 12) * 8;
+	sender->queue_delay_us = _rcam_read_u32(data + 20);
+	sender->feedback_us	   = now;
+
+	double target = sender->target_bps;
+	if(sender->loss > RCAM_LOSS_HIGH) {
+		target *= 1.0 - sender->loss / 2.0;
+	}
+	else if(sender->queue_delay_us > RCAM_QUEUE_DELAY_MAX_US) {
+		target *= 0.85;
+	}
+	else if(sender->loss < RCAM_LOSS_LOW) {
+		target *= 1.05;
+	}
+
+	_rcam_set_target(sender, target);
+}
+
+int rcam_sender_init(rcam_sender_t* sender, rsoc_socket_t* sock,
+					 const int frame_max) {
+	if(sender == NULL || sock == NULL) {
+		return RCAM_ERR_NULL;
+	}
+	if(frame_max < 0 || frame_max > RCAM_FRAME_MAX) {
+		return RCAM_ERR_SIZE;
+	}
+
+	memset(sender, 0, sizeof(rcam_sender_t));
+	sender->sock	  = sock;
+	sender->frame_max = frame_max == 0 ? RCAM_FRAME_MAX : frame_max;
+
+	sender->frame_buffer = malloc((size_t) RCAM_SEND_QUEUE * sender->frame_max);
+	if(sender->frame_buffer == NULL) {
+		return RCAM_ERR_ALLOC;
+	}
+
+	for(int i = 0; i < RCAM_SEND_QUEUE; i++) {
+		sender->queue[i].data =
+			sender->frame_buffer + (size_t) i * sender->frame_max;
+	}
+
+	sender->sched_class = RSOC_CLASS_BULK;
+	sender->budget_bps	= RCAM_RATE_DEFAULT_BPS;
+	sender->target_bps	= RCAM_RATE_DEFAULT_BPS;
+	sender->fps_max		= 30;
+
+	return 0;
+}
+
+int rcam_sender_budget(rcam_sender_t* sender, const uint64_t budget_bps,
+					   const int fps_max) {
+	if(sender == NULL) {
+		return RCAM_ERR_NULL;
+	}
+
+	sender->budget_bps = budget_bps < RCAM_RATE_MIN_BPS ? RCAM_RATE_MIN_BPS
+														: budget_bps;
+	sender->fps_max	   = fps_max > 0 ? fps_max : 1;
+	_rcam_set_target(sender, sender->target_bps);
+
+	return 0;
+}
+
+int rcam_sender_share(rcam_sender_t* sender, rsoc_socket_t* sock) {
+	if(sender == NULL || sock == NULL) {
+		return RCAM_ERR_NULL;
+	}
+	if(sender->shared_count >= RCAM_SHARE_MAX) {
+		return RCAM_ERR_FULL;
+	}
+
+	sender->shared[sender->shared_count]	   = sock;
+	sender->shared_bytes[sender->shared_count] = sock->stats.bytes_sent;
+	sender->shared_count++;
+
+	return 0;
+}
+
+int rcam_send_frame(rcam_sender_t* sender, const uint8_t* data,
+					const int data_size, enum rcam_format_t format,
+					const int width, const int height) {
+	if(sender == NULL || data == NULL || sender->frame_buffer == NULL) {
+		return RCAM_ERR_NULL;
+	}
+	if(data_size <= 0 || data_size > sender->frame_max) {
+		return RCAM_ERR_SIZE;
+	}
+
+	// learn what a full quality frame would weigh from what the camera
+	// produced at the current level.
+	double full = data_size / _rcam_level_cost(sender->level);
+	if(sender->frame_bytes_full <= 0) {
+		sender->frame_bytes_full = full;
+		_rcam_pick_level(sender);
+	}
+	else {
+		sender->frame_bytes_full += (full - sender->frame_bytes_full) / 8.0;
+	}
+
+	// the link is behind. a frame that hasn't started going out is replaced,
+	// sending it late would only delay the newer one.
+	struct rcam_send_frame_t* frame;
+	if(sender->queue_count == RCAM_SEND_QUEUE) {
+		frame = &sender->queue[RCAM_SEND_QUEUE - 1];
+		sender->frames_skipped++;
+	}
+	else {
+		frame = &sender->queue[sender->queue_count++];
+	}
+
+	memcpy(frame->data, data, data_size);
+	frame->size			  = data_size;
+	frame->id			  = sender->frame_id++;
+	frame->timestamp	  = (uint32_t) rsoc_time_us();
+	frame->format		  = format;
+	frame->width		  = width;
+	frame->height		  = height;
+	frame->fragment_next  = 0;
+	frame->fragment_count = (data_size + RCAM_FRAGMENT_SIZE - 1) /
+							RCAM_FRAGMENT_SIZE;
+
+	return 0;
+}
+
+static int _rcam_send_fragment(rcam_sender_t*			 sender,
+							   struct rcam_send_frame_t* frame) {
+	uint8_t packet[RCAM_PACKET_MAX];
+	int		index  = frame->fragment_next;
+	int		offset = index * RCAM_FRAGMENT_SIZE;
+	int		size   = frame->size - offset;
+	if(size > RCAM_FRAGMENT_SIZE) {
+		size = RCAM_FRAGMENT_SIZE;
+	}
+
+	packet[0] = RCAM_MAGIC;
+	packet[1] = RCAM_PACKET_FRAGMENT;
+	packet[2] = frame->format;
+	packet[3] = 0;
+	_rcam_write_u32(packet + 4, frame->id);
+	_rcam_write_u16(packet + 8, index);
+	_rcam_write_u16(packet + 10, frame->fragment_count);
+	_rcam_write_u32(packet + 12, frame->size);
+	_rcam_write_u32(packet + 16, frame->timestamp);
+	_rcam_write_u16(packet + 20, frame->width);
+	_rcam_write_u16(packet + 22, frame->height);
+	_rcam_write_u32(packet + 24, (uint32_t) rsoc_time_us() - frame->timestamp);
+	memcpy(packet + RCAM_HEADER_SIZE, frame->data + offset, size);
+
+	frame->fragment_next++;
+
+	if(_rcam_send(sender->sock, sender->sched_class, packet,
+				  RCAM_HEADER_SIZE + size) < 0) {
+		return RCAM_ERR_SOCK;
+	}
+
+	return RCAM_HEADER_SIZE + size;
+}
+
+int rcam_sender_update(rcam_sender_t* sender) {
+	if(sender == NULL || sender->frame_buffer == NULL) {
+		return RCAM_ERR_NULL;
+	}
+
+	uint64_t now = rsoc_time_us();
+
+	// the sender owns every read on its socket. a whole packet buffer keeps
+	// anything bigger from passing for feedback once it's cut off.
+	uint8_t buffer[RCAM_PACKET_MAX];
+	while(rsoc_poll(sender->sock, 0) > 0) {
+		int size = rsoc_receive(sender->sock, buffer, sizeof(buffer));
+		if(size < 0) {
+			break;
+		}
+		if(size == RCAM_FEEDBACK_SIZE && buffer[0] == RCAM_MAGIC &&
+		   buffer[1] == RCAM_PACKET_FEEDBACK) {
+			_rcam_on_feedback(sender, buffer, now);
+		}
+	}
+
+	// the receiver went quiet, assume the feedback is being lost with
+	// everything else.
+	if(sender->feedback_us != 0 &&
+	   now - sender->feedback_us > RCAM_FEEDBACK_TIMEOUT_US) {
+		sender->feedback_us = now;
+		_rcam_set_target(sender, sender->target_bps / 2.0);
+	}
+
+	if(sender->pace_us == 0) {
+		sender->pace_us = now;
+	}
+	sender->tokens += (now - sender->pace_us) * sender->target_bps / 8e6;
+	sender->pace_us = now;
+
+	// whatever the shared sockets sent since the last update already went
+	// out ahead of the camera.
+	for(int i = 0; i < sender->shared_count; i++) {
+		uint64_t bytes = sender->shared[i]->stats.bytes_sent;
+		sender->tokens -= bytes - sender->shared_bytes[i];
+		sender->shared_bytes[i] = bytes;
+	}
+
+	if(sender->tokens > RCAM_BURST_BYTES) {
+		sender->tokens = RCAM_BURST_BYTES;
+	}
+
+	int sent = 0;
+	while(sender->queue_count > 0 && sender->tokens > 0) {
+		struct rcam_send_frame_t* frame = &sender->queue[0];
+
+		int size = _rcam_send_fragment(sender, frame);
+		if(size < 0) {
+			return sent > 0 ? sent : size;
+		}
+
+		sender->tokens -= size + RCAM_PACKET_OVERHEAD;
+		sent++;
+
+		if(frame->fragment_next < frame->fragment_count) {
+			continue;
+		}
+
+		sender->frames_sent++;
+		sender->bytes_sent += frame->size;
+
+		// rotate the buffers so the finished one is reused last.
+		struct rcam_send_frame_t done = sender->queue[0];
+		for(int i = 1; i < sender->queue_count; i++) {
+			sender->queue[i - 1] = sender->queue[i];
+		}
+		sender->queue[--sender->queue_count] = done;
+	}
+
+	// nothing to send, don't save up for a burst later.
+	if(sender->queue_count == 0 && sender->tokens > 0) {
+		sender->tokens = 0;
+	}
+
+	if(sender->sock->sched.enabled) {
+		rsoc_sched_update(sender->sock);
+	}
+
+	return sent;
+}
+
+int rcam_sender_params(rcam_sender_t* sender, rcam_params_t* params) {
+	if(sender == NULL || params == NULL) {
+		return RCAM_ERR_NULL;
+	}
+
+	params->fps		 = _rcam_level_fps(sender, sender->level);
+	params->scale	 = _rcam_levels[sender->level].scale;
+	params->quality	 = _rcam_levels[sender->level].quality;
+	params->rate_bps = sender->target_bps;
+
+	return 0;
+}
+
+void rcam_sender_free(rcam_sender_t* sender) {
+	if(sender == NULL) {
+		return;
+	}
+
+	free(sender->frame_buffer);
+	sender->frame_buffer = NULL;
+	sender->queue_count	 = 0;
+}
+
+int rcam_receiver_init(rcam_receiver_t* receiver, rsoc_socket_t* sock,
+					   const int frame_max) {
+	if(receiver == NULL || sock == NULL) {
+		return RCAM_ERR_NULL;
+	}
+	if(frame_max < 0 || frame_max > RCAM_FRAME_MAX) {
+		return RCAM_ERR_SIZE;
+	}
+
+	memset(receiver, 0, sizeof(rcam_receiver_t));
+	receiver->sock		= sock;
+	receiver->frame_max = frame_max == 0 ? RCAM_FRAME_MAX : frame_max;
+
+	if(rsoc_ring_init(&receiver->ring, RCAM_RING_COUNT, RCAM_PACKET_MAX) < 0) {
+		return RCAM_ERR_ALLOC;
+	}
+
+	// every frame slot gets its share of one allocation up front, reassembly
+	// copies fragments straight into place.
+	receiver->frame_buffer =
+		malloc((size_t) RCAM_FRAME_COUNT * receiver->frame_max);
+	if(receiver->frame_buffer == NULL) {
+		rsoc_ring_free(&receiver->ring);
+		return RCAM_ERR_ALLOC;
+	}
+
+	for(int i = 0; i < RCAM_FRAME_COUNT; i++) {
+		receiver->frames[i].data =
+			receiver->frame_buffer + (size_t) i * receiver->frame_max;
+	}
+
+	receiver->stats.delay_us = RCAM_DELAY_MIN_US;
+
+	return 0;
+}
+
+static void _rcam_drop(rcam_receiver_t* receiver, rcam_frame_t* frame) {
+	receiver->stats.frames_dropped++;
+	receiver->stats.fragments_lost +=
+		frame->fragment_count - frame->fragments_received;
+	frame->state = RCAM_FRAME_FREE;
+
+	// the rest of its fragments may still be on the way, they must not start
+	// the frame over.
+	if(receiver->has_drop == 0 || _rcam_id_gt(frame->id, receiver->drop_id)) {
+		receiver->drop_id  = frame->id;
+		receiver->has_drop = 1;
+	}
+}
+
+static rcam_frame_t* _rcam_find(rcam_receiver_t* receiver, uint32_t id) {
+	for(int i = 0; i < RCAM_FRAME_COUNT; i++) {
+		rcam_frame_t* frame = &receiver->frames[i];
+		if(frame->state != RCAM_FRAME_FREE && frame->id == id) {
+			return frame;
+		}
+	}
+
+	return NULL;
+}
+
+// Returns a free frame slot. Out of slots, the oldest frame still being
+// assembled is given up on. Frames that are complete are never evicted.
+static rcam_frame_t* _rcam_alloc(rcam_receiver_t* receiver) {
+	rcam_frame_t* oldest = NULL;
+
+	for(int i = 0; i < RCAM_FRAME_COUNT; i++) {
+		rcam_frame_t* frame = &receiver->frames[i];
+		if(frame->state == RCAM_FRAME_FREE) {
+			return frame;
+		}
+		if(frame->state == RCAM_FRAME_ASSEMBLING &&
+		   (oldest == NULL || _rcam_id_gt(oldest->id, frame->id))) {
+			oldest = frame;
+		}
+	}
+
+	if(oldest != NULL) {
+		_rcam_drop(receiver, oldest);
+	}
+
+	return oldest;
+}
+
+// Returns how much longer transit took than the fastest transit seen over the
+// last one to two windows.
+static uint32_t _rcam_transit(struct rcam_transit_t* transit, uint32_t value,
+							  uint64_t now) {
+	if(transit->has == 0 ||
+	   now - transit->window_us > RCAM_TRANSIT_WINDOW_US) {
+		transit->min	   = transit->has ? transit->min_next : value;
+		transit->min_next  = value;
+		transit->window_us = now;
+		transit->has	   = 1;
+	}
+
+	if((int32_t) (value - transit->min_next) < 0) {
+		transit->min_next = value;
+	}
+	if((int32_t) (value - transit->min) < 0) {
+		transit->min = value;
+	}
+
+	return value - transit->min;
+}
+
+// A frame just completed. Feeds its transit time to the jitter estimate and
+// picks its playout time.
+static void _rcam_complete(rcam_receiver_t* receiver, rcam_frame_t* frame,
+						   uint64_t now) {
+	frame->state	   = RCAM_FRAME_READY;
+	frame->complete_us = now;
+	frame->assembly_us = now - frame->first_us;
+
+	uint32_t transit = (uint32_t) now - frame->timestamp;
+
+	if(receiver->transit.has == 0) {
+		receiver->transit_prev = transit;
+	}
+
+	// interarrival jitter as in rfc 3550, J += (|D| - J) / 16.
+	int32_t d = (int32_t) (transit - receiver->transit_prev);
+	if(d < 0) {
+		d = -d;
+	}
+	receiver->jitter_us += ((double) d - receiver->jitter_us) / 16.0;
+	receiver->transit_prev = transit;
+
+	uint32_t excess = _rcam_transit(&receiver->transit, transit, now);
+
+	uint64_t delay = (uint64_t) (RCAM_DELAY_JITTERS * receiver->jitter_us);
+	if(delay < RCAM_DELAY_MIN_US) {
+		delay = RCAM_DELAY_MIN_US;
+	}
+	if(delay > RCAM_DELAY_MAX_US) {
+		delay = RCAM_DELAY_MAX_US;
+	}
+
+	// frames are played out at a fixed delay after the time they would have
+	// arrived over the fastest path, which evens out the spacing between them
+	// instead of passing the network jitter on to the caller.
+	frame->capture_us = now - excess;
+	frame->play_us	  = frame->capture_us + delay;
+
+	receiver->stats.jitter_us = (uint64_t) receiver->jitter_us;
+	receiver->stats.delay_us  = delay;
+}
+
+static void _rcam_process(rcam_receiver_t* receiver, rsoc_packet_t* packet) {
+	if(packet->size < RCAM_HEADER_SIZE || packet->data[0] != RCAM_MAGIC ||
+	   packet->data[1] != RCAM_PACKET_FRAGMENT) {
+		return;
+	}
+
+	const uint8_t* data		  = packet->data;
+	uint32_t	   id		  = _rcam_read_u32(data + 4);
+	int			   index	  = _rcam_read_u16(data + 8);
+	int			   count	  = _rcam_read_u16(data + 10);
+	int			   frame_size = _rcam_read_u32(data + 12);
+	int			   offset	  = index * RCAM_FRAGMENT_SIZE;
+	int			   size		  = packet->size - RCAM_HEADER_SIZE;
+
+	// anything inconsistent is dropped before it touches a frame buffer.
+	if(frame_size <= 0 || frame_size > receiver->frame_max || index >= count ||
+	   count != (frame_size + RCAM_FRAGMENT_SIZE - 1) / RCAM_FRAGMENT_SIZE) {
+		return;
+	}
+	int expected =
+		index == count - 1 ? frame_size - offset : RCAM_FRAGMENT_SIZE;
+	if(size != expected) {
+		return;
+	}
+
+	// a newer frame was handed out or given up on already, this one is of no
+	// use anymore. a run of them means the sender restarted its ids, start
+	// over.
+	rcam_frame_t* frame = _rcam_find(receiver, id);
+	int			  late =
+		receiver->has_last && !_rcam_id_gt(id, receiver->last_id);
+	if(frame == NULL && (late || (receiver->has_drop &&
+								  !_rcam_id_gt(id, receiver->drop_id)))) {
+		if(receiver->late_id != id) {
+			receiver->late_id = id;
+			receiver->stats.frames_late += late;
+		}
+		if(++receiver->late_count <= RCAM_RING_COUNT) {
+			return;
+		}
+
+		receiver->has_last		  = 0;
+		receiver->has_drop		  = 0;
+		receiver->transit.has	  = 0;
+		receiver->net_transit.has = 0;
+		receiver->jitter_us		  = 0;
+	}
+	receiver->late_count = 0;
+
+	if(frame == NULL) {
+		frame = _rcam_alloc(receiver);
+		if(frame == NULL) {
+			// every slot holds a complete frame, the caller isn't keeping up.
+			return;
+		}
+
+		frame->state			  = RCAM_FRAME_ASSEMBLING;
+		frame->id				  = id;
+		frame->format			  = data[2];
+		frame->size				  = frame_size;
+		frame->timestamp		  = _rcam_read_u32(data + 16);
+		frame->width			  = _rcam_read_u16(data + 20);
+		frame->height			  = _rcam_read_u16(data + 22);
+		frame->first_us			  = packet->time_us;
+		frame->fragment_count	  = count;
+		frame->fragments_received = 0;
+		memset(frame->received, 0, sizeof(frame->received));
+	}
+	else if(frame->state != RCAM_FRAME_ASSEMBLING ||
+			frame->fragment_count != count) {
+		return;
+	}
+
+	uint8_t bit = 1 << (index & 7);
+	if(frame->received[index >> 3] & bit) {
+		return;
+	}
+
+	memcpy(frame->data + offset, data + RCAM_HEADER_SIZE, size);
+	frame->received[index >> 3] |= bit;
+	frame->fragments_received++;
+	receiver->stats.fragments_received++;
+	receiver->stats.bytes_received += size;
+
+	// time spent in queues on the way, without the time the fragment waited
+	// in the sender's pacer.
+	uint32_t sent = _rcam_read_u32(data + 16) + _rcam_read_u32(data + 24);
+	receiver->queue_delay_sum += _rcam_transit(
+		&receiver->net_transit, (uint32_t) packet->time_us - sent,
+		packet->time_us);
+	receiver->queue_delay_count++;
+
+	if(_rcam_id_gt(id, receiver->newest_id)) {
+		receiver->newest_id = id;
+	}
+
+	if(frame->fragments_received == frame->fragment_count) {
+		_rcam_complete(receiver, frame, packet->time_us);
+	}
+}
+
+static int _rcam_send_feedback(rcam_receiver_t* receiver, uint64_t now) {
+	rcam_stats_t* stats	   = &receiver->stats;
+	uint64_t	  received = stats->fragments_received -
+						receiver->feedback_fragments_received;
+	uint64_t lost  = stats->fragments_lost - receiver->feedback_fragments_lost;
+	uint64_t bytes = stats->bytes_received - receiver->feedback_bytes;
+	uint64_t elapsed = now - receiver->feedback_us;
+
+	uint8_t packet[RCAM_FEEDBACK_SIZE] = {0};
+	packet[0]						   = RCAM_MAGIC;
+	packet[1]						   = RCAM_PACKET_FEEDBACK;
+	_rcam_write_u32(packet + 4, receiver->newest_id);
+	_rcam_write_u16(packet + 8, received + lost > 0
+									? lost * 65535 / (received + lost)
+									: 0);
+	_rcam_write_u32(packet + 12, bytes * 1000000 / elapsed);
+	_rcam_write_u32(packet + 16, stats->jitter_us);
+	_rcam_write_u32(packet + 20,
+					receiver->queue_delay_count > 0
+						? receiver->queue_delay_sum /
+							  receiver->queue_delay_count
+						: 0);
+
+	receiver->feedback_us				  = now;
+	receiver->feedback_fragments_received = stats->fragments_received;
+	receiver->feedback_fragments_lost	  = stats->fragments_lost;
+	receiver->feedback_bytes			  = stats->bytes_received;
+	receiver->queue_delay_sum			  = 0;
+	receiver->queue_delay_count			  = 0;
+
+	// the host socket sends to whoever sent the last fragment.
+	if(_rcam_send(receiver->sock, RSOC_CLASS_CONTROL, packet,
+				  RCAM_FEEDBACK_SIZE) < 0) {
+		return RCAM_ERR_SOCK;
+	}
+
+	return 0;
+}
+
+int rcam_receiver_update(rcam_receiver_t* receiver, const int timeout_ms) {
+	if(receiver == NULL || receiver->frame_buffer == NULL) {
+		return RCAM_ERR_NULL;
+	}
+
+	int ret = rsoc_ring_receive(receiver->sock, &receiver->ring, timeout_ms);
+
+	// the fragments are read in place and copied once into their frame.
+	rsoc_packet_t* packet;
+	while((packet = rsoc_ring_acquire(&receiver->ring)) != NULL) {
+		_rcam_process(receiver, packet);
+		rsoc_ring_release(&receiver->ring, packet);
+	}
+
+	if(ret < 0) {
+		return RCAM_ERR_SOCK;
+	}
+
+	// fragments go out frame after frame, so once a newer frame is complete
+	// an older one still missing fragments has lost them. how long that takes
+	// depends on the rate, a big frame on a slow link can take seconds.
+	uint32_t newest		= receiver->last_id;
+	int		 has_newest = receiver->has_last;
+	int		 ready		= 0;
+	for(int i = 0; i < RCAM_FRAME_COUNT; i++) {
+		rcam_frame_t* frame = &receiver->frames[i];
+		if(frame->state != RCAM_FRAME_READY &&
+		   frame->state != RCAM_FRAME_HELD) {
+			continue;
+		}
+
+		ready += frame->state == RCAM_FRAME_READY;
+		if(has_newest == 0 || _rcam_id_gt(frame->id, newest)) {
+			newest	   = frame->id;
+			has_newest = 1;
+		}
+	}
+
+	for(int i = 0; i < RCAM_FRAME_COUNT && has_newest; i++) {
+		rcam_frame_t* frame = &receiver->frames[i];
+		if(frame->state == RCAM_FRAME_ASSEMBLING &&
+		   _rcam_id_gt(newest, frame->id)) {
+			_rcam_drop(receiver, frame);
+		}
+	}
+
+	uint64_t now = rsoc_time_us();
+
+	// nothing to report until a sender showed up.
+	if(receiver->stats.fragments_received == 0) {
+		return ready;
+	}
+	if(receiver->feedback_us == 0) {
+		receiver->feedback_us = now;
+	}
+	else if(now - receiver->feedback_us >= RCAM_FEEDBACK_INTERVAL_US &&
+			_rcam_send_feedback(receiver, now) < 0) {
+		return RCAM_ERR_SOCK;
+	}
+
+	return ready;
+}
+
+rcam_frame_t* rcam_receiver_acquire(rcam_receiver_t* receiver) {
+	if(receiver == NULL) {
+		return NULL;
+	}
+
+	rcam_frame_t* next = NULL;
+	for(int i = 0; i < RCAM_FRAME_COUNT; i++) {
+		rcam_frame_t* frame = &receiver->frames[i];
+		if(frame->state == RCAM_FRAME_READY &&
+		   (next == NULL || _rcam_id_gt(next->id, frame->id))) {
+			next = frame;
+		}
+	}
+
+	uint64_t now = rsoc_time_us();
+	if(next == NULL || now < next->play_us) {
+		return NULL;
+	}
+
+	// the stream moves past anything older that is still incomplete.
+	for(int i = 0; i < RCAM_FRAME_COUNT; i++) {
+		rcam_frame_t* frame = &receiver->frames[i];
+		if(frame->state == RCAM_FRAME_ASSEMBLING &&
+		   _rcam_id_gt(next->id, frame->id)) {
+			_rcam_drop(receiver, frame);
+		}
+	}
+
+	next->state		 = RCAM_FRAME_HELD;
+	next->latency_us = now - next->capture_us;
+
+	receiver->last_id  = next->id;
+	receiver->has_last = 1;
+
+	rcam_stats_t* stats = &receiver->stats;
+	stats->frames_received++;
+	stats->latency_us = next->latency_us;
+	if(stats->latency_avg_us == 0) {
+		stats->latency_avg_us = next->latency_us;
+	}
+	else {
+		stats->latency_avg_us =
+			(7 * stats->latency_avg_us + next->latency_us) / 8;
+	}
+
+	return next;
+}
+
+void rcam_receiver_release(rcam_receiver_t* receiver, rcam_frame_t* frame) {
+	if(receiver == NULL || frame == NULL) {
+		return;
+	}
+
+	if(frame < receiver->frames ||
+	   frame >= receiver->frames + RCAM_FRAME_COUNT) {
+		return;
+	}
+
+	frame->state = RCAM_FRAME_FREE;
+}
+
+int rcam_receiver_stats(rcam_receiver_t* receiver, rcam_stats_t* stats) {
+	if(receiver == NULL || stats == NULL) {
+		return RCAM_ERR_NULL;
+	}
+
+	*stats = receiver->stats;
+
+	return 0;
+}
+
+void rcam_receiver_free(rcam_receiver_t* receiver) {
+	if(receiver == NULL) {
+		return;
+	}
+
+	rsoc_ring_free(&receiver->ring);
+	free(receiver->frame_buffer);
+	receiver->frame_buffer = NULL;
+}
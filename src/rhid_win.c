@@ -2,6 +2,8 @@
 #include "rhid.h"
 
 #include <corecrt_malloc.h>
+#include <ctype.h>
+#include <stdatomic.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -12,7 +14,9 @@
 #include <errhandlingapi.h>
 #include <hidsdi.h>
 #include <hidpi.h>
+#include <hidclass.h>
 #include <SetupAPI.h>
+#include <cfgmgr32.h>
 
 // TODO Handle HID disconnection gracefully.
 // TODO Rename size to count in places where it refers to an array size to avoid
@@ -25,22 +29,20 @@ typedef unsigned short ushort;
 #ifndef DEBUG_TIME
 #define DEBUG_TIME
 #endif
+#endif
 
+// errors go through the debug log, DEBUG_LOG_LEVEL compiles them out.
 #define RHID_VARGS(...) __VA_ARGS__
-#define RHID_ERR(message, ...) fprintf(stderr, message "\n", __VA_ARGS__);
+#define RHID_ERR(...) DEBUG_LOG_ERR(__VA_ARGS__)
 #define RHID_ERR_SYS(message, sys_err)                                  \
 	{                                                                   \
-		char errmsg[256];                                               \
-		FormatMessage(FORMAT_MESSAGE_FROM_SYSTEM, NULL, sys_err,        \
+		char  errmsg[256];                                              \
+		DWORD err = sys_err;                                            \
+		FormatMessage(FORMAT_MESSAGE_FROM_SYSTEM, NULL, err,            \
 					  LANG_USER_DEFAULT, errmsg, sizeof(errmsg), NULL); \
-		fprintf(stderr, message);                                       \
-		fprintf(stderr, " error(%#010x): %s\n", sys_err, errmsg);       \
+		DEBUG_LOG_ERR(message);                                         \
+		DEBUG_LOG_ERR("error(%#010x): %s", err, errmsg);                \
 	}
-#else
-#define RHID_ERR(message)
-#define RHID_ERR_SYS(message, sys_err)
-#define RHID_VARGS(...)
-#endif
 
 #define ERROR_TO_STRING_CASE(char_msg, err) \
 	case(err):                              \
@@ -90,96 +92,1102 @@ static struct {
 	ulong			usages_pages_count;
 	USAGE_AND_PAGE* usages_pages;
 	USAGE*			usages_ordered;
-
-	// TODO move report_overlapped to device so more than one device can be
-	// opened at once.
-	OVERLAPPED report_overlapped;
 } _rhid_win_gcache = {0};
 
+// Bytes a value array may take up in a report.
+#define RHID_VALUE_ARRAY_BYTES 128
+// Report ids a device may use.
+#define RHID_REPORT_GROUP_MAX 16
+// Reports rhid_report decodes at most per call, when a device sends faster
+// than it's polled the rest wait in the driver's queue.
+#define RHID_REPORT_DRAIN_MAX 8
+
+// Output and feature usages a device may have.
+#define RHID_WRITE_FIELD_MAX 64
+// Output and feature reports, one per type and report id, a device may have.
+#define RHID_WRITE_REPORT_MAX 16
+
+// An output or feature usage and the report it's sent in.
+typedef struct rhid_write_field_t {
+	uint8_t	 type;
+	uint8_t	 report_id;
+	uint8_t	 is_button;
+	uint16_t page;
+	uint16_t usage;
+} rhid_write_field_t;
+
+// The next contents of an output or feature report. Setting usages changes
+// data in place, so however many changes come in only the last state is sent.
+typedef struct rhid_write_report_t {
+	uint8_t type;
+	uint8_t report_id;
+	int		dirty;
+	char*	data;
+} rhid_write_report_t;
+
+// The descriptors of one report id, so a report only touches its own fields.
+typedef struct rhid_report_group_t {
+	uint8_t report_id;
+
+	// real buttons, cleared and set from the report's usages.
+	int8_t buttons[MAX_BUTTON_COUNT];
+	int	   button_count;
+	// virtual d-pad buttons of hat switches in this report.
+	int8_t hats[MAX_BUTTON_COUNT];
+	int	   hat_count;
+	int	   value_count;
+	// element 0 of every value array in this report.
+	int8_t arrays[MAX_VALUE_COUNT];
+	int	   array_count;
+} rhid_report_group_t;
+
 struct rhid_native_t {
+	// a read is always in flight into pending while the device is open,
+	// finished ones are copied to device->report before decoding.
 	int		   is_reading;
 	OVERLAPPED report_overlapped;
+	char*	   pending;
+
+	rhid_report_group_t groups[RHID_REPORT_GROUP_MAX];
+	int					group_count;
+
+	// HidP_GetData output, and which value descriptor each data index belongs
+	// to, -1 for buttons and value arrays.
+	HIDP_DATA* data;
+	ulong	   data_length;
+	int8_t*	   data_values;
+	int		   data_value_count;
+
+	rhid_write_field_t fields[RHID_WRITE_FIELD_MAX];
+	int				   field_count;
+
+	// one write is in flight at most, from a copy so the reports can keep
+	// changing. write_next is where the round over dirty reports goes on.
+	rhid_write_report_t writes[RHID_WRITE_REPORT_MAX];
+	int					write_count;
+	int					write_next;
+	int					is_writing;
+	OVERLAPPED			write_overlapped;
+	char*				writing;
+	ulong				output_size;
+	ulong				feature_size;
 };
 
-// TODO rhid_get_device_count can be optimized.
-// to do this, store a pre-allocated buffer for the interface list in a
-// global cache. then, re-allocate it when
-// CM_Get_Device_Interface_List_SizeA is greater than the global cache
-// size. this way, memory isn't allocated and free every time
-// rhid_get_device_count is called.
+// What is known about an interface before it's opened, the rest of the filter
+// fields match anything.
+enum {
+	RHID_KNOWN_IDS	   = 1 << 0,
+	RHID_KNOWN_USAGE   = 1 << 1,
+	RHID_KNOWN_SERIAL  = 1 << 2,
+	RHID_KNOWN_VERSION = 1 << 3,
+	RHID_KNOWN_ALL	   = RHID_KNOWN_IDS | RHID_KNOWN_USAGE | RHID_KNOWN_SERIAL |
+						 RHID_KNOWN_VERSION,
+};
 
-int rhid_get_device_count() {
-	// get the HIDClass devices guid.
-	GUID hid_guid = {0};
-	HidD_GetHidGuid(&hid_guid);
+#define RHID_CACHE_MAGIC "RHDC"
+// bump when rhid_cache_entry_t or the descriptors in it change meaning.
+#define RHID_CACHE_VERSION 4
+// Models the cache file holds at most.
+#define RHID_CACHE_MAX 256
+
+typedef struct rhid_cache_header_t {
+	char	 magic[4];
+	uint32_t version;
+	// sizeof(rhid_cache_entry_t) of the build that wrote the file.
+	uint32_t entry_size;
+	uint32_t count;
+} rhid_cache_header_t;
+
+// Everything _rhid_probe learns about an interface that is the same for every
+// device of a model, the first six fields are the key.
+typedef struct rhid_cache_entry_t {
+	uint16_t vendor_id;
+	uint16_t product_id;
+	uint16_t version;
+	uint16_t usage_page;
+	uint16_t usage;
+	// the "&colxx" of the interface path, 0 for single collection devices.
+	uint16_t collection;
+
+	char product_name[127];
+	char manufacturer_name[127];
+
+	int32_t report_size;
+	int32_t cap_button_count;
+	int32_t cap_value_count;
+	int32_t button_count;
+	int32_t value_count;
+
+	struct rhid_button_descriptor_t button_descriptors[MAX_BUTTON_COUNT];
+	struct rhid_value_descriptor_t	value_descriptors[MAX_VALUE_COUNT];
+} rhid_cache_entry_t;
+
+// The cache file mapped read only, and the models probed since it was mapped
+// which get written out at the end of a refresh.
+static struct {
+	char	path[MAX_PATH];
+	HANDLE	file;
+	HANDLE	mapping;
+	void*	view;
+	int		is_open;
 
-	// get a list of devices from the devices class.
-	HDEVINFO dev_list = SetupDiGetClassDevsA(
-		&hid_guid, NULL, NULL, DIGCF_PRESENT | DIGCF_DEVICEINTERFACE);
+	const rhid_cache_entry_t* entries;
+	int						  count;
 
-	if(dev_list == INVALID_HANDLE_VALUE) {
-		RHID_ERR_SYS("failed to get devices from device class", GetLastError());
+	rhid_cache_entry_t pending[RHID_CACHE_MAX];
+	int				   pending_count;
+} _rhid_cache = {0};
+
+// Walks in a row a failed probe forces before the interface waits for the
+// next hot-plug notification to be tried again.
+#define RHID_PROBE_RETRIES 3
+
+// Every HID interface seen by the last rhid_refresh, probed once when it first
+// showed up, and the additions and removals nobody has read yet.
+static struct {
+	rhid_device_t devices[RHID_DEVICE_MAX];
+	int			  device_count;
+	// set on the devices found by the current refresh.
+	uint8_t seen[RHID_DEVICE_MAX];
+	// the RHID_KNOWN bits of what was learned about each device.
+	uint8_t known[RHID_DEVICE_MAX];
+
+	rhid_filter_t filters[RHID_FILTER_MAX];
+	int			  filter_count;
+
+	// interfaces that were opened and probed but didn't match the filters,
+	// kept until they go away or the filters change so they aren't opened
+	// again on every refresh.
+	char	rejected[RHID_DEVICE_MAX][sizeof(((rhid_device_t*) NULL)->path)];
+	int		rejected_count;
+	uint8_t rejected_seen[RHID_DEVICE_MAX];
+
+	rhid_change_t changes[RHID_CHANGE_MAX];
+	int			  change_head;
+	int			  change_count;
+
+	// cleared by the hot-plug notification, queries only walk the interfaces
+	// again when it's clear. while there is no notification every query walks.
+	atomic_int		valid;
+	HCMNOTIFICATION notify;
+	int				notify_failed;
+	// walks in a row that had an interface fail to probe.
+	int probe_retries;
+} _rhid_registry = {0};
+
+static inline void* _rhid_open_device_handle(const char* path,
+											 ulong		 access_rights,
+											 ulong		 share_mode) {
+	void* handle = CreateFileA(path, access_rights, share_mode, NULL,
+							   OPEN_EXISTING, FILE_FLAG_OVERLAPPED, NULL);
+	if(handle == INVALID_HANDLE_VALUE) {
+		// the caller may want to know why.
+		ulong error = GetLastError();
+		RHID_ERR_SYS(RHID_VARGS("failed to open device \"%s\"", path), error);
+		SetLastError(error);
+		return NULL;
+	}
+
+	return handle;
+}
+
+// Reads the serial number through the open device->handle.
+static void _rhid_read_serial(rhid_device_t* device) {
+	// plenty of devices have no serial number, that isn't an error.
+	wchar_t serial_number[127];
+	if(HidD_GetSerialNumberString(device->handle, serial_number,
+								  sizeof(serial_number)) == TRUE) {
+		wcstombs(device->serial_number, serial_number,
+				 sizeof(device->serial_number));
+	}
+}
+
+// Gives the first hat switch four virtual d-pad buttons after the real ones.
+// A device that already has d-pad buttons keeps only those.
+static void _rhid_add_hat_buttons(rhid_device_t* device) {
+	static const uint16_t dpad[] = {
+		RHID_USAGE_GENERIC_DPAD_UP, RHID_USAGE_GENERIC_DPAD_RIGHT,
+		RHID_USAGE_GENERIC_DPAD_DOWN, RHID_USAGE_GENERIC_DPAD_LEFT};
+
+	int hat = -1;
+	for(int i = 0; i < device->value_count && hat < 0; i++) {
+		if(device->value_descriptors[i].page == RHID_PAGE_GENERIC &&
+		   device->value_descriptors[i].usage == RHID_USAGE_GENERIC_HATSWITCH) {
+			hat = i;
+		}
+	}
+	if(hat < 0) {
+		return;
+	}
+
+	for(int i = 0; i < device->button_count; i++) {
+		if(device->button_descriptors[i].page == RHID_PAGE_GENERIC &&
+		   device->button_descriptors[i].usage >= RHID_USAGE_GENERIC_DPAD_UP &&
+		   device->button_descriptors[i].usage <=
+			   RHID_USAGE_GENERIC_DPAD_LEFT) {
+			return;
+		}
+	}
+
+	if(device->button_count + 4 > MAX_BUTTON_COUNT) {
+		RHID_ERR("no room for the hat switch's d-pad buttons");
+		return;
+	}
+
+	for(int i = 0; i < 4; i++) {
+		struct rhid_button_descriptor_t* descriptor =
+			&device->button_descriptors[device->button_count];
+		descriptor->report_id = device->value_descriptors[hat].report_id;
+		descriptor->page	  = RHID_PAGE_GENERIC;
+		descriptor->usage	  = dpad[i];
+		descriptor->index	  = device->button_count;
+		descriptor->hat		  = hat;
+
+		device->button_count++;
+	}
+}
+
+// Opens the interface at device->path and fills in its attributes, names and
+// input capabilities. The handle is closed again before returning. Returns -2
+// when the interface can't be opened for lack of access, -1 on any other
+// failure.
+static int _rhid_probe(rhid_device_t* device) {
+	// open the the device with as little permissions as possible so we can
+	// read some attributes.
+	device->handle = _rhid_open_device_handle(
+		device->path, MAXIMUM_ALLOWED, FILE_SHARE_READ | FILE_SHARE_WRITE);
+	if(device->handle == NULL) {
+		device->handle = _rhid_open_device_handle(device->path, MAXIMUM_ALLOWED,
+												  FILE_SHARE_READ);
+
+		if(device->handle == NULL) {
+			return GetLastError() == ERROR_ACCESS_DENIED ? -2 : -1;
+		}
+	}
+
+	// get general attributes of the device.
+	HIDD_ATTRIBUTES attributes = {0};
+	if(HidD_GetAttributes(device->handle, &attributes) == TRUE) {
+		device->vendor_id  = attributes.VendorID;
+		device->product_id = attributes.ProductID;
+		device->version	   = attributes.VersionNumber;
+	}
+	else {
+		RHID_ERR("faild to retrieve device attributes");
+	}
+
+	// TODO think about moving manufacturer_name to global cache.
+	// this could potentially optimize the allocation and deletion of the
+	// 254 bytes that make up this 2-wide string.
+
+	// get the manufacturer of the device.
+	wchar_t manufacturer_name[127];
+	if(HidD_GetManufacturerString(device->handle, manufacturer_name,
+								  sizeof(manufacturer_name)) == TRUE) {
+		wcstombs(device->manufacturer_name, manufacturer_name,
+				 sizeof(device->manufacturer_name));
+	}
+	else {
+		RHID_ERR("failed to retrieve device manufacturer name");
+	}
+
+	// TODO think about moving product_name to global cache.
+	// this would be for the same reason as manufacturer_name.
+
+	// get the product name of the device.
+	wchar_t product_name[127];
+	if(HidD_GetProductString(device->handle, product_name,
+							 sizeof(product_name)) == TRUE) {
+		wcstombs(device->product_name, product_name,
+				 sizeof(device->product_name));
+	}
+	else {
+		RHID_ERR("failed to retrieve device product name");
+	}
+
+	_rhid_read_serial(device);
+
+	// get preparsed data from the device.
+	PHIDP_PREPARSED_DATA preparsed = {0};
+	if(HidD_GetPreparsedData(device->handle, &preparsed) == FALSE) {
+		RHID_ERR("failed to get pre-parsed data from device");
+
+		CloseHandle(device->handle);
+		device->handle = NULL;
 		return -1;
 	}
 
-	// jump through the enumeration until we get out of bounds.
-	const int jump_count = 5;
-	int		  last_index = 0;
+	// get device capabilities for various relatively useful attributes.
+	// although this is probably the last HidP_GetCaps, HidP_GetButtonsCaps
+	// and HidP_GetValueCaps will probably get called again when reading
+	// input reports.
+	HIDP_CAPS dev_caps;
+	{
+		ulong ret =
+			HidP_GetCaps((PHIDP_PREPARSED_DATA) preparsed, &dev_caps);
+		if(ret != HIDP_STATUS_SUCCESS) {
+			RHID_ERR("failed to get device's capabilities error: %s",
+					 _rhid_hidp_err_to_str(ret));
 
-	for(int i = jump_count;; i += jump_count) {
-		SP_DEVICE_INTERFACE_DATA iface = {0};
-		iface.cbSize				   = sizeof(SP_DEVICE_INTERFACE_DATA);
-		if(SetupDiEnumDeviceInterfaces(dev_list, NULL, &hid_guid, i, &iface) ==
-		   FALSE) {
-			if(GetLastError() == ERROR_NO_MORE_ITEMS) {
-				// we are too far outside of the array. break out and decriment
-				// i until we have reached the last valid index.
-				last_index = i;
-				break;
+			CloseHandle(device->handle);
+			device->handle = NULL;
+			HidD_FreePreparsedData(preparsed);
+			return -1;
+		}
+	}
+
+	// get button caps.
+	if(dev_caps.NumberInputButtonCaps > 0) {
+		if(_rhid_win_gcache.button_caps_count <
+		   dev_caps.NumberInputButtonCaps) {
+			if(_rhid_win_gcache.button_caps == NULL) {
+				_rhid_win_gcache.button_caps =
+					malloc(sizeof(HIDP_BUTTON_CAPS) *
+						   dev_caps.NumberInputButtonCaps);
 			}
 			else {
-				RHID_ERR_SYS("failed to enumerate through device interfaces",
-							 GetLastError());
-				SetupDiDestroyDeviceInfoList(dev_list);
+				_rhid_win_gcache.button_caps =
+					realloc(_rhid_win_gcache.button_caps,
+							sizeof(HIDP_BUTTON_CAPS) *
+								dev_caps.NumberInputButtonCaps);
+			}
+
+			_rhid_win_gcache.button_caps_count =
+				dev_caps.NumberInputButtonCaps;
+		}
+		HIDP_BUTTON_CAPS* button_caps = _rhid_win_gcache.button_caps;
+		device->cap_button_count	  = dev_caps.NumberInputButtonCaps;
+		{
+			ulong ret = HidP_GetButtonCaps(
+				HidP_Input, button_caps,
+				(PUSHORT) &device->cap_button_count, preparsed);
+			if(ret != HIDP_STATUS_SUCCESS) {
+				RHID_ERR("failed to get device's button error: %s",
+						 _rhid_hidp_err_to_str(ret));
+
+				CloseHandle(device->handle);
+				device->handle = NULL;
+				HidD_FreePreparsedData(preparsed);
 				return -1;
 			}
+			else {
+				// assign button report ids, page, usage, and index.
+				if(dev_caps.NumberInputButtonCaps > RHID_MAX_BUTTON_CAPS) {
+					RHID_ERR("the number of button caps is larger than the "
+							 "maximum supported");
+
+					CloseHandle(device->handle);
+					device->handle = NULL;
+					HidD_FreePreparsedData(preparsed);
+					return -1;
+				}
+
+				// every usage of a range gets its own descriptor, and the
+				// descriptor's position is the button's index.
+				int btn_desc_idx = 0;
+				for(int k = 0; k < dev_caps.NumberInputButtonCaps; k++) {
+					uint16_t usage_min = button_caps[k].NotRange.Usage;
+					uint16_t usage_max = button_caps[k].NotRange.Usage;
+					if(button_caps[k].IsRange == TRUE) {
+						usage_min = button_caps[k].Range.UsageMin;
+						usage_max = button_caps[k].Range.UsageMax;
+					}
+
+					for(uint32_t u = usage_min; u <= usage_max; u++) {
+						if(btn_desc_idx >= MAX_BUTTON_COUNT) {
+							RHID_ERR("more than %i buttons, the rest are "
+									 "ignored",
+									 MAX_BUTTON_COUNT);
+							break;
+						}
+
+						struct rhid_button_descriptor_t* descriptor =
+							&device->button_descriptors[btn_desc_idx];
+						descriptor->report_id = button_caps[k].ReportID;
+						descriptor->page	  = button_caps[k].UsagePage;
+						descriptor->usage	  = u;
+						descriptor->index	  = btn_desc_idx;
+						descriptor->hat		  = -1;
+
+						btn_desc_idx++;
+					}
+				}
+
+				device->button_count = btn_desc_idx;
+			}
 		}
 	}
 
-	// back-track to the last valid index which will be the final size.
-	for(; last_index >= 0; last_index--) {
-		SP_DEVICE_INTERFACE_DATA iface = {0};
-		iface.cbSize				   = sizeof(SP_DEVICE_INTERFACE_DATA);
-		if(SetupDiEnumDeviceInterfaces(dev_list, NULL, &hid_guid, last_index,
-									   &iface) == TRUE) {
-			break;
+	// get value caps.
+	if(dev_caps.NumberInputValueCaps > 0) {
+		if(_rhid_win_gcache.value_caps_count <
+		   dev_caps.NumberInputValueCaps) {
+			if(_rhid_win_gcache.value_caps == NULL) {
+				_rhid_win_gcache.value_caps =
+					malloc(sizeof(HIDP_VALUE_CAPS) *
+						   dev_caps.NumberInputValueCaps);
+			}
+			else {
+				_rhid_win_gcache.value_caps =
+					realloc(_rhid_win_gcache.value_caps,
+							sizeof(HIDP_VALUE_CAPS) *
+								dev_caps.NumberInputValueCaps);
+			}
+
+			_rhid_win_gcache.value_caps_count =
+				dev_caps.NumberInputValueCaps;
+		}
+
+		HIDP_VALUE_CAPS* value_caps = _rhid_win_gcache.value_caps;
+		device->cap_value_count		= dev_caps.NumberInputValueCaps;
+		{
+			ulong ret = HidP_GetValueCaps(
+				HidP_Input, value_caps,
+				(PUSHORT) &device->cap_value_count, preparsed);
+			if(ret != HIDP_STATUS_SUCCESS) {
+				RHID_ERR(
+					"failed to get device's value capabilities error: %s",
+					_rhid_hidp_err_to_str(ret));
+
+				CloseHandle(device->handle);
+				device->handle = NULL;
+				HidD_FreePreparsedData(preparsed);
+				return -1;
+			}
+			else {
+				// assign value report ids, page, usage, min/max, and index.
+				if(dev_caps.NumberInputValueCaps > RHID_MAX_VALUE_CAPS) {
+					RHID_ERR("the number of value caps is larger "
+							 "than the maximum supported");
+
+					CloseHandle(device->handle);
+					device->handle = NULL;
+					HidD_FreePreparsedData(preparsed);
+					return -1;
+				}
+
+				// ranges get a value per usage and a usage reported several
+				// times, a value array, a value per element.
+				int val_desc_idx = 0;
+				for(int k = 0; k < dev_caps.NumberInputValueCaps; k++) {
+					HIDP_VALUE_CAPS* cap = &value_caps[k];
+
+					int is_array =
+						cap->IsRange == FALSE && cap->ReportCount > 1;
+					int count = 1;
+					if(cap->IsRange == TRUE) {
+						count = cap->Range.UsageMax - cap->Range.UsageMin + 1;
+					}
+					else if(is_array) {
+						count = cap->ReportCount;
+					}
+
+					if(is_array && (cap->BitSize * cap->ReportCount + 7) / 8 >
+									   RHID_VALUE_ARRAY_BYTES) {
+						RHID_ERR("value array of usage %#x is larger than %i "
+								 "bytes and is ignored",
+								 cap->NotRange.Usage, RHID_VALUE_ARRAY_BYTES);
+						continue;
+					}
+					if(val_desc_idx + count > MAX_VALUE_COUNT) {
+						RHID_ERR("more than %i values, the rest are ignored",
+								 MAX_VALUE_COUNT);
+						break;
+					}
+
+					for(int e = 0; e < count; e++) {
+						struct rhid_value_descriptor_t* descriptor =
+							&device->value_descriptors[val_desc_idx];
+						descriptor->report_id	= cap->ReportID;
+						descriptor->page		= cap->UsagePage;
+						descriptor->logical_min = cap->LogicalMin;
+						descriptor->logical_max = cap->LogicalMax;
+						descriptor->index		= val_desc_idx;
+						descriptor->bit_size	= cap->BitSize;
+
+						if(cap->IsRange == TRUE) {
+							descriptor->usage = cap->Range.UsageMin + e;
+							descriptor->data_index =
+								cap->Range.DataIndexMin + e;
+						}
+						else {
+							descriptor->usage	   = cap->NotRange.Usage;
+							descriptor->data_index = cap->NotRange.DataIndex;
+						}
+
+						descriptor->array_index	 = 0;
+						descriptor->report_count = 1;
+						if(is_array) {
+							descriptor->data_index	 = -1;
+							descriptor->array_index	 = e;
+							descriptor->report_count = cap->ReportCount;
+						}
+
+						val_desc_idx++;
+					}
+				}
+
+				device->value_count = val_desc_idx;
+			}
 		}
 	}
 
-	// clean-up the device list.
-	SetupDiDestroyDeviceInfoList(dev_list);
+	_rhid_add_hat_buttons(device);
+
+	device->usage_page = dev_caps.UsagePage;
+	device->usage	   = dev_caps.Usage;
+
+	// device->cap_button_count = dev_caps.NumberInputButtonCaps;
+	// device->cap_value_count = dev_caps.NumberInputValueCaps;
+
+	// note that we shouldn't allocate the report array here as that
+	// wouldn't make all that much sense to the user. instead, allocate the
+	// report in rhid_device_open.
+	device->report_size = dev_caps.InputReportByteLength;
 
-	// return the final count.
-	return last_index + 1;
+	HidD_FreePreparsedData(preparsed);
+
+	CloseHandle(device->handle);
+	device->handle = NULL;
+
+	return 0;
 }
 
-static inline void* _rhid_open_device_handle(const char* path,
-											 ulong		 access_rights,
-											 ulong		 share_mode) {
-	void* handle = CreateFileA(path, access_rights, share_mode, NULL,
-							   OPEN_EXISTING, FILE_FLAG_OVERLAPPED, NULL);
-	if(handle == INVALID_HANDLE_VALUE) {
-		RHID_ERR_SYS(RHID_VARGS("failed to open device \"%s\"", path),
+// Copies the path of iface into path, NULL terminated. Keyboard interfaces end
+// in "\\kbd" which CreateFile doesn't accept, that part is cut off.
+static int _rhid_iface_path(HDEVINFO dev_list, SP_DEVICE_INTERFACE_DATA* iface,
+							SP_DEVINFO_DATA* dev_info, char* path,
+							const int size) {
+	// get the interface detail size.
+	ulong iface_info_size = 0;
+	if(SetupDiGetDeviceInterfaceDetailA(dev_list, iface, NULL, 0,
+										&iface_info_size, NULL) == FALSE &&
+	   GetLastError() != ERROR_INSUFFICIENT_BUFFER) {
+		RHID_ERR_SYS("failed to get device interface detail size",
 					 GetLastError());
+		return -1;
+	}
+
+	// get the device interface details.
+	SP_DEVICE_INTERFACE_DETAIL_DATA_A* iface_info = malloc(iface_info_size);
+	if(iface_info == NULL) {
+		return -1;
+	}
+	iface_info->cbSize = sizeof(SP_DEVICE_INTERFACE_DETAIL_DATA_A);
+
+	if(SetupDiGetDeviceInterfaceDetailA(dev_list, iface, iface_info,
+										iface_info_size, NULL,
+										dev_info) == FALSE) {
+		RHID_ERR_SYS("failed to get device interface detail data",
+					 GetLastError());
+		free(iface_info);
+		return -1;
+	}
+
+	int path_size = strlen(iface_info->DevicePath) + 1;
+	if(path_size > size) {
+		RHID_ERR("device path \"%s\" is too long", iface_info->DevicePath);
+		free(iface_info);
+		return -1;
+	}
+	memcpy(path, iface_info->DevicePath, path_size);
+	free(iface_info);
+
+	if(path_size >= 5 && path[path_size - 4] == 'k' &&
+	   path[path_size - 3] == 'b' && path[path_size - 2] == 'd') {
+		memset(path + path_size - 5, 0, 5);
+	}
+
+	return 0;
+}
+
+// Case insensitive strstr.
+static const char* _rhid_find_nocase(const char* str, const char* part) {
+	for(; *str != '\0'; str++) {
+		int i = 0;
+		while(part[i] != '\0' && tolower((unsigned char) str[i]) ==
+									 tolower((unsigned char) part[i])) {
+			i++;
+		}
+
+		if(part[i] == '\0') {
+			return str;
+		}
+	}
+
+	return NULL;
+}
+
+// Reads digits hex digits, -1 if one of them isn't hex.
+static int _rhid_parse_hex(const char* str, const int digits) {
+	int value = 0;
+	for(int i = 0; i < digits; i++) {
+		int c = tolower((unsigned char) str[i]);
+		if(c >= '0' && c <= '9') {
+			value = value << 4 | (c - '0');
+		}
+		else if(c >= 'a' && c <= 'f') {
+			value = value << 4 | (c - 'a' + 10);
+		}
+		else {
+			return -1;
+		}
+	}
+
+	return value;
+}
+
+// Finds the vendor and product id in an interface path or hardware id. USB
+// looks like "vid_045e&pid_02ff", bluetooth like "_vid&0002045e_pid&02e0"
+// where the first four vendor digits are the id source.
+static int _rhid_parse_ids(const char* str, uint16_t* vendor_id,
+						   uint16_t* product_id) {
+	const char* vid = _rhid_find_nocase(str, "vid_");
+	const char* pid = _rhid_find_nocase(str, "pid_");
+	int			vid_skip = 4;
+
+	if(vid == NULL || pid == NULL) {
+		vid		 = _rhid_find_nocase(str, "vid&");
+		pid		 = _rhid_find_nocase(str, "pid&");
+		vid_skip = 8;
+	}
+	if(vid == NULL || pid == NULL) {
+		return -1;
+	}
+
+	int vid_value = _rhid_parse_hex(vid + vid_skip, 4);
+	int pid_value = _rhid_parse_hex(pid + 4, 4);
+	if(vid_value < 0 || pid_value < 0) {
+		return -1;
+	}
+
+	*vendor_id	= vid_value;
+	*product_id = pid_value;
+	return 0;
+}
+
+// Finds the top level collection in a hardware id like
+// "HID_DEVICE_UP:0001_U:0005".
+static int _rhid_parse_usage(const char* str, uint16_t* usage_page,
+							 uint16_t* usage) {
+	const char* page = _rhid_find_nocase(str, "_up:");
+	if(page == NULL) {
+		return -1;
+	}
+
+	int page_value	= _rhid_parse_hex(page + 4, 4);
+	int usage_value = -1;
+	if(page_value >= 0 && _rhid_find_nocase(page + 8, "_u:") == page + 8) {
+		usage_value = _rhid_parse_hex(page + 11, 4);
+	}
+	if(page_value < 0 || usage_value < 0) {
+		return -1;
+	}
+
+	*usage_page = page_value;
+	*usage		= usage_value;
+	return 0;
+}
+
+// Fills in what the interface path and the hardware ids of its device node
+// tell about the interface without opening it. Returns the RHID_KNOWN bits of
+// what was found.
+static int _rhid_iface_peek(HDEVINFO dev_list, SP_DEVINFO_DATA* dev_info,
+							rhid_device_t* device) {
+	int known = 0;
+	if(_rhid_parse_ids(device->path, &device->vendor_id,
+					   &device->product_id) == 0) {
+		known |= RHID_KNOWN_IDS;
+	}
+
+	// a list of strings ending in an empty one.
+	char ids[1024];
+	if(SetupDiGetDeviceRegistryPropertyA(dev_list, dev_info, SPDRP_HARDWAREID,
+										 NULL, (BYTE*) ids, sizeof(ids) - 2,
+										 NULL) == FALSE) {
+		return known;
+	}
+	ids[sizeof(ids) - 2] = '\0';
+	ids[sizeof(ids) - 1] = '\0';
+
+	for(const char* id = ids; *id != '\0'; id += strlen(id) + 1) {
+		// "HID\VID_045E&PID_02FF&REV_0100", the same bcd number as
+		// HidD_GetAttributes gives.
+		const char* rev = _rhid_find_nocase(id, "rev_");
+		if(!(known & RHID_KNOWN_VERSION) && rev != NULL &&
+		   _rhid_parse_hex(rev + 4, 4) >= 0) {
+			device->version = _rhid_parse_hex(rev + 4, 4);
+			known |= RHID_KNOWN_VERSION;
+		}
+		if(!(known & RHID_KNOWN_IDS) &&
+		   _rhid_parse_ids(id, &device->vendor_id, &device->product_id) == 0) {
+			known |= RHID_KNOWN_IDS;
+		}
+		if(!(known & RHID_KNOWN_USAGE) &&
+		   _rhid_parse_usage(id, &device->usage_page, &device->usage) == 0) {
+			known |= RHID_KNOWN_USAGE;
+		}
+	}
+
+	return known;
+}
+
+// Whether any filter can match device going by what is known about it. No
+// filters match everything.
+static int _rhid_filter_match(const rhid_device_t* device, const int known) {
+	if(_rhid_registry.filter_count == 0) {
+		return 1;
+	}
+
+	for(int i = 0; i < _rhid_registry.filter_count; i++) {
+		const rhid_filter_t* filter = &_rhid_registry.filters[i];
+
+		if(known & RHID_KNOWN_IDS) {
+			if((filter->vendor_id != 0 &&
+				filter->vendor_id != device->vendor_id) ||
+			   (filter->product_id != 0 &&
+				filter->product_id != device->product_id)) {
+				continue;
+			}
+		}
+
+		if(known & RHID_KNOWN_USAGE) {
+			if((filter->usage_page != 0 &&
+				filter->usage_page != device->usage_page) ||
+			   (filter->usage != 0 && filter->usage != device->usage)) {
+				continue;
+			}
+		}
+
+		if(known & RHID_KNOWN_SERIAL) {
+			if(filter->serial_number[0] != '\0' &&
+			   strcmp(filter->serial_number, device->serial_number) != 0) {
+				continue;
+			}
+		}
+
+		if(filter->path[0] != '\0' &&
+		   _rhid_find_nocase(device->path, filter->path) == NULL) {
+			continue;
+		}
+
+		return 1;
+	}
+
+	return 0;
+}
+
+static uint16_t _rhid_cache_collection(const char* path) {
+	const char* col = _rhid_find_nocase(path, "&col");
+	if(col == NULL || _rhid_parse_hex(col + 4, 2) < 0) {
+		return 0;
+	}
+
+	return _rhid_parse_hex(col + 4, 2);
+}
+
+static int _rhid_cache_key_equal(const rhid_cache_entry_t* entry,
+								 const rhid_device_t* device,
+								 const uint16_t		  collection) {
+	return entry->vendor_id == device->vendor_id &&
+		   entry->product_id == device->product_id &&
+		   entry->version == device->version &&
+		   entry->usage_page == device->usage_page &&
+		   entry->usage == device->usage && entry->collection == collection;
+}
+
+static void _rhid_cache_unmap() {
+	if(_rhid_cache.view != NULL) {
+		UnmapViewOfFile(_rhid_cache.view);
+	}
+	if(_rhid_cache.mapping != NULL) {
+		CloseHandle(_rhid_cache.mapping);
+	}
+	if(_rhid_cache.file != NULL) {
+		CloseHandle(_rhid_cache.file);
+	}
+
+	_rhid_cache.view	= NULL;
+	_rhid_cache.mapping = NULL;
+	_rhid_cache.file	= NULL;
+	_rhid_cache.entries = NULL;
+	_rhid_cache.count	= 0;
+}
+
+// Maps the cache file, a missing or unusable file leaves the cache empty.
+static int _rhid_cache_map() {
+	_rhid_cache_unmap();
+
+	HANDLE file = CreateFileA(_rhid_cache.path, GENERIC_READ, FILE_SHARE_READ,
+							  NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if(file == INVALID_HANDLE_VALUE) {
+		return 0;
+	}
+	_rhid_cache.file = file;
+
+	LARGE_INTEGER size = {0};
+	if(GetFileSizeEx(file, &size) == FALSE ||
+	   size.QuadPart < (LONGLONG) sizeof(rhid_cache_header_t)) {
+		_rhid_cache_unmap();
+		return 0;
+	}
+
+	_rhid_cache.mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0,
+											 NULL);
+	if(_rhid_cache.mapping == NULL) {
+		RHID_ERR_SYS("failed to map the device cache", GetLastError());
+		_rhid_cache_unmap();
+		return -1;
+	}
+
+	_rhid_cache.view = MapViewOfFile(_rhid_cache.mapping, FILE_MAP_READ, 0, 0,
+									 0);
+	if(_rhid_cache.view == NULL) {
+		RHID_ERR_SYS("failed to map the device cache", GetLastError());
+		_rhid_cache_unmap();
+		return -1;
+	}
+
+	// a cache from another version is rebuilt rather than trusted.
+	const rhid_cache_header_t* header = _rhid_cache.view;
+	if(memcmp(header->magic, RHID_CACHE_MAGIC, 4) != 0 ||
+	   header->version != RHID_CACHE_VERSION ||
+	   header->entry_size != sizeof(rhid_cache_entry_t) ||
+	   header->count > RHID_CACHE_MAX ||
+	   size.QuadPart < (LONGLONG) (sizeof(rhid_cache_header_t) +
+								   header->count *
+									   sizeof(rhid_cache_entry_t))) {
+		DEBUG_LOG_WRN("ignoring the outdated device cache \"%s\"",
+					  _rhid_cache.path);
+		_rhid_cache_unmap();
+		return 0;
+	}
+
+	_rhid_cache.entries = (const rhid_cache_entry_t*) (header + 1);
+	_rhid_cache.count	= header->count;
+
+	return 0;
+}
+
+// Fills device from the cache if its model was probed before. The key comes
+// from _rhid_iface_peek, so all of it has to be known.
+static int _rhid_cache_load(rhid_device_t* device, const int known) {
+	const int key_known = RHID_KNOWN_IDS | RHID_KNOWN_USAGE |
+						  RHID_KNOWN_VERSION;
+	if(!_rhid_cache.is_open || (known & key_known) != key_known) {
+		return -1;
+	}
+
+	uint16_t				  collection = _rhid_cache_collection(device->path);
+	const rhid_cache_entry_t* entry		 = NULL;
+	for(int i = 0; i < _rhid_cache.count && entry == NULL; i++) {
+		if(_rhid_cache_key_equal(&_rhid_cache.entries[i], device,
+								 collection)) {
+			entry = &_rhid_cache.entries[i];
+		}
+	}
+	for(int i = 0; i < _rhid_cache.pending_count && entry == NULL; i++) {
+		if(_rhid_cache_key_equal(&_rhid_cache.pending[i], device,
+								 collection)) {
+			entry = &_rhid_cache.pending[i];
+		}
+	}
+	if(entry == NULL) {
+		DEBUG_COUNT("rhid.cache_misses", 1);
+		return -1;
+	}
+	DEBUG_COUNT("rhid.cache_hits", 1);
+
+	memcpy(device->product_name, entry->product_name,
+		   sizeof(device->product_name));
+	memcpy(device->manufacturer_name, entry->manufacturer_name,
+		   sizeof(device->manufacturer_name));
+
+	device->report_size		 = entry->report_size;
+	device->cap_button_count = entry->cap_button_count;
+	device->cap_value_count	 = entry->cap_value_count;
+	device->button_count	 = entry->button_count;
+	device->value_count		 = entry->value_count;
+
+	memcpy(device->button_descriptors, entry->button_descriptors,
+		   sizeof(device->button_descriptors));
+	memcpy(device->value_descriptors, entry->value_descriptors,
+		   sizeof(device->value_descriptors));
+
+	return 0;
+}
+
+// Takes a pending entry for a device about to be probed, keyed by what
+// _rhid_iface_peek found. The probe replaces the device's ids, version and
+// usage with what the device reports, which can differ from the hardware ids
+// _rhid_cache_load looks the key up by. Returns NULL when there is no room or
+// the key isn't fully known.
+static rhid_cache_entry_t* _rhid_cache_reserve(const rhid_device_t* device,
+											   const int			known) {
+	const int key_known = RHID_KNOWN_IDS | RHID_KNOWN_USAGE |
+						  RHID_KNOWN_VERSION;
+	if(!_rhid_cache.is_open || (known & key_known) != key_known ||
+	   _rhid_cache.count + _rhid_cache.pending_count >= RHID_CACHE_MAX) {
 		return NULL;
 	}
 
-	return handle;
+	rhid_cache_entry_t* entry =
+		&_rhid_cache.pending[_rhid_cache.pending_count++];
+	memset(entry, 0, sizeof(rhid_cache_entry_t));
+
+	entry->vendor_id  = device->vendor_id;
+	entry->product_id = device->product_id;
+	entry->version	  = device->version;
+	entry->usage_page = device->usage_page;
+	entry->usage	  = device->usage;
+	entry->collection = _rhid_cache_collection(device->path);
+
+	return entry;
 }
 
-// TODO reduce the insane level of nested loops and if statements.
-//		I think there is something like 7 levels of nesting at one point.
-int rhid_get_devices(rhid_device_t* devices, int count) {
+// Fills the entry reserved for a freshly probed device, it is written out by
+// the next _rhid_cache_flush.
+static void _rhid_cache_store(rhid_cache_entry_t*  entry,
+							  const rhid_device_t* device) {
+	memcpy(entry->product_name, device->product_name,
+		   sizeof(entry->product_name));
+	memcpy(entry->manufacturer_name, device->manufacturer_name,
+		   sizeof(entry->manufacturer_name));
+
+	entry->report_size		= device->report_size;
+	entry->cap_button_count = device->cap_button_count;
+	entry->cap_value_count	= device->cap_value_count;
+	entry->button_count		= device->button_count;
+	entry->value_count		= device->value_count;
+
+	memcpy(entry->button_descriptors, device->button_descriptors,
+		   sizeof(entry->button_descriptors));
+	memcpy(entry->value_descriptors, device->value_descriptors,
+		   sizeof(entry->value_descriptors));
+}
+
+// Writes the mapped and pending models to a temporary file that then replaces
+// the cache file, the view is unmapped while that happens.
+static int _rhid_cache_flush() {
+	if(!_rhid_cache.is_open || _rhid_cache.pending_count == 0) {
+		return 0;
+	}
+
+	char tmp_path[MAX_PATH + 4];
+	snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", _rhid_cache.path);
+
+	FILE* file = fopen(tmp_path, "wb");
+	if(file == NULL) {
+		RHID_ERR("failed to write the device cache \"%s\"", tmp_path);
+		_rhid_cache.pending_count = 0;
+		return -1;
+	}
+
+	rhid_cache_header_t header = {0};
+	memcpy(header.magic, RHID_CACHE_MAGIC, 4);
+	header.version	  = RHID_CACHE_VERSION;
+	header.entry_size = sizeof(rhid_cache_entry_t);
+	header.count	  = _rhid_cache.count + _rhid_cache.pending_count;
+
+	int failed = fwrite(&header, sizeof(header), 1, file) != 1;
+	if(_rhid_cache.count > 0) {
+		failed |= fwrite(_rhid_cache.entries, sizeof(rhid_cache_entry_t),
+						 _rhid_cache.count,
+						 file) != (size_t) _rhid_cache.count;
+	}
+	failed |= fwrite(_rhid_cache.pending, sizeof(rhid_cache_entry_t),
+					 _rhid_cache.pending_count,
+					 file) != (size_t) _rhid_cache.pending_count;
+	failed |= fclose(file) != 0;
+	_rhid_cache.pending_count = 0;
+
+	if(failed) {
+		RHID_ERR("failed to write the device cache \"%s\"", tmp_path);
+		remove(tmp_path);
+		return -1;
+	}
+
+	_rhid_cache_unmap();
+	if(MoveFileExA(tmp_path, _rhid_cache.path, MOVEFILE_REPLACE_EXISTING) ==
+	   FALSE) {
+		RHID_ERR_SYS("failed to replace the device cache", GetLastError());
+		remove(tmp_path);
+	}
+
+	return _rhid_cache_map();
+}
+
+static int _rhid_registry_find(const char* path) {
+	for(int i = 0; i < _rhid_registry.device_count; i++) {
+		if(strcmp(_rhid_registry.devices[i].path, path) == 0) {
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+// Queues a change, dropping the oldest one if nobody has been reading them.
+static void _rhid_registry_change(enum rhid_change_type_t type,
+								  const rhid_device_t*	  device) {
+	if(_rhid_registry.change_count == RHID_CHANGE_MAX) {
+		_rhid_registry.change_head =
+			(_rhid_registry.change_head + 1) % RHID_CHANGE_MAX;
+		_rhid_registry.change_count--;
+	}
+
+	rhid_change_t* change =
+		&_rhid_registry.changes[(_rhid_registry.change_head +
+								 _rhid_registry.change_count) %
+								RHID_CHANGE_MAX];
+	_rhid_registry.change_count++;
+
+	change->type	   = type;
+	change->vendor_id  = device->vendor_id;
+	change->product_id = device->product_id;
+	memcpy(change->path, device->path, sizeof(change->path));
+}
+
+static int _rhid_registry_rejected(const char* path) {
+	for(int i = 0; i < _rhid_registry.rejected_count; i++) {
+		if(strcmp(_rhid_registry.rejected[i], path) == 0) {
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+static void _rhid_registry_reject(const char* path) {
+	// past the maximum the rest are probed again next time.
+	if(_rhid_registry.rejected_count >= RHID_DEVICE_MAX) {
+		return;
+	}
+
+	int index = _rhid_registry.rejected_count++;
+	strcpy(_rhid_registry.rejected[index], path);
+	_rhid_registry.rejected_seen[index] = 1;
+}
+
+// Forgets the device at index, keeping the order of the rest.
+static void _rhid_registry_remove(const int index) {
+	_rhid_registry_change(RHID_CHANGE_REMOVED, &_rhid_registry.devices[index]);
+
+	int after = _rhid_registry.device_count - index - 1;
+	memmove(&_rhid_registry.devices[index], &_rhid_registry.devices[index + 1],
+			after * sizeof(rhid_device_t));
+	memmove(&_rhid_registry.seen[index], &_rhid_registry.seen[index + 1],
+			after);
+	memmove(&_rhid_registry.known[index], &_rhid_registry.known[index + 1],
+			after);
+	_rhid_registry.device_count--;
+}
+
+int rhid_refresh() {
+	// a notification arriving during the walk clears this again so the change
+	// isn't missed.
+	atomic_store(&_rhid_registry.valid, 1);
+
 	// get the HIDClass devices guid.
 	GUID hid_guid = {0};
 	HidD_GetHidGuid(&hid_guid);
@@ -190,13 +1198,17 @@ int rhid_get_devices(rhid_device_t* devices, int count) {
 
 	if(dev_list == INVALID_HANDLE_VALUE) {
 		RHID_ERR_SYS("failed to get devices from device class", GetLastError());
+		atomic_store(&_rhid_registry.valid, 0);
 		return -1;
 	}
 
-	for(int i = 0; i < count; i++) {
-		// set device values to zero.
-		memset(&devices[i], 0, sizeof(rhid_device_t));
+	memset(_rhid_registry.seen, 0, sizeof(_rhid_registry.seen));
+	memset(_rhid_registry.rejected_seen, 0,
+		   sizeof(_rhid_registry.rejected_seen));
+	int changes = 0;
+	int failed	= 0;
 
+	for(ulong i = 0;; i++) {
 		// get the next interface at index i. All the device interface is for is
 		// getting the device path.
 		SP_DEVICE_INTERFACE_DATA iface = {0};
@@ -207,306 +1219,291 @@ int rhid_get_devices(rhid_device_t* devices, int count) {
 			if(GetLastError() == ERROR_NO_MORE_ITEMS) {
 				break;
 			}
-			else {
-				RHID_ERR_SYS("failed to enumerate through device interfaces",
-							 GetLastError());
-				SetupDiDestroyDeviceInfoList(dev_list);
-				return -1;
-			}
-		}
 
-		// get the interface detail size.
-		ulong iface_info_size = 0;
-		if(SetupDiGetDeviceInterfaceDetailA(dev_list, &iface, NULL, 0,
-											&iface_info_size, NULL) == FALSE) {
-			if(GetLastError() != ERROR_INSUFFICIENT_BUFFER) {
-				RHID_ERR_SYS("failed to get device interface detail size",
-							 GetLastError());
-				return -1;
-			}
+			RHID_ERR_SYS("failed to enumerate through device interfaces",
+						 GetLastError());
+			SetupDiDestroyDeviceInfoList(dev_list);
+			atomic_store(&_rhid_registry.valid, 0);
+			return -1;
 		}
 
-		// get the device interface details.
-		SP_DEVICE_INTERFACE_DETAIL_DATA_A* iface_info =
-			malloc(iface_info_size * sizeof(SP_DEVICE_INTERFACE_DETAIL_DATA_A));
-		iface_info->cbSize = sizeof(SP_DEVICE_INTERFACE_DETAIL_DATA_A);
+		char			path[sizeof(((rhid_device_t*) NULL)->path)];
+		SP_DEVINFO_DATA dev_info = {0};
+		dev_info.cbSize			 = sizeof(SP_DEVINFO_DATA);
+		if(_rhid_iface_path(dev_list, &iface, &dev_info, path, sizeof(path)) <
+		   0) {
+			continue;
+		}
 
-		if(SetupDiGetDeviceInterfaceDetailA(dev_list, &iface, iface_info,
-											iface_info_size, NULL,
-											NULL) == FALSE) {
-			RHID_ERR_SYS("failed to get device interface detail data",
-						 GetLastError());
-			return -1;
+		// known interfaces were probed when they showed up.
+		int index = _rhid_registry_find(path);
+		if(index >= 0) {
+			_rhid_registry.seen[index] = 1;
+			continue;
 		}
 
-		// copy over the device path.
-		int next_iface_size = strlen(iface_info->DevicePath) + 1;
-		memcpy(devices[i].path, iface_info->DevicePath, next_iface_size);
+		index = _rhid_registry_rejected(path);
+		if(index >= 0) {
+			_rhid_registry.rejected_seen[index] = 1;
+			continue;
+		}
 
-		if(devices[i].path[next_iface_size - 4] == 'k' &&
-		   devices[i].path[next_iface_size - 3] == 'b' &&
-		   devices[i].path[next_iface_size - 2] == 'd') {
-			memset(devices[i].path + next_iface_size - 5, 0, 5);
+		if(_rhid_registry.device_count >= RHID_DEVICE_MAX) {
+			RHID_ERR("more than %i HID interfaces, \"%s\" is ignored",
+					 RHID_DEVICE_MAX, path);
+			continue;
 		}
 
-		free(iface_info);
-		RHID_ERR("\ngetting device (%i) \"%s\"", i, devices[i].path);
-		// open the the device with as little permissions as possible so we can
-		// read some attributes.
-		devices[i].handle =
-			_rhid_open_device_handle(devices[i].path, MAXIMUM_ALLOWED,
-									 FILE_SHARE_READ | FILE_SHARE_WRITE);
-		if(devices[i].handle == NULL) {
-			devices[i].handle = _rhid_open_device_handle(
-				devices[i].path, MAXIMUM_ALLOWED, FILE_SHARE_READ);
+		index				  = _rhid_registry.device_count;
+		rhid_device_t* device = &_rhid_registry.devices[index];
+		memset(device, 0, sizeof(rhid_device_t));
+		memcpy(device->path, path, sizeof(path));
 
-			if(devices[i].handle == NULL) {
+		// skip what no filter can match before paying to open it.
+		int known = 0;
+		if(_rhid_registry.filter_count > 0 || _rhid_cache.is_open) {
+			known = _rhid_iface_peek(dev_list, &dev_info, device);
+			if(_rhid_filter_match(device, known) == 0) {
 				continue;
 			}
 		}
 
-		// get general attributes of the device.
-		HIDD_ATTRIBUTES attributes = {0};
-		if(HidD_GetAttributes(devices[i].handle, &attributes) == TRUE) {
-			devices[i].vendor_id  = attributes.VendorID;
-			devices[i].product_id = attributes.ProductID;
-			devices[i].version	  = attributes.VersionNumber;
+		if(_rhid_cache_load(device, known) == 0) {
+			// only the serial number is left, and only filters care.
+			known |= RHID_KNOWN_ALL & ~RHID_KNOWN_SERIAL;
+			if(_rhid_registry.filter_count > 0) {
+				device->handle = _rhid_open_device_handle(
+					device->path, MAXIMUM_ALLOWED,
+					FILE_SHARE_READ | FILE_SHARE_WRITE);
+				if(device->handle != NULL) {
+					_rhid_read_serial(device);
+					CloseHandle(device->handle);
+					device->handle = NULL;
+					known |= RHID_KNOWN_SERIAL;
+				}
+			}
 		}
 		else {
-			RHID_ERR("faild to retrieve device attributes");
-		}
-
-		// TODO think about moving manufacturer_name to global cache.
-		// this could potentially optimize the allocation and deletion of the
-		// 254 bytes that make up this 2-wide string.
+			DEBUG_LOG_DBG("probing device (%i) \"%s\"", index, device->path);
+			rhid_cache_entry_t* entry = _rhid_cache_reserve(device, known);
+			int					ret	  = _rhid_probe(device);
+			if(ret == 0) {
+				known = RHID_KNOWN_ALL;
+				if(entry != NULL) {
+					_rhid_cache_store(entry, device);
+				}
+			}
+			else if(entry != NULL) {
+				// it was the last one taken.
+				_rhid_cache.pending_count--;
+			}
 
-		// get the manufacturer of the device.
-		wchar_t manufacturer_name[127];
-		if(HidD_GetManufacturerString(devices[i].handle, manufacturer_name,
-									  sizeof(manufacturer_name)) == TRUE) {
-			wcstombs(devices[i].manufacturer_name, manufacturer_name,
-					 sizeof(devices[i].manufacturer_name));
+			// an interface that can't be opened, like a keyboard held
+			// exclusively by the system, stays listed with what is known so
+			// it isn't opened again on every refresh. any other failure may
+			// be a device that is still settling, it's left out and probed
+			// again by the next refresh.
+			if(ret == -1) {
+				failed++;
+				continue;
+			}
 		}
-		else {
-			RHID_ERR("failed to retrieve device manufacturer name");
+
+		if(_rhid_filter_match(device, known) == 0) {
+			_rhid_registry_reject(device->path);
+			continue;
 		}
 
-		// TODO think about moving product_name to global cache.
-		// this would be for the same reason as manufacturer_name.
+		_rhid_registry.device_count++;
+		_rhid_registry.seen[index]	= 1;
+		_rhid_registry.known[index] = known;
 
-		// get the product name of the device.
-		wchar_t product_name[127];
-		if(HidD_GetProductString(devices[i].handle, product_name,
-								 sizeof(product_name)) == TRUE) {
-			wcstombs(devices[i].product_name, product_name,
-					 sizeof(devices[i].product_name));
-		}
-		else {
-			RHID_ERR("failed to retrieve device product name");
-		}
+		_rhid_registry_change(RHID_CHANGE_ADDED, device);
+		changes++;
+	}
+
+	// free device list.
+	SetupDiDestroyDeviceInfoList(dev_list);
+
+	// walk again on the next query instead of waiting for a notification, a
+	// few times.
+	if(failed == 0) {
+		_rhid_registry.probe_retries = 0;
+	}
+	else if(++_rhid_registry.probe_retries <= RHID_PROBE_RETRIES) {
+		atomic_store(&_rhid_registry.valid, 0);
+	}
 
-		// get preparsed data from the device.
-		PHIDP_PREPARSED_DATA preparsed = {0};
-		if(HidD_GetPreparsedData(devices[i].handle, &preparsed) == FALSE) {
-			RHID_ERR("failed to get pre-parsed data from device");
+	_rhid_cache_flush();
 
-			CloseHandle(devices[i].handle);
-			devices[i].handle = NULL;
+	// drop the interfaces that are gone.
+	for(int i = 0; i < _rhid_registry.device_count;) {
+		if(_rhid_registry.seen[i]) {
+			i++;
 			continue;
 		}
 
-		// get device capabilities for various relatively useful attributes.
-		// although this is probably the last HidP_GetCaps, HidP_GetButtonsCaps
-		// and HidP_GetValueCaps will probably get called again when reading
-		// input reports.
-		HIDP_CAPS dev_caps;
-		{
-			ulong ret =
-				HidP_GetCaps((PHIDP_PREPARSED_DATA) preparsed, &dev_caps);
-			if(ret != HIDP_STATUS_SUCCESS) {
-				RHID_ERR("failed to get device's capabilities error: %s",
-						 _rhid_hidp_err_to_str(ret));
+		_rhid_registry_remove(i);
+		changes++;
+	}
 
-				CloseHandle(devices[i].handle);
-				devices[i].handle = NULL;
-				HidD_FreePreparsedData(preparsed);
-				continue;
-			}
+	for(int i = 0; i < _rhid_registry.rejected_count;) {
+		if(_rhid_registry.rejected_seen[i]) {
+			i++;
+			continue;
 		}
 
-		// get button caps.
-		if(dev_caps.NumberInputButtonCaps > 0) {
-			if(_rhid_win_gcache.button_caps_count <
-			   dev_caps.NumberInputButtonCaps) {
-				if(_rhid_win_gcache.button_caps == NULL) {
-					_rhid_win_gcache.button_caps =
-						malloc(sizeof(HIDP_BUTTON_CAPS) *
-							   dev_caps.NumberInputButtonCaps);
-				}
-				else {
-					_rhid_win_gcache.button_caps =
-						realloc(_rhid_win_gcache.button_caps,
-								sizeof(HIDP_BUTTON_CAPS) *
-									dev_caps.NumberInputButtonCaps);
-				}
+		// order doesn't matter here, the last one fills the gap.
+		int last = --_rhid_registry.rejected_count;
+		memcpy(_rhid_registry.rejected[i], _rhid_registry.rejected[last],
+			   sizeof(_rhid_registry.rejected[i]));
+		_rhid_registry.rejected_seen[i] = _rhid_registry.rejected_seen[last];
+	}
 
-				_rhid_win_gcache.button_caps_count =
-					dev_caps.NumberInputButtonCaps;
-			}
-			HIDP_BUTTON_CAPS* button_caps = _rhid_win_gcache.button_caps;
-			devices[i].cap_button_count	  = dev_caps.NumberInputButtonCaps;
-			{
-				ulong ret = HidP_GetButtonCaps(
-					HidP_Input, button_caps,
-					(PUSHORT) &devices[i].cap_button_count, preparsed);
-				if(ret != HIDP_STATUS_SUCCESS) {
-					RHID_ERR("failed to get device's button error: %s",
-							 _rhid_hidp_err_to_str(ret));
-				}
-				else {
-					// assign button report ids, page, usage, and index.
-					if(dev_caps.NumberInputButtonCaps > RHID_MAX_BUTTON_CAPS) {
-						RHID_ERR("the number of button caps is larger than the "
-								 "maximum supported");
-
-						CloseHandle(devices[i].handle);
-						devices[i].handle = NULL;
-						HidD_FreePreparsedData(preparsed);
-						continue;
-					}
+	return changes;
+}
 
-					int btn_desc_idx = 0;
-					for(int k = 0; k < dev_caps.NumberInputButtonCaps; k++) {
-						devices[i].button_descriptors[btn_desc_idx].report_id =
-							button_caps[k].ReportID;
-
-						if(button_caps[k].IsRange == TRUE) {
-							for(uint16_t u = button_caps[k].Range.UsageMin;
-								u <= button_caps[k].Range.UsageMax; u++) {
-								devices[i]
-									.button_descriptors[btn_desc_idx]
-									.page = button_caps[k].UsagePage;
-								devices[i]
-									.button_descriptors[btn_desc_idx]
-									.usage = u;
-								// TODO confirm that this is the correct index.
-								devices[i]
-									.button_descriptors[btn_desc_idx]
-									.index = btn_desc_idx;
-
-								btn_desc_idx++;
-							}
-						}
-						else {
-							devices[i].button_descriptors[btn_desc_idx].page =
-								button_caps[k].UsagePage;
-							devices[i].button_descriptors[btn_desc_idx].usage =
-								button_caps[k].NotRange.Usage;
-
-							// TODO confirm that this is the correct index.
-							devices[i].button_descriptors[btn_desc_idx].index =
-								btn_desc_idx;
-						}
+// Runs on a system thread pool thread for every HID interface that arrives or
+// is removed.
+static DWORD CALLBACK _rhid_registry_notify(HCMNOTIFICATION		   notify,
+											PVOID				   context,
+											CM_NOTIFY_ACTION	   action,
+											PCM_NOTIFY_EVENT_DATA data,
+											DWORD				   data_size) {
+	atomic_store(&_rhid_registry.valid, 0);
+	return ERROR_SUCCESS;
+}
 
-						btn_desc_idx++;
-					}
-				}
-			}
-		}
+static void _rhid_registry_unlisten() {
+	CM_Unregister_Notification(_rhid_registry.notify);
+	_rhid_registry.notify = NULL;
+}
 
-		// get value caps.
-		if(dev_caps.NumberInputValueCaps > 0) {
-			if(_rhid_win_gcache.value_caps_count <
-			   dev_caps.NumberInputValueCaps) {
-				if(_rhid_win_gcache.value_caps == NULL) {
-					_rhid_win_gcache.value_caps =
-						malloc(sizeof(HIDP_VALUE_CAPS) *
-							   dev_caps.NumberInputValueCaps);
-				}
-				else {
-					_rhid_win_gcache.value_caps =
-						realloc(_rhid_win_gcache.value_caps,
-								sizeof(HIDP_VALUE_CAPS) *
-									dev_caps.NumberInputValueCaps);
-				}
+static void _rhid_registry_listen() {
+	CM_NOTIFY_FILTER filter = {0};
+	filter.cbSize			= sizeof(CM_NOTIFY_FILTER);
+	filter.FilterType		= CM_NOTIFY_FILTER_TYPE_DEVICEINTERFACE;
+	HidD_GetHidGuid(&filter.u.DeviceInterface.ClassGuid);
+
+	CONFIGRET ret = CM_Register_Notification(
+		&filter, NULL, _rhid_registry_notify, &_rhid_registry.notify);
+	if(ret != CR_SUCCESS) {
+		RHID_ERR("failed to register for HID arrival and removal error: %#x, "
+				 "devices are enumerated on every query",
+				 ret);
+		_rhid_registry.notify		 = NULL;
+		_rhid_registry.notify_failed = 1;
+		return;
+	}
 
-				_rhid_win_gcache.value_caps_count =
-					dev_caps.NumberInputValueCaps;
-			}
+	atexit(_rhid_registry_unlisten);
+}
 
-			HIDP_VALUE_CAPS* value_caps = _rhid_win_gcache.value_caps;
-			devices[i].cap_value_count	= dev_caps.NumberInputValueCaps;
-			{
-				ulong ret = HidP_GetValueCaps(
-					HidP_Input, value_caps,
-					(PUSHORT) &devices[i].cap_value_count, preparsed);
-				if(ret != HIDP_STATUS_SUCCESS) {
-					RHID_ERR(
-						"failed to get device's value capabilities error: %s",
-						_rhid_hidp_err_to_str(ret));
-				}
-				else {
-					// assign value report ids, page, usage, min/max, and index.
-					if(dev_caps.NumberInputValueCaps > RHID_MAX_VALUE_CAPS) {
-						RHID_ERR("the number of value caps is larger "
-								 "than the maximum supported");
-
-						CloseHandle(devices[i].handle);
-						devices[i].handle = NULL;
-						HidD_FreePreparsedData(preparsed);
-						continue;
-					}
+// Brings the registry up to date, only walking the interfaces when something
+// was plugged in or out since the last walk.
+static int _rhid_registry_sync() {
+	if(_rhid_registry.notify == NULL && !_rhid_registry.notify_failed) {
+		_rhid_registry_listen();
+	}
 
-					for(int k = 0; k < dev_caps.NumberInputValueCaps; k++) {
-						devices[i].value_descriptors[k].report_id =
-							value_caps[k].ReportID;
-						devices[i].value_descriptors[k].page =
-							value_caps[k].UsagePage;
+	if(_rhid_registry.notify != NULL && atomic_load(&_rhid_registry.valid)) {
+		return 0;
+	}
 
-						if(value_caps[k].IsRange == TRUE) {
-							RHID_ERR("ranged values not supported");
-							devices[i].value_descriptors[k].usage =
-								value_caps[k].Range.UsageMax;
-						}
-						else {
-							devices[i].value_descriptors[k].usage =
-								value_caps[k].NotRange.Usage;
-						}
+	return rhid_refresh();
+}
 
-						devices[i].value_descriptors[k].logical_min =
-							value_caps[k].LogicalMin;
-						devices[i].value_descriptors[k].logical_max =
-							value_caps[k].LogicalMax;
+int rhid_get_device_count() {
+	if(_rhid_registry_sync() < 0) {
+		return -1;
+	}
 
-						devices[i].value_descriptors[k].index = k;
-					}
-				}
-			}
-		}
+	return _rhid_registry.device_count;
+}
 
-		devices[i].usage_page = dev_caps.UsagePage;
-		devices[i].usage	  = dev_caps.Usage;
+int rhid_get_devices(rhid_device_t* devices, int count) {
+	if(_rhid_registry_sync() < 0) {
+		return -1;
+	}
 
-		// devices[i].cap_button_count = dev_caps.NumberInputButtonCaps;
-		// devices[i].cap_value_count = dev_caps.NumberInputValueCaps;
+	if(count > _rhid_registry.device_count) {
+		count = _rhid_registry.device_count;
+	}
+	memcpy(devices, _rhid_registry.devices, count * sizeof(rhid_device_t));
 
-		devices[i].button_count =
-			HidP_MaxUsageListLength(HidP_Input, 0, preparsed);
-		devices[i].value_count = dev_caps.NumberInputValueCaps;
+	return count;
+}
+
+int rhid_get_changes(rhid_change_t* changes, int count) {
+	if(count > _rhid_registry.change_count) {
+		count = _rhid_registry.change_count;
+	}
+
+	for(int i = 0; i < count; i++) {
+		changes[i] = _rhid_registry.changes[(_rhid_registry.change_head + i) %
+											RHID_CHANGE_MAX];
+	}
+
+	_rhid_registry.change_head =
+		(_rhid_registry.change_head + count) % RHID_CHANGE_MAX;
+	_rhid_registry.change_count -= count;
+
+	return count;
+}
+
+int rhid_cache_open(const char* path) {
+	_rhid_cache_flush();
+	_rhid_cache_unmap();
+	_rhid_cache.is_open		  = 0;
+	_rhid_cache.pending_count = 0;
+
+	if(path == NULL) {
+		return 0;
+	}
+
+	if(strlen(path) >= sizeof(_rhid_cache.path)) {
+		RHID_ERR("device cache path \"%s\" is too long", path);
+		return -1;
+	}
+	strcpy(_rhid_cache.path, path);
+
+	if(_rhid_cache_map() < 0) {
+		return -1;
+	}
+	_rhid_cache.is_open = 1;
+
+	return _rhid_cache.count;
+}
 
-		// note that we shouldn't allocate the report array here as that
-		// wouldn't make all that much sense to the user. instead, allocate the
-		// report in rhid_device_open.
-		devices[i].report_size = dev_caps.InputReportByteLength;
+int rhid_set_filters(const rhid_filter_t* filters, int count) {
+	if(count < 0 || count > RHID_FILTER_MAX) {
+		RHID_ERR("filter count %i isn't between 0 and %i", count,
+				 RHID_FILTER_MAX);
+		return -1;
+	}
 
-		HidD_FreePreparsedData(preparsed);
+	memcpy(_rhid_registry.filters, filters, count * sizeof(rhid_filter_t));
+	for(int i = 0; i < count; i++) {
+		_rhid_registry.filters[i].path[sizeof(filters->path) - 1] = '\0';
+		_rhid_registry.filters[i]
+			.serial_number[sizeof(filters->serial_number) - 1] = '\0';
+	}
+	_rhid_registry.filter_count = count;
+
+	// forget what doesn't match anymore.
+	for(int i = 0; i < _rhid_registry.device_count;) {
+		if(_rhid_filter_match(&_rhid_registry.devices[i],
+							  _rhid_registry.known[i])) {
+			i++;
+			continue;
+		}
 
-		CloseHandle(devices[i].handle);
-		devices[i].handle = NULL;
+		_rhid_registry_remove(i);
 	}
 
-	// free device list.
-	SetupDiDestroyDeviceInfoList(dev_list);
+	// interfaces the old filters skipped might match now.
+	_rhid_registry.rejected_count = 0;
+	atomic_store(&_rhid_registry.valid, 0);
 
 	return 0;
 }
@@ -547,41 +1544,265 @@ int rhid_select_devices(rhid_device_t* devices, int count,
 	return 0;
 }
 
-static int rhid_read_report(rhid_device_t* device, uint8_t report_id) {
-	unsigned long bytes_read = 0;
+// Returns 1 when a finished report was copied into device->report, 0 while
+// the read is still pending and -1 when reading failed.
+static int rhid_read_report(rhid_device_t* device) {
+	rhid_native_t* native	  = device->native;
+	unsigned long  bytes_read = 0;
+
+	if(native->is_reading == 0) {
+		if(ReadFile(device->handle, native->pending, device->report_size,
+					&bytes_read, &native->report_overlapped) == FALSE) {
+			if(GetLastError() != ERROR_IO_PENDING) {
+				RHID_ERR_SYS("didn't read a device report", GetLastError());
+				return -1;
+			}
+
+			native->is_reading = 1;
+			return 0;
+		}
+	}
+	else if(GetOverlappedResult(device->handle, &native->report_overlapped,
+								&bytes_read, FALSE) == FALSE) {
+		if(GetLastError() == ERROR_IO_INCOMPLETE) {
+			return 0;
+		}
+
+		RHID_ERR_SYS("didn't read a device report", GetLastError());
+		native->is_reading = 0;
+		return -1;
+	}
+
+	native->is_reading = 0;
+	memcpy(device->report, native->pending, device->report_size);
+
+	return 1;
+}
+
+static rhid_report_group_t* _rhid_report_group(rhid_device_t* device,
+											   const uint8_t  report_id) {
+	for(int i = 0; i < device->native->group_count; i++) {
+		if(device->native->groups[i].report_id == report_id) {
+			return &device->native->groups[i];
+		}
+	}
+
+	return NULL;
+}
+
+static rhid_report_group_t* _rhid_report_group_add(rhid_device_t* device,
+												   const uint8_t report_id) {
+	rhid_report_group_t* group = _rhid_report_group(device, report_id);
+	if(group != NULL) {
+		return group;
+	}
+
+	if(device->native->group_count >= RHID_REPORT_GROUP_MAX) {
+		RHID_ERR("more than %i report ids, report %i is ignored",
+				 RHID_REPORT_GROUP_MAX, report_id);
+		return NULL;
+	}
+
+	group = &device->native->groups[device->native->group_count++];
+	memset(group, 0, sizeof(rhid_report_group_t));
+	group->report_id = report_id;
+
+	return group;
+}
+
+// Sorts the descriptors into groups by report id.
+static void _rhid_report_groups_build(rhid_device_t* device) {
+	device->native->group_count = 0;
 
-	if(device->native->is_reading) {
-		// check to see if read is done.
-		GetOverlappedResult(device->handle, &_rhid_win_gcache.report_overlapped,
-							&bytes_read, FALSE);
+	for(int i = 0; i < device->button_count; i++) {
+		const struct rhid_button_descriptor_t* descriptor =
+			&device->button_descriptors[i];
+		rhid_report_group_t* group =
+			_rhid_report_group_add(device, descriptor->report_id);
+		if(group == NULL) {
+			continue;
+		}
 
-		if(bytes_read >= device->report_size) {
-			device->native->is_reading = 0;
+		if(descriptor->hat < 0) {
+			group->buttons[group->button_count++] = i;
 		}
 		else {
-			return 0;
+			group->hats[group->hat_count++] = i;
 		}
 	}
 
-	// set the first byte to be the report id as specified in the docs.
-	device->report[0] = report_id;
+	for(int i = 0; i < device->value_count; i++) {
+		const struct rhid_value_descriptor_t* descriptor =
+			&device->value_descriptors[i];
+		rhid_report_group_t* group =
+			_rhid_report_group_add(device, descriptor->report_id);
+		if(group == NULL) {
+			continue;
+		}
 
-	if(ReadFile(device->handle, device->report, device->report_size,
-				&bytes_read, &_rhid_win_gcache.report_overlapped) == FALSE) {
-		if(GetLastError() != ERROR_IO_PENDING) {
-			RHID_ERR_SYS("didn't read a device report", (int) GetLastError());
-			// TODO think about doing return -1 instead. Note that this will
-			// make any if statements return true which is wierd.
-			return 0;
+		group->value_count++;
+		if(descriptor->report_count > 1 && descriptor->array_index == 0) {
+			group->arrays[group->array_count++] = i;
 		}
 	}
+}
 
-	if(device->native->is_reading == 0) {
-		device->native->is_reading = 1;
-		return 1;
+static inline int _rhid_lookup_hash(const uint16_t page, const uint16_t usage) {
+	uint32_t key = (uint32_t) page << 16 | usage;
+	return (key * 2654435761u) >> (32 - RHID_LOOKUP_BITS);
+}
+
+// The lookup tables are never more than half full, so probing always ends on
+// an empty slot.
+static int _rhid_lookup_button(const rhid_device_t* device, const uint16_t page,
+							   const uint16_t usage) {
+	for(int slot = _rhid_lookup_hash(page, usage);;
+		slot = (slot + 1) & (RHID_LOOKUP_SIZE - 1)) {
+		int index = device->button_lookup[slot];
+		if(index < 0) {
+			return -1;
+		}
+
+		if(device->button_descriptors[index].page == page &&
+		   device->button_descriptors[index].usage == usage) {
+			return index;
+		}
 	}
+}
 
-	return 0;
+static int _rhid_lookup_value(const rhid_device_t* device, const uint16_t page,
+							  const uint16_t usage) {
+	for(int slot = _rhid_lookup_hash(page, usage);;
+		slot = (slot + 1) & (RHID_LOOKUP_SIZE - 1)) {
+		int index = device->value_lookup[slot];
+		if(index < 0) {
+			return -1;
+		}
+
+		if(device->value_descriptors[index].page == page &&
+		   device->value_descriptors[index].usage == usage) {
+			return index;
+		}
+	}
+}
+
+static void _rhid_lookup_insert(int8_t* lookup, const uint16_t page,
+								const uint16_t usage, const int index) {
+	int slot = _rhid_lookup_hash(page, usage);
+	while(lookup[slot] >= 0) {
+		slot = (slot + 1) & (RHID_LOOKUP_SIZE - 1);
+	}
+
+	lookup[slot] = index;
+}
+
+// Maps the (page, usage) of every button and value to its descriptor. A usage
+// listed twice keeps its first descriptor.
+static void _rhid_lookup_build(rhid_device_t* device) {
+	memset(device->button_lookup, -1, sizeof(device->button_lookup));
+	memset(device->value_lookup, -1, sizeof(device->value_lookup));
+
+	for(int i = 0; i < device->button_count; i++) {
+		struct rhid_button_descriptor_t* descriptor =
+			&device->button_descriptors[i];
+		if(_rhid_lookup_button(device, descriptor->page, descriptor->usage) <
+		   0) {
+			_rhid_lookup_insert(device->button_lookup, descriptor->page,
+								descriptor->usage, i);
+		}
+	}
+
+	for(int i = 0; i < device->value_count; i++) {
+		struct rhid_value_descriptor_t* descriptor =
+			&device->value_descriptors[i];
+		if(_rhid_lookup_value(device, descriptor->page, descriptor->usage) <
+		   0) {
+			_rhid_lookup_insert(device->value_lookup, descriptor->page,
+								descriptor->usage, i);
+		}
+	}
+}
+
+static int _rhid_decode_report(rhid_device_t*			   device,
+							   const rhid_report_group_t* group);
+
+static void _rhid_write_field_add(rhid_native_t* native, const int type,
+								  const uint8_t report_id, const int is_button,
+								  const uint16_t page, const uint16_t usage) {
+	if(native->field_count >= RHID_WRITE_FIELD_MAX) {
+		RHID_ERR("more than %i output and feature usages, the rest are "
+				 "ignored",
+				 RHID_WRITE_FIELD_MAX);
+		return;
+	}
+
+	rhid_write_field_t* field = &native->fields[native->field_count++];
+	field->type				  = type;
+	field->report_id		  = report_id;
+	field->is_button		  = is_button;
+	field->page				  = page;
+	field->usage			  = usage;
+}
+
+// Lists the usages of one report type, ranges expanded, so rhid_set_usage
+// knows which report a usage goes in.
+static void _rhid_write_fields_build(rhid_device_t*	  device,
+									 const HIDP_CAPS* dev_caps,
+									 const int		  type) {
+	rhid_native_t*	 native		 = device->native;
+	HIDP_REPORT_TYPE report_type = HidP_Output;
+	ushort			 button_count = dev_caps->NumberOutputButtonCaps;
+	ushort			 value_count  = dev_caps->NumberOutputValueCaps;
+	if(type == RHID_REPORT_FEATURE) {
+		report_type	 = HidP_Feature;
+		button_count = dev_caps->NumberFeatureButtonCaps;
+		value_count	 = dev_caps->NumberFeatureValueCaps;
+	}
+
+	if(button_count > 0) {
+		HIDP_BUTTON_CAPS* caps =
+			malloc(button_count * sizeof(HIDP_BUTTON_CAPS));
+		if(caps != NULL && HidP_GetButtonCaps(report_type, caps, &button_count,
+											  device->_preparsed) ==
+							   HIDP_STATUS_SUCCESS) {
+			for(int k = 0; k < button_count; k++) {
+				uint16_t usage_min = caps[k].NotRange.Usage;
+				uint16_t usage_max = caps[k].NotRange.Usage;
+				if(caps[k].IsRange == TRUE) {
+					usage_min = caps[k].Range.UsageMin;
+					usage_max = caps[k].Range.UsageMax;
+				}
+
+				for(uint32_t u = usage_min; u <= usage_max; u++) {
+					_rhid_write_field_add(native, type, caps[k].ReportID, 1,
+										  caps[k].UsagePage, u);
+				}
+			}
+		}
+		free(caps);
+	}
+
+	if(value_count > 0) {
+		HIDP_VALUE_CAPS* caps = malloc(value_count * sizeof(HIDP_VALUE_CAPS));
+		if(caps != NULL && HidP_GetValueCaps(report_type, caps, &value_count,
+											 device->_preparsed) ==
+							   HIDP_STATUS_SUCCESS) {
+			for(int k = 0; k < value_count; k++) {
+				uint16_t usage_min = caps[k].NotRange.Usage;
+				uint16_t usage_max = caps[k].NotRange.Usage;
+				if(caps[k].IsRange == TRUE) {
+					usage_min = caps[k].Range.UsageMin;
+					usage_max = caps[k].Range.UsageMax;
+				}
+
+				for(uint32_t u = usage_min; u <= usage_max; u++) {
+					_rhid_write_field_add(native, type, caps[k].ReportID, 0,
+										  caps[k].UsagePage, u);
+				}
+			}
+		}
+		free(caps);
+	}
 }
 
 int rhid_open(rhid_device_t* device) {
@@ -614,18 +1835,63 @@ int rhid_open(rhid_device_t* device) {
 	device->_preparsed = preparsed;
 	device->report	   = malloc(device->report_size);
 
+	_rhid_lookup_build(device);
+
 	device->buttons = calloc(device->button_count, sizeof(uint8_t));
 	device->values	= calloc(device->value_count, sizeof(uint32_t));
 
 	device->native			   = calloc(1, sizeof(rhid_native_t));
 	device->native->is_reading = 0;
 
-	// read initial report.
-	if(HidD_GetInputReport(device->handle, device->report, device->report_size) == FALSE) {
-		RHID_ERR_SYS("failed to get initial input report", GetLastError());
+	// one HidP_GetData call decodes every value but the arrays, its data
+	// indices are mapped back to the value descriptors.
+	rhid_native_t* native = device->native;
+	native->data_length	  = HidP_MaxDataListLength(HidP_Input, preparsed);
+	native->data		  = malloc(native->data_length * sizeof(HIDP_DATA));
+
+	for(int i = 0; i < device->value_count; i++) {
+		int data_index = device->value_descriptors[i].data_index;
+		if(data_index >= native->data_value_count) {
+			native->data_value_count = data_index + 1;
+		}
 	}
-	else {
-		// TODO read initial report values.
+	native->data_values = malloc(native->data_value_count);
+	memset(native->data_values, -1, native->data_value_count);
+	for(int i = 0; i < device->value_count; i++) {
+		if(device->value_descriptors[i].data_index >= 0) {
+			native->data_values[device->value_descriptors[i].data_index] = i;
+		}
+	}
+
+	_rhid_report_groups_build(device);
+
+	native->pending = malloc(device->report_size);
+	native->report_overlapped.hEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+
+	// output and feature reports aren't cached with the input capabilities,
+	// they're only needed once a device is open.
+	HIDP_CAPS dev_caps = {0};
+	if(HidP_GetCaps(preparsed, &dev_caps) == HIDP_STATUS_SUCCESS) {
+		native->output_size	 = dev_caps.OutputReportByteLength;
+		native->feature_size = dev_caps.FeatureReportByteLength;
+		_rhid_write_fields_build(device, &dev_caps, RHID_REPORT_OUTPUT);
+		_rhid_write_fields_build(device, &dev_caps, RHID_REPORT_FEATURE);
+	}
+	native->writing = malloc(native->output_size > native->feature_size
+								 ? native->output_size
+								 : native->feature_size);
+	native->write_overlapped.hEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+
+	// read the initial state of every report id.
+	for(int i = 0; i < native->group_count; i++) {
+		device->report[0] = native->groups[i].report_id;
+		if(HidD_GetInputReport(device->handle, device->report,
+							   device->report_size) == FALSE) {
+			RHID_ERR_SYS("failed to get initial input report", GetLastError());
+			continue;
+		}
+
+		_rhid_decode_report(device, &native->groups[i]);
 	}
 
 	device->is_open = 1;
@@ -638,6 +1904,26 @@ int rhid_close(rhid_device_t* device) {
 		return -1;
 	}
 
+	// the read and write in flight use native's buffers until they're
+	// cancelled.
+	if(device->native != NULL &&
+	   (device->native->is_reading || device->native->is_writing)) {
+		unsigned long bytes = 0;
+		CancelIo(device->handle);
+		if(device->native->is_reading) {
+			GetOverlappedResult(device->handle,
+								&device->native->report_overlapped, &bytes,
+								TRUE);
+		}
+		if(device->native->is_writing) {
+			GetOverlappedResult(device->handle,
+								&device->native->write_overlapped, &bytes,
+								TRUE);
+		}
+		device->native->is_reading = 0;
+		device->native->is_writing = 0;
+	}
+
 	if(device->handle != NULL) {
 		CloseHandle(device->handle);
 		device->handle = NULL;
@@ -664,6 +1950,19 @@ int rhid_close(rhid_device_t* device) {
 	}
 
 	if(device->native != NULL) {
+		if(device->native->report_overlapped.hEvent != NULL) {
+			CloseHandle(device->native->report_overlapped.hEvent);
+		}
+		if(device->native->write_overlapped.hEvent != NULL) {
+			CloseHandle(device->native->write_overlapped.hEvent);
+		}
+		for(int i = 0; i < device->native->write_count; i++) {
+			free(device->native->writes[i].data);
+		}
+		free(device->native->writing);
+		free(device->native->pending);
+		free(device->native->data);
+		free(device->native->data_values);
 		free(device->native);
 		device->native = NULL;
 	}
@@ -673,40 +1972,110 @@ int rhid_close(rhid_device_t* device) {
 	return 0;
 }
 
-int rhid_report(rhid_device_t* device, uint8_t report_id) {
-	// If the device isn't open, error out.
-	if(device->handle == NULL || device->is_open == 0) {
-		RHID_ERR("can't get a report because the device isn't open");
+// Reads the value array starting at the value descriptor first, its elements
+// are packed bit_size bits apart starting at the lowest bit.
+static int _rhid_read_value_array(rhid_device_t* device, const int first) {
+	const struct rhid_value_descriptor_t* descriptor =
+		&device->value_descriptors[first];
+
+	uint8_t bytes[RHID_VALUE_ARRAY_BYTES] = {0};
+	ulong	ret = HidP_GetUsageValueArray(
+		HidP_Input, descriptor->page, 0, descriptor->usage, (PCHAR) bytes,
+		sizeof(bytes), device->_preparsed, device->report, device->report_size);
+	// the array is in another report.
+	if(ret == HIDP_STATUS_INCOMPATIBLE_REPORT_ID) {
+		return 0;
+	}
+	if(ret != HIDP_STATUS_SUCCESS) {
+		RHID_ERR("failed to parse value array from report error %s",
+				 _rhid_hidp_err_to_str(ret));
+		DEBUG_COUNT("rhid.report_errors", 1);
 		return -1;
 	}
 
-	// read report.
-	int report_avaliable = rhid_read_report(device, report_id);
+	int bit = 0;
+	for(int e = 0; e < descriptor->report_count; e++) {
+		uint32_t value = 0;
+		for(int b = 0; b < descriptor->bit_size; b++, bit++) {
+			if(b < 32 && (bytes[bit >> 3] >> (bit & 7) & 1)) {
+				value |= (uint32_t) 1 << b;
+			}
+		}
+
+		device->values[first + e] = value;
+	}
+
+	return 0;
+}
+
+// Presses the virtual d-pad buttons of the hat switch position. Positions go
+// clockwise from up, a 4-way hat is spread over the 8-way positions, and a
+// value outside the logical range is the null state with nothing pressed.
+static void _rhid_decode_hats(rhid_device_t*			   device,
+							  const rhid_report_group_t* group) {
+	for(int i = 0; i < group->hat_count; i++) {
+		const struct rhid_button_descriptor_t* button =
+			&device->button_descriptors[group->hats[i]];
+
+		const struct rhid_value_descriptor_t* hat =
+			&device->value_descriptors[button->hat];
+		int positions = hat->logical_max - hat->logical_min + 1;
+		int position  = (int) device->values[button->hat] - hat->logical_min;
+
+		int pressed = 0;
+		if(positions > 0 && position >= 0 && position < positions) {
+			int octant = position * 8 / positions;
+			switch(button->usage) {
+				case RHID_USAGE_GENERIC_DPAD_UP:
+					pressed = octant == 7 || octant <= 1;
+					break;
+
+				case RHID_USAGE_GENERIC_DPAD_RIGHT:
+					pressed = octant >= 1 && octant <= 3;
+					break;
+
+				case RHID_USAGE_GENERIC_DPAD_DOWN:
+					pressed = octant >= 3 && octant <= 5;
+					break;
+
+				case RHID_USAGE_GENERIC_DPAD_LEFT:
+					pressed = octant >= 5 && octant <= 7;
+					break;
+			}
+		}
+
+		device->buttons[button->index] = pressed;
+	}
+}
 
+// Decodes device->report into the fields of its report id, the fields of
+// other report ids keep the state their last report left.
+static int _rhid_decode_report(rhid_device_t*			   device,
+							   const rhid_report_group_t* group) {
 	// parse button data from report.
-	ulong		   active_count					  = MAX_BUTTON_COUNT;
-	USAGE_AND_PAGE usages_pages[MAX_BUTTON_COUNT] = {0};
-	if(report_avaliable) {
+	if(group->button_count > 0) {
+		ulong		   active_count					  = MAX_BUTTON_COUNT;
+		USAGE_AND_PAGE usages_pages[MAX_BUTTON_COUNT] = {0};
 		ulong ret = HidP_GetUsagesEx(HidP_Input, 0, usages_pages, &active_count,
 									 (PHIDP_PREPARSED_DATA) device->_preparsed,
 									 device->report, device->report_size);
 		if(ret != HIDP_STATUS_SUCCESS) {
 			RHID_ERR("failed to parse button data from report error: %s",
 					 _rhid_hidp_err_to_str(ret));
+			DEBUG_COUNT("rhid.report_errors", 1);
 			return -1;
 		}
 
-		memset(device->buttons, 0, device->button_count);
+		for(int i = 0; i < group->button_count; i++) {
+			device->buttons[device->button_descriptors[group->buttons[i]]
+								.index] = 0;
+		}
 
 		for(int j = 0; j < active_count; j++) {
-			for(int i = 0; i < device->button_count; i++) {
-				if(device->button_descriptors[i].page ==
-					   usages_pages[j].UsagePage &&
-				   device->button_descriptors[i].usage ==
-					   usages_pages[j].Usage) {
-					device->buttons[device->button_descriptors[i].index] = 1;
-					break;
-				}
+			int i = _rhid_lookup_button(device, usages_pages[j].UsagePage,
+										usages_pages[j].Usage);
+			if(i >= 0) {
+				device->buttons[device->button_descriptors[i].index] = 1;
 			}
 		}
 
@@ -749,21 +2118,246 @@ int rhid_report(rhid_device_t* device, uint8_t report_id) {
 		}*/
 	}
 
-	if(report_avaliable == 0) {
+	if(group->value_count == 0) {
 		return 0;
 	}
 
-	// parse value data from report.
-	for(int i = 0; i < device->value_count; i++) {
-		ulong ret = HidP_GetUsageValue(
-			HidP_Input, device->value_descriptors[i].page, 0,
-			device->value_descriptors[i].usage, (PULONG) &device->values[i],
-			device->_preparsed, device->report, device->report_size);
+	// parse value data from report, one call for all the single values and
+	// one per value array.
+	rhid_native_t* native	  = device->native;
+	ulong		   data_count = native->data_length;
+	ulong ret = HidP_GetData(HidP_Input, native->data, &data_count,
+							 device->_preparsed, device->report,
+							 device->report_size);
+	if(ret != HIDP_STATUS_SUCCESS) {
+		RHID_ERR("failed to parse value data from report error %s",
+				 _rhid_hidp_err_to_str(ret));
+		DEBUG_COUNT("rhid.report_errors", 1);
+	}
+	else {
+		for(ulong i = 0; i < data_count; i++) {
+			int data_index = native->data[i].DataIndex;
+			if(data_index < native->data_value_count &&
+			   native->data_values[data_index] >= 0) {
+				device->values[native->data_values[data_index]] =
+					native->data[i].RawValue;
+			}
+		}
+	}
 
-		if(ret != HIDP_STATUS_SUCCESS) {
-			RHID_ERR("failed to parse value data from report error %s",
-					 _rhid_hidp_err_to_str(ret));
+	for(int i = 0; i < group->array_count; i++) {
+		_rhid_read_value_array(device, group->arrays[i]);
+	}
+
+	_rhid_decode_hats(device, group);
+
+	return 0;
+}
+
+int rhid_report(rhid_device_t* device, uint8_t report_id) {
+	// If the device isn't open, error out.
+	if(device->handle == NULL || device->is_open == 0) {
+		RHID_ERR("can't get a report because the device isn't open");
+		return -1;
+	}
+
+	uint64_t report_start = debug_time_ns();
+	DEBUG_COUNT("rhid.reports", 1);
+
+	// take every report that arrived since the last call, a device with
+	// several report ids sends them one after another.
+	int ret = 0;
+	for(int i = 0; i < RHID_REPORT_DRAIN_MAX; i++) {
+		int report_avaliable = rhid_read_report(device);
+		if(report_avaliable < 0) {
+			ret = -1;
+			break;
+		}
+		if(report_avaliable == 0) {
+			break;
+		}
+		DEBUG_COUNT("rhid.reports_read", 1);
+
+		// reading a report consumes it, so every id is decoded.
+		uint8_t				 id	   = device->report[0];
+		rhid_report_group_t* group = _rhid_report_group(device, id);
+		if(group == NULL) {
+			continue;
+		}
+
+		if(_rhid_decode_report(device, group) < 0) {
+			ret = -1;
+		}
+	}
+
+	DEBUG_HIST("rhid.report_ns", debug_time_ns() - report_start);
+
+	return ret;
+}
+
+// The report a usage is sent in, made and initialized the first time one of
+// its usages is set.
+static rhid_write_report_t* _rhid_write_report(rhid_device_t*	device,
+												const int		type,
+												const uint8_t report_id) {
+	rhid_native_t* native = device->native;
+	for(int i = 0; i < native->write_count; i++) {
+		if(native->writes[i].type == type &&
+		   native->writes[i].report_id == report_id) {
+			return &native->writes[i];
+		}
+	}
+
+	if(native->write_count >= RHID_WRITE_REPORT_MAX) {
+		RHID_ERR("more than %i output and feature reports",
+				 RHID_WRITE_REPORT_MAX);
+		return NULL;
+	}
+
+	ulong size =
+		type == RHID_REPORT_OUTPUT ? native->output_size : native->feature_size;
+	char* data = calloc(1, size);
+	if(data == NULL) {
+		return NULL;
+	}
+
+	ulong ret = HidP_InitializeReportForID(
+		type == RHID_REPORT_OUTPUT ? HidP_Output : HidP_Feature, report_id,
+		device->_preparsed, data, size);
+	if(ret != HIDP_STATUS_SUCCESS) {
+		RHID_ERR("failed to initialize report %i error: %s", report_id,
+				 _rhid_hidp_err_to_str(ret));
+		free(data);
+		return NULL;
+	}
+
+	rhid_write_report_t* report = &native->writes[native->write_count++];
+	report->type				= type;
+	report->report_id			= report_id;
+	report->dirty				= 0;
+	report->data				= data;
+
+	return report;
+}
+
+int rhid_set_usage(rhid_device_t* device, enum rhid_report_type_t type,
+				   uint16_t page, uint16_t usage, uint32_t value) {
+	if(device->is_open == 0) {
+		RHID_ERR("can't set a usage because the device isn't open");
+		return -1;
+	}
+
+	rhid_native_t*		native = device->native;
+	rhid_write_field_t* field  = NULL;
+	for(int i = 0; i < native->field_count && field == NULL; i++) {
+		if(native->fields[i].type == type && native->fields[i].page == page &&
+		   native->fields[i].usage == usage) {
+			field = &native->fields[i];
+		}
+	}
+	if(field == NULL) {
+		return -1;
+	}
+
+	rhid_write_report_t* report =
+		_rhid_write_report(device, type, field->report_id);
+	if(report == NULL) {
+		return -1;
+	}
+
+	HIDP_REPORT_TYPE report_type =
+		type == RHID_REPORT_OUTPUT ? HidP_Output : HidP_Feature;
+	ulong size =
+		type == RHID_REPORT_OUTPUT ? native->output_size : native->feature_size;
+
+	ulong ret;
+	if(field->is_button) {
+		USAGE usages[1]	  = {usage};
+		ulong usage_count = 1;
+		if(value != 0) {
+			ret = HidP_SetUsages(report_type, page, 0, usages, &usage_count,
+								 device->_preparsed, report->data, size);
+		}
+		else {
+			ret = HidP_UnsetUsages(report_type, page, 0, usages, &usage_count,
+								   device->_preparsed, report->data, size);
+		}
+	}
+	else {
+		ret = HidP_SetUsageValue(report_type, page, 0, usage, value,
+								 device->_preparsed, report->data, size);
+	}
+
+	// unsetting a usage that isn't set is fine.
+	if(ret != HIDP_STATUS_SUCCESS && ret != HIDP_STATUS_BUTTON_NOT_PRESSED) {
+		RHID_ERR("failed to set usage %#x:%#x error: %s", page, usage,
+				 _rhid_hidp_err_to_str(ret));
+		return -1;
+	}
+
+	report->dirty = 1;
+
+	return 0;
+}
+
+int rhid_write(rhid_device_t* device) {
+	if(device->is_open == 0) {
+		RHID_ERR("can't write because the device isn't open");
+		return -1;
+	}
+
+	rhid_native_t* native = device->native;
+	unsigned long  bytes  = 0;
+
+	if(native->is_writing) {
+		if(GetOverlappedResult(device->handle, &native->write_overlapped,
+							   &bytes, FALSE) == FALSE) {
+			if(GetLastError() == ERROR_IO_INCOMPLETE) {
+				return 0;
+			}
+
+			RHID_ERR_SYS("failed to write a device report", GetLastError());
+			DEBUG_COUNT("rhid.write_errors", 1);
+		}
+		native->is_writing = 0;
+	}
+
+	// go round the dirty reports so a busy one doesn't starve the others.
+	for(int n = 0; n < native->write_count; n++) {
+		int i = (native->write_next + n) % native->write_count;
+		rhid_write_report_t* report = &native->writes[i];
+		if(report->dirty == 0) {
+			continue;
+		}
+
+		native->write_next = i + 1;
+		report->dirty	   = 0;
+
+		BOOL ret;
+		if(report->type == RHID_REPORT_OUTPUT) {
+			memcpy(native->writing, report->data, native->output_size);
+			ret = WriteFile(device->handle, native->writing,
+							native->output_size, NULL,
+							&native->write_overlapped);
 		}
+		else {
+			memcpy(native->writing, report->data, native->feature_size);
+			ret = DeviceIoControl(device->handle, IOCTL_HID_SET_FEATURE,
+								  native->writing, native->feature_size, NULL,
+								  0, NULL, &native->write_overlapped);
+		}
+
+		if(ret == FALSE && GetLastError() != ERROR_IO_PENDING) {
+			RHID_ERR_SYS("failed to write a device report", GetLastError());
+			DEBUG_COUNT("rhid.write_errors", 1);
+			return -1;
+		}
+
+		// finished or not, the result is collected by the next call.
+		native->is_writing = 1;
+		DEBUG_COUNT("rhid.writes", 1);
+
+		return 1;
 	}
 
 	return 0;
@@ -795,11 +2389,29 @@ int rhid_get_buttons_usage(rhid_device_t* device, uint16_t* usages, int size) {
 int rhid_get_values_usage(rhid_device_t* device, uint16_t* usages, int size) {
 }
 
-int rhid_get_button(rhid_device_t* device, uint16_t usage) {
-	return 0;
+int rhid_get_button(rhid_device_t* device, uint16_t page, uint16_t usage) {
+	if(device->is_open == 0) {
+		return -1;
+	}
+
+	int index = _rhid_lookup_button(device, page, usage);
+	if(index < 0) {
+		return -1;
+	}
+
+	return device->buttons[device->button_descriptors[index].index];
 }
-int rhid_get_value(rhid_device_t* device, uint16_t usage) {
-	return 0;
+int rhid_get_value(rhid_device_t* device, uint16_t page, uint16_t usage) {
+	if(device->is_open == 0) {
+		return -1;
+	}
+
+	int index = _rhid_lookup_value(device, page, usage);
+	if(index < 0) {
+		return -1;
+	}
+
+	return device->values[device->value_descriptors[index].index];
 }
 
 int rhid_get_button_count(rhid_device_t* device) {
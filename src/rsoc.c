@@ -1,10 +1,12 @@
 #include "rsoc.h"
+#include "debug.h"
 
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <errno.h>
 #include <string.h>
+#include <time.h>
 #include <winsock.h>
 
 #ifdef _WIN32
@@ -25,17 +27,19 @@
 #include <netdb.h>
 #include <netinet/in.h>
 #include <sys/ioctl.h>
+#include <sys/select.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <unistd.h>
 
 #endif
 
-#define RSOC_ERR(message) fprintf(stderr, message);
-#define RSOC_ERR_SOCK(message, sockerr)                  \
-	{                                                    \
-		char errmsg[256];                                \
-		strerror_s(errmsg, sizeof(errmsg), sockerr);     \
-		fprintf(stderr, message " error: %s\n", errmsg); \
+#define RSOC_ERR(message) DEBUG_LOG_ERR(message)
+#define RSOC_ERR_SOCK(message, sockerr)               \
+	{                                                 \
+		char errmsg[256];                             \
+		strerror_s(errmsg, sizeof(errmsg), sockerr);  \
+		DEBUG_LOG_ERR(message " error: %s", errmsg); \
 	}
 
 // TODO look into using select(2) and poll(2) functions.
@@ -44,13 +48,34 @@
 
 int rsoc_init() {
 	WSADATA data;
-	if(WSAStartup(0, &data) != 0) {
+	if(WSAStartup(MAKEWORD(2, 2), &data) != 0) {
 		return -1;
 	}
 
 	return 0;
 }
 
+uint64_t rsoc_time_us() {
+#ifdef _WIN32
+	static LARGE_INTEGER freq = {0};
+	LARGE_INTEGER		 count;
+
+	if(freq.QuadPart == 0) {
+		QueryPerformanceFrequency(&freq);
+	}
+	QueryPerformanceCounter(&count);
+
+	return (uint64_t) (count.QuadPart / freq.QuadPart) * 1000000 +
+		   (uint64_t) (count.QuadPart % freq.QuadPart) * 1000000 /
+			   freq.QuadPart;
+#else
+	struct timespec tp;
+	clock_gettime(CLOCK_MONOTONIC, &tp);
+
+	return (uint64_t) tp.tv_sec * 1000000 + tp.tv_nsec / 1000;
+#endif
+}
+
 // FIXME function doesn't work with TCP. See
 // https://linux.die.net/man/2/accept
 static int _rsoc_conn(char* addr, const int addr_size, const int port,
@@ -78,7 +103,7 @@ static int _rsoc_conn(char* addr, const int addr_size, const int port,
 	// get a list of addrinfo structs on the supplied port of this machine.
 	struct addrinfo* info_list;
 	ret = getaddrinfo(addr, port_str, &hints, &info_list);
-	if(ret < 0) {
+	if(ret != 0) {
 		return RSOC_ERR_RESOLV_ADDRINFO;
 	}
 
@@ -103,9 +128,9 @@ static int _rsoc_conn(char* addr, const int addr_size, const int port,
 #else
 				close(sock->fd);
 #endif
+				freeaddrinfo(info_list);
+				return RSOC_ERR_RESOLV_CONN;
 			}
-			freeaddrinfo(info_list);
-			return RSOC_ERR_RESOLV_CONN;
 		}
 		else if(role == RSOC_ROLE_HOST) {
 			// if the socket was created successfully, bind it to the address so
@@ -134,30 +159,33 @@ static int _rsoc_conn(char* addr, const int addr_size, const int port,
 				freeaddrinfo(info_list);
 				return RSOC_ERR_RESOLV_NOBLOCK;
 			}
+		}
 
-			sock->addr.addr = *info_curr->ai_addr;
-			sock->addr_size = info_curr->ai_addrlen;
-			// TODO consider using htons(port) here.
-			sock->port = port;
+		memcpy(&sock->addr, info_curr->ai_addr, info_curr->ai_addrlen);
+		sock->addr_size = info_curr->ai_addrlen;
+		// TODO consider using htons(port) here.
+		sock->port = port;
 
-			sock->family   = info_curr->ai_family;
-			sock->type	   = info_curr->ai_socktype;
-			sock->protocol = info_curr->ai_protocol;
-			sock->role	   = RSOC_ROLE_CLIENT;
+		sock->family   = info_curr->ai_family;
+		sock->type	   = info_curr->ai_socktype;
+		sock->protocol = info_curr->ai_protocol;
+		sock->role	   = role;
 
-			break;
-		}
+		break;
 	} while(info_curr != NULL);
 
-	return 0;
-}
+	freeaddrinfo(info_list);
 
-// CLIENT FUNCTIONS
+	if(info_curr == NULL) {
+		return role == RSOC_ROLE_HOST ? RSOC_ERR_HOST_BIND
+									  : RSOC_ERR_RESOLV_CONN;
+	}
 
-int rsoc_resolve_mdns(char* addr, const int addr_size, rsoc_socket_t* socket) {
 	return 0;
 }
 
+// CLIENT FUNCTIONS
+
 int rsoc_resolve_ip(char* addr, const int addr_size, const int port,
 					rsoc_socket_t* sock) {
 	int ret = _rsoc_conn(addr, addr_size, port, sock, RSOC_ROLE_CLIENT);
@@ -179,9 +207,64 @@ int rsoc_host(const int port, rsoc_socket_t* sock) {
 	return 0;
 }
 
-int rsoc_host_mdns(char* addr, const int addr_size, const int port,
-				   rsoc_socket_t* sock) {
-	return -1;
+// STATS HELPERS
+
+// Closes the current stats window and works out the rates and loss over it.
+static void _rsoc_stats_window(rsoc_socket_t* sock, uint64_t now) {
+	struct rsoc_stats_state_t* state = &sock->stats_state;
+	rsoc_stats_t*			   stats = &sock->stats;
+
+	if(state->window_us != 0 && now > state->window_us) {
+		double seconds = (now - state->window_us) / 1000000.0;
+
+		stats->send_rate = (stats->bytes_sent - state->bytes_sent) / seconds;
+		stats->receive_rate =
+			(stats->bytes_received - state->bytes_received) / seconds;
+
+		uint64_t lost	  = stats->packets_lost - state->packets_lost;
+		uint64_t received = stats->packets_received - state->packets_received;
+		stats->loss = lost + received > 0 ? (double) lost / (lost + received)
+										  : 0.0;
+	}
+
+	state->window_us		= now;
+	state->bytes_sent		= stats->bytes_sent;
+	state->bytes_received	= stats->bytes_received;
+	state->packets_received = stats->packets_received;
+	state->packets_lost		= stats->packets_lost;
+}
+
+static int _rsoc_stats_queue(rsoc_socket_t* sock) {
+#ifdef _WIN32
+	u_long queue = 0;
+	if(ioctlsocket(sock->fd, FIONREAD, &queue) != 0) {
+		return -1;
+	}
+#else
+	int queue = 0;
+	if(ioctl(sock->fd, FIONREAD, &queue) != 0) {
+		return -1;
+	}
+#endif
+
+	return (int) queue;
+}
+
+static void _rsoc_stats_tick(rsoc_socket_t* sock) {
+	struct rsoc_stats_state_t* state = &sock->stats_state;
+	if(state->event == NULL) {
+		return;
+	}
+
+	uint64_t now = rsoc_time_us();
+	if(now - state->window_us < state->period_us) {
+		return;
+	}
+
+	_rsoc_stats_window(sock, now);
+	sock->stats.receive_queue = _rsoc_stats_queue(sock);
+
+	state->event(sock, &sock->stats);
 }
 
 // GENERIC FUNCTIONS
@@ -210,12 +293,34 @@ int rsoc_send(rsoc_socket_t* sock, uint8_t* data, const int data_size) {
 	// error out if nothing was sent or an error occured.
 	if(send_size <= 0) {
 		RSOC_ERR_SOCK("didn't send any data in rsoc_send", errno);
+		sock->stats.send_errors++;
+		DEBUG_COUNT("rsoc.send_errors", 1);
+		_rsoc_stats_tick(sock);
 		return -1;
 	}
 
+	sock->stats.bytes_sent += send_size;
+	sock->stats.packets_sent++;
+	_rsoc_stats_tick(sock);
+	DEBUG_COUNT("rsoc.packets_sent", 1);
+	DEBUG_HIST("rsoc.send_bytes", send_size);
+
 	return send_size;
 }
 
+// Windows fills the buffer with the start of a datagram that doesn't fit and
+// then fails with WSAEMSGSIZE, everywhere else it is just cut off. Treat both
+// the same.
+static int _rsoc_truncated(int recv_size, const int data_size) {
+#ifdef _WIN32
+	if(recv_size < 0 && WSAGetLastError() == WSAEMSGSIZE) {
+		return data_size;
+	}
+#endif
+
+	return recv_size;
+}
+
 static int rsoc_receivefrom(rsoc_socket_t* sock, uint8_t* data,
 							const int data_size, int flags) {
 	if(sock->role == RSOC_ROLE_NONE) {
@@ -230,12 +335,15 @@ static int rsoc_receivefrom(rsoc_socket_t* sock, uint8_t* data,
 
 		recv_size = recvfrom(sock->fd, (char*) data, data_size, flags,
 							 (struct sockaddr*) &addr, (socklen_t*) &addr_size);
+		recv_size = _rsoc_truncated(recv_size, data_size);
 		// recv_size = recvfrom(sock->fd, data, data_size, 0, NULL, NULL);
 
 		if(recv_size <= 0) {
 			RSOC_ERR_SOCK(
 				"didn't recieve any data as host when calling rsoc_receive",
 				errno);
+			sock->stats.receive_errors++;
+			DEBUG_COUNT("rsoc.receive_errors", 1);
 			return -1;
 		}
 
@@ -255,15 +363,27 @@ static int rsoc_receivefrom(rsoc_socket_t* sock, uint8_t* data,
 	else if(sock->role == RSOC_ROLE_CLIENT) {
 		// receive data from whatever host we're connected to.
 		recv_size = recv(sock->fd, (char*) data, data_size, flags);
+		recv_size = _rsoc_truncated(recv_size, data_size);
 
 		if(recv_size <= 0) {
 			RSOC_ERR_SOCK(
 				"didn't recieve any data as client when calling rsoc_receive",
 				errno);
+			sock->stats.receive_errors++;
+			DEBUG_COUNT("rsoc.receive_errors", 1);
 			return -1;
 		}
 	}
 
+	// peeked data will be received again, don't count it twice.
+	if((flags & MSG_PEEK) == 0) {
+		sock->stats.bytes_received += recv_size;
+		sock->stats.packets_received++;
+		_rsoc_stats_tick(sock);
+		DEBUG_COUNT("rsoc.packets_received", 1);
+		DEBUG_HIST("rsoc.receive_bytes", recv_size);
+	}
+
 	return recv_size;
 }
 
@@ -275,6 +395,28 @@ int rsoc_peek(rsoc_socket_t* sock, uint8_t* data, const int data_size) {
 	return rsoc_receivefrom(sock, data, data_size, MSG_PEEK);
 }
 
+int rsoc_poll(rsoc_socket_t* sock, const int timeout_ms) {
+	if(sock->role == RSOC_ROLE_NONE) {
+		return -1;
+	}
+
+	fd_set fds;
+	FD_ZERO(&fds);
+	FD_SET(sock->fd, &fds);
+
+	struct timeval timeout = {0};
+	timeout.tv_sec		   = timeout_ms / 1000;
+	timeout.tv_usec		   = (timeout_ms % 1000) * 1000;
+
+	int ret = select(sock->fd + 1, &fds, NULL, NULL, &timeout);
+	if(ret < 0) {
+		RSOC_ERR_SOCK("failed to wait for data in rsoc_poll", errno);
+		return -1;
+	}
+
+	return ret > 0 ? 1 : 0;
+}
+
 int rsoc_close(rsoc_socket_t* sock) {
 #ifdef _WIN32
 	int ret = closesocket(sock->fd);
@@ -286,6 +428,574 @@ int rsoc_close(rsoc_socket_t* sock) {
 	}
 
 	sock->role = RSOC_ROLE_NONE;
+	rsoc_sched_free(sock);
 
 	return 0;
 }
+
+// RING FUNCTIONS
+
+enum rsoc_ring_state_t {
+	RSOC_RING_FREE = 0,
+	RSOC_RING_FILLED,
+	RSOC_RING_HELD,
+};
+
+int rsoc_ring_init(rsoc_ring_t* ring, const int count, const int packet_size) {
+	// head and tail wrap around at 2^32, which only lands back on slot 0 when
+	// count divides it.
+	if(ring == NULL || count <= 0 || (count & (count - 1)) != 0 ||
+	   packet_size <= 0) {
+		return -1;
+	}
+
+	memset(ring, 0, sizeof(rsoc_ring_t));
+
+	// one block for all the packet data so the pool is contiguous.
+	ring->buffer  = malloc((size_t) count * packet_size);
+	ring->packets = calloc(count, sizeof(rsoc_packet_t));
+	ring->states  = calloc(count, sizeof(atomic_int));
+	if(ring->buffer == NULL || ring->packets == NULL || ring->states == NULL) {
+		rsoc_ring_free(ring);
+		return -1;
+	}
+
+	ring->count		  = count;
+	ring->packet_size = packet_size;
+
+	for(int i = 0; i < count; i++) {
+		ring->packets[i].data = ring->buffer + (size_t) i * packet_size;
+		atomic_init(&ring->states[i], RSOC_RING_FREE);
+	}
+
+	return 0;
+}
+
+int rsoc_ring_receive(rsoc_socket_t* sock, rsoc_ring_t* ring,
+					  const int timeout_ms) {
+	int received = 0;
+
+	while(1) {
+		int			   slot	  = ring->head % ring->count;
+		rsoc_packet_t* packet = &ring->packets[slot];
+
+		// the ring is full. leave the rest in the socket buffer.
+		if(atomic_load_explicit(&ring->states[slot], memory_order_acquire) !=
+		   RSOC_RING_FREE) {
+			break;
+		}
+
+		int ret = rsoc_poll(sock, received == 0 ? timeout_ms : 0);
+		if(ret <= 0) {
+			if(ret < 0 && received == 0) {
+				return -1;
+			}
+			break;
+		}
+
+		// the datagram goes from the socket straight into the pool buffer.
+		int size = rsoc_receivefrom(sock, packet->data, ring->packet_size, 0);
+		if(size < 0) {
+			if(received == 0) {
+				return -1;
+			}
+			break;
+		}
+
+		packet->size	  = size;
+		packet->time_us	  = rsoc_time_us();
+		packet->addr_size = sock->addr_size;
+		memcpy(&packet->addr, &sock->addr, sock->addr_size);
+
+		atomic_store_explicit(&ring->states[slot], RSOC_RING_FILLED,
+							  memory_order_release);
+		ring->head++;
+		received++;
+	}
+
+	return received;
+}
+
+rsoc_packet_t* rsoc_ring_acquire(rsoc_ring_t* ring) {
+	int slot = ring->tail % ring->count;
+
+	if(atomic_load_explicit(&ring->states[slot], memory_order_acquire) !=
+	   RSOC_RING_FILLED) {
+		return NULL;
+	}
+
+	atomic_store_explicit(&ring->states[slot], RSOC_RING_HELD,
+						  memory_order_relaxed);
+	ring->tail++;
+
+	return &ring->packets[slot];
+}
+
+void rsoc_ring_release(rsoc_ring_t* ring, rsoc_packet_t* packet) {
+	int slot = packet - ring->packets;
+	if(slot < 0 || slot >= ring->count) {
+		return;
+	}
+
+	atomic_store_explicit(&ring->states[slot], RSOC_RING_FREE,
+						  memory_order_release);
+}
+
+int rsoc_ring_count(rsoc_ring_t* ring) {
+	int count = 0;
+	for(; count < ring->count; count++) {
+		// the count is a power of two, so this holds as the tail wraps.
+		unsigned int i = (ring->tail + count) % ring->count;
+		if(atomic_load_explicit(&ring->states[i], memory_order_acquire) !=
+		   RSOC_RING_FILLED) {
+			break;
+		}
+	}
+
+	return count;
+}
+
+void rsoc_ring_free(rsoc_ring_t* ring) {
+	free(ring->buffer);
+	free(ring->packets);
+	free((void*) ring->states);
+
+	memset(ring, 0, sizeof(rsoc_ring_t));
+}
+
+// SCHEDULER FUNCTIONS
+
+// udp and ip headers, charged to the buckets with every datagram.
+#define RSOC_SCHED_OVERHEAD 28
+
+static int _rsoc_sched_alloc(rsoc_sched_t*			   sched,
+							 struct rsoc_sched_class_t* cls, const int count) {
+	// the old queue stays in place until the new one is ready.
+	uint8_t*	   buffer  = malloc((size_t) count * sched->packet_size);
+	rsoc_packet_t* packets = calloc(count, sizeof(rsoc_packet_t));
+	if(buffer == NULL || packets == NULL) {
+		free(buffer);
+		free(packets);
+		return RSOC_ERR_SCHED_ALLOC;
+	}
+
+	for(int i = 0; i < count; i++) {
+		packets[i].data = buffer + (size_t) i * sched->packet_size;
+	}
+
+	free(cls->buffer);
+	free(cls->packets);
+	cls->buffer	 = buffer;
+	cls->packets = packets;
+	cls->count	 = count;
+	cls->head	 = 0;
+	cls->queued	 = 0;
+
+	return 0;
+}
+
+static void _rsoc_sched_refill(rsoc_socket_t* sock, uint64_t now) {
+	rsoc_sched_t* sched = &sock->sched;
+	double		  dt	= (double) (now - sched->refill_us) / 1e6;
+	sched->refill_us	= now;
+
+	if(sched->link_bps > 0) {
+		sched->tokens += dt * sched->link_bps / 8.0;
+		if(sched->tokens > sched->burst) {
+			sched->tokens = sched->burst;
+		}
+	}
+
+	// rsoc_send traffic went out ahead of every class, it still used up the
+	// link.
+	sched->tokens -= (double) (sock->stats.bytes_sent - sched->bytes_charged);
+	sched->bytes_charged = sock->stats.bytes_sent;
+
+	for(int i = 0; i < RSOC_CLASS_COUNT; i++) {
+		struct rsoc_sched_class_t* cls = &sched->classes[i];
+		if(cls->rate_bps == 0) {
+			continue;
+		}
+
+		cls->tokens += dt * cls->rate_bps / 8.0;
+		if(cls->tokens > cls->burst) {
+			cls->tokens = cls->burst;
+		}
+	}
+}
+
+static int _rsoc_sched_link_ready(rsoc_sched_t* sched) {
+	return sched->link_bps == 0 || sched->tokens > 0;
+}
+
+static int _rsoc_sched_class_ready(struct rsoc_sched_class_t* cls) {
+	return cls->rate_bps == 0 || cls->tokens > 0;
+}
+
+static int _rsoc_sched_write(rsoc_socket_t*			   sock,
+							 struct rsoc_sched_class_t* cls, uint8_t* data,
+							 const int data_size) {
+	rsoc_sched_t* sched = &sock->sched;
+
+	int ret = rsoc_send(sock, data, data_size);
+	if(ret < 0) {
+		return RSOC_ERR_SCHED_SEND;
+	}
+
+	sched->tokens -= ret + RSOC_SCHED_OVERHEAD;
+	sched->bytes_charged = sock->stats.bytes_sent;
+	if(cls->rate_bps > 0) {
+		cls->tokens -= ret + RSOC_SCHED_OVERHEAD;
+	}
+	cls->sent++;
+
+	return ret;
+}
+
+int rsoc_sched_init(rsoc_socket_t* sock, const uint64_t link_bps,
+					const int packet_size) {
+	if(sock == NULL) {
+		return RSOC_ERR_SCHED_NULL;
+	}
+	if(packet_size <= 0) {
+		return RSOC_ERR_SCHED_SIZE;
+	}
+
+	rsoc_sched_free(sock);
+
+	rsoc_sched_t* sched	 = &sock->sched;
+	sched->packet_size	 = packet_size;
+	sched->link_bps		 = link_bps;
+	sched->burst		 = 4 * (packet_size + RSOC_SCHED_OVERHEAD);
+	sched->tokens		 = sched->burst;
+	sched->refill_us	 = rsoc_time_us();
+	sched->bytes_charged = sock->stats.bytes_sent;
+
+	for(int i = 0; i < RSOC_CLASS_COUNT; i++) {
+		struct rsoc_sched_class_t* cls = &sched->classes[i];
+		cls->burst					   = sched->burst;
+
+		if(_rsoc_sched_alloc(sched, cls, RSOC_SCHED_QUEUE_DEFAULT) < 0) {
+			rsoc_sched_free(sock);
+			return RSOC_ERR_SCHED_ALLOC;
+		}
+	}
+
+	// failing to shrink the kernel buffer only costs latency, keep going.
+	int sndbuf = RSOC_SCHED_SNDBUF;
+	setsockopt(sock->fd, SOL_SOCKET, SO_SNDBUF, (const char*) &sndbuf,
+			   sizeof(sndbuf));
+
+	sched->enabled = 1;
+
+	return 0;
+}
+
+int rsoc_sched_class(rsoc_socket_t*			 sock,
+					 const enum rsoc_class_t sched_class,
+					 const uint64_t rate_bps, const int burst,
+					 const int queue_count) {
+	if(sock == NULL || sock->sched.enabled == 0) {
+		return RSOC_ERR_SCHED_NULL;
+	}
+	if(sched_class < 0 || sched_class >= RSOC_CLASS_COUNT) {
+		return RSOC_ERR_SCHED_CLASS;
+	}
+	if(queue_count <= 0) {
+		return RSOC_ERR_SCHED_SIZE;
+	}
+
+	struct rsoc_sched_class_t* cls = &sock->sched.classes[sched_class];
+
+	sock->stats.send_queue -= cls->queued;
+	sock->stats.send_dropped += cls->queued;
+	cls->dropped += cls->queued;
+
+	cls->rate_bps = rate_bps;
+	cls->burst	  = burst > 0 ? burst : sock->sched.burst;
+	cls->tokens	  = cls->burst;
+
+	cls->head	= 0;
+	cls->queued = 0;
+
+	if(queue_count != cls->count) {
+		return _rsoc_sched_alloc(&sock->sched, cls, queue_count);
+	}
+
+	return 0;
+}
+
+int rsoc_sched_send(rsoc_socket_t*			sock,
+					const enum rsoc_class_t sched_class, const uint8_t* data,
+					const int data_size) {
+	if(sock == NULL || sock->sched.enabled == 0) {
+		return RSOC_ERR_SCHED_NULL;
+	}
+	if(sched_class < 0 || sched_class >= RSOC_CLASS_COUNT) {
+		return RSOC_ERR_SCHED_CLASS;
+	}
+	if(data == NULL || data_size <= 0 ||
+	   data_size > sock->sched.packet_size) {
+		return RSOC_ERR_SCHED_SIZE;
+	}
+
+	rsoc_sched_t*			   sched = &sock->sched;
+	struct rsoc_sched_class_t* cls	 = &sched->classes[sched_class];
+	if(cls->count == 0) {
+		return RSOC_ERR_SCHED_ALLOC;
+	}
+
+	// let whatever is waiting go first so the order within the class holds.
+	rsoc_sched_update(sock);
+
+	// a higher class only goes first while it has tokens, one waiting on its
+	// own rate limit doesn't hold the classes below it back.
+	int waiting = cls->queued;
+	for(int i = 0; i < sched_class; i++) {
+		if(_rsoc_sched_class_ready(&sched->classes[i])) {
+			waiting += sched->classes[i].queued;
+		}
+	}
+
+	if(waiting == 0 && _rsoc_sched_link_ready(sched) &&
+	   _rsoc_sched_class_ready(cls)) {
+		return _rsoc_sched_write(sock, cls, (uint8_t*) data, data_size);
+	}
+
+	// a full queue makes room by dropping its oldest datagram, the newest
+	// state is worth more than a stale one.
+	if(cls->queued == cls->count) {
+		cls->head = (cls->head + 1) % cls->count;
+		cls->queued--;
+		cls->dropped++;
+		sock->stats.send_queue--;
+		sock->stats.send_dropped++;
+	}
+
+	rsoc_packet_t* packet =
+		&cls->packets[(cls->head + cls->queued) % cls->count];
+	memcpy(packet->data, data, data_size);
+	packet->size	= data_size;
+	packet->time_us = rsoc_time_us();
+
+	cls->queued++;
+	sock->stats.send_queue++;
+
+	return 0;
+}
+
+int rsoc_sched_update(rsoc_socket_t* sock) {
+	if(sock == NULL || sock->sched.enabled == 0) {
+		return RSOC_ERR_SCHED_NULL;
+	}
+
+	rsoc_sched_t* sched = &sock->sched;
+	_rsoc_sched_refill(sock, rsoc_time_us());
+
+	// strict priority. a class that hit its own rate limit lets the classes
+	// below it use the rest of the link.
+	int sent = 0;
+	for(int i = 0; i < RSOC_CLASS_COUNT; i++) {
+		struct rsoc_sched_class_t* cls = &sched->classes[i];
+		// out of tokens, the classes below get the link until it refills.
+		if(cls->count == 0 || _rsoc_sched_class_ready(cls) == 0) {
+			continue;
+		}
+
+		while(cls->queued > 0 && _rsoc_sched_class_ready(cls)) {
+			if(_rsoc_sched_link_ready(sched) == 0) {
+				return sent;
+			}
+
+			rsoc_packet_t* packet = &cls->packets[cls->head];
+			cls->head			  = (cls->head + 1) % cls->count;
+			cls->queued--;
+			sock->stats.send_queue--;
+
+			if(_rsoc_sched_write(sock, cls, packet->data, packet->size) < 0) {
+				return sent > 0 ? sent : RSOC_ERR_SCHED_SEND;
+			}
+			sent++;
+		}
+	}
+
+	return sent;
+}
+
+int rsoc_sched_pending(rsoc_socket_t*		   sock,
+					   const enum rsoc_class_t sched_class) {
+	if(sock == NULL || sock->sched.enabled == 0) {
+		return RSOC_ERR_SCHED_NULL;
+	}
+	if(sched_class < 0 || sched_class >= RSOC_CLASS_COUNT) {
+		return RSOC_ERR_SCHED_CLASS;
+	}
+
+	return sock->sched.classes[sched_class].queued;
+}
+
+void rsoc_sched_free(rsoc_socket_t* sock) {
+	if(sock == NULL) {
+		return;
+	}
+
+	for(int i = 0; i < RSOC_CLASS_COUNT; i++) {
+		free(sock->sched.classes[i].buffer);
+		free(sock->sched.classes[i].packets);
+	}
+
+	sock->stats.send_queue = 0;
+	memset(&sock->sched, 0, sizeof(rsoc_sched_t));
+}
+
+// STATS FUNCTIONS
+
+int rsoc_get_stats(rsoc_socket_t* sock, rsoc_stats_t* stats) {
+	if(sock == NULL || stats == NULL) {
+		return -1;
+	}
+
+	// without a period, the rates cover the time since the last call.
+	if(sock->stats_state.event == NULL) {
+		_rsoc_stats_window(sock, rsoc_time_us());
+	}
+
+	sock->stats.receive_queue =
+		sock->role == RSOC_ROLE_NONE ? 0 : _rsoc_stats_queue(sock);
+
+	*stats = sock->stats;
+
+	return 0;
+}
+
+int rsoc_on_stats(rsoc_socket_t* sock, rsoc_stats_evnt_t event,
+				  const int period_ms) {
+	if(sock == NULL || (event != NULL && period_ms <= 0)) {
+		return -1;
+	}
+
+	sock->stats_state.event		= event;
+	sock->stats_state.period_us = (uint64_t) period_ms * 1000;
+	_rsoc_stats_window(sock, rsoc_time_us());
+
+	return 0;
+}
+
+int rsoc_stats_update(rsoc_socket_t* sock) {
+	if(sock == NULL) {
+		return -1;
+	}
+
+	_rsoc_stats_tick(sock);
+
+	return 0;
+}
+
+void rsoc_stats_seq(rsoc_socket_t* sock, const uint16_t seq) {
+	struct rsoc_stats_state_t* state = &sock->stats_state;
+	rsoc_stats_t*			   stats = &sock->stats;
+
+	if(state->has_seq == 0) {
+		state->has_seq	= 1;
+		state->seq		= seq;
+		state->seq_bits = 0;
+		return;
+	}
+
+	// seq_bits remembers which of the 32 sequences before the newest one
+	// arrived so late packets can be told apart from duplicates.
+	uint16_t ahead = seq - state->seq;
+	if(ahead != 0 && ahead < 32768) {
+		stats->packets_lost += ahead - 1;
+
+		state->seq_bits = ahead >= 32 ? 0 : state->seq_bits << ahead;
+		if(ahead <= 32) {
+			state->seq_bits |= 1u << (ahead - 1);
+		}
+		state->seq = seq;
+		return;
+	}
+
+	// anything older than the 32 remembered sequences can't be told apart
+	// from a duplicate, so it's counted as one instead of undoing a loss.
+	uint16_t behind = state->seq - seq;
+	if(behind == 0 || behind > 32 || state->seq_bits & (1u << (behind - 1))) {
+		stats->packets_duplicated++;
+		return;
+	}
+
+	// a late packet we had already counted as lost.
+	stats->packets_reordered++;
+	if(stats->packets_lost > 0) {
+		stats->packets_lost--;
+	}
+	state->seq_bits |= 1u << (behind - 1);
+}
+
+void rsoc_stats_rtt(rsoc_socket_t* sock, const uint64_t rtt_us) {
+	struct rsoc_stats_state_t* state = &sock->stats_state;
+	rsoc_stats_t*			   stats = &sock->stats;
+
+	if(state->has_rtt == 0) {
+		state->has_rtt	   = 1;
+		state->rtt_prev_us = rtt_us;
+		stats->rtt_us	   = rtt_us;
+		stats->jitter_us   = 0;
+		return;
+	}
+
+	// D is the difference to the previous sample, not to the smoothed rtt.
+	uint64_t delta = state->rtt_prev_us > rtt_us ? state->rtt_prev_us - rtt_us
+												 : rtt_us - state->rtt_prev_us;
+	state->rtt_prev_us = rtt_us;
+
+	// jitter += (|D| - jitter) / 16 and rtt += (sample - rtt) / 8.
+	stats->jitter_us = (15 * stats->jitter_us + delta) / 16;
+	stats->rtt_us	 = (7 * stats->rtt_us + rtt_us) / 8;
+}
+
+// METRICS FUNCTIONS
+
+int rsoc_send_metrics(rsoc_socket_t* sock) {
+	debug_metrics_t* snapshot = malloc(sizeof(debug_metrics_t));
+	char*			 text	  = malloc(DEBUG_METRICS_TEXT_MAX);
+	if(snapshot == NULL || text == NULL) {
+		free(snapshot);
+		free(text);
+		return -1;
+	}
+
+	debug_metrics_snapshot(snapshot);
+	int length = debug_metrics_format(snapshot, text, DEBUG_METRICS_TEXT_MAX);
+
+	int sent  = 0;
+	int start = 0;
+	while(start < length) {
+		// take as many whole lines as fit in a datagram.
+		int end = start;
+		for(int i = start; i < length && i - start < RSOC_METRICS_PACKET; i++) {
+			if(text[i] == '\n') {
+				end = i + 1;
+			}
+		}
+		// a line longer than a datagram gets cut.
+		if(end == start) {
+			end = start + RSOC_METRICS_PACKET < length
+					  ? start + RSOC_METRICS_PACKET
+					  : length;
+		}
+
+		if(rsoc_send(sock, (uint8_t*) text + start, end - start) < 0) {
+			sent = -1;
+			break;
+		}
+
+		sent++;
+		start = end;
+	}
+
+	free(snapshot);
+	free(text);
+
+	return sent;
+}
@@ -0,0 +1,489 @@
+#include "rsoc_chan.h"
+
+#include "rsoc.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Packet layout, all fields in network byte order:
+//
+//  0  u8  magic
+//  1  u8  channel in the low 7 bits, RSOC_CHAN_ACK_ONLY for a bare ack. the
+//         top bit is set once the ack fields are valid.
+//  2  u16 packet sequence
+//  4  u16 newest packet sequence received from the peer
+//  6  u32 ack bits, bit n acks (ack - 1 - n)
+// 10  u16 message sequence (sequenced and reliable channels)
+// 12      payload
+
+#define RSOC_CHAN_MAGIC 0x52
+#define RSOC_CHAN_ACK_ONLY 0x7F
+#define RSOC_CHAN_FLAG_ACK 0x80
+#define RSOC_CHAN_RTO_INITIAL_US 100000
+// retries stop doubling the timeout after this many resends.
+#define RSOC_CHAN_BACKOFF_MAX 4
+
+static void _rsoc_chan_write_u16(uint8_t* data, uint16_t value) {
+	data[0] = value >> 8;
+	data[1] = value & 0xFF;
+}
+
+static void _rsoc_chan_write_u32(uint8_t* data, uint32_t value) {
+	data[0] = value >> 24;
+	data[1] = (value >> 16) & 0xFF;
+	data[2] = (value >> 8) & 0xFF;
+	data[3] = value & 0xFF;
+}
+
+static uint16_t _rsoc_chan_read_u16(const uint8_t* data) {
+	return (uint16_t) (data[0] << 8 | data[1]);
+}
+
+static uint32_t _rsoc_chan_read_u32(const uint8_t* data) {
+	return (uint32_t) data[0] << 24 | (uint32_t) data[1] << 16 |
+		   (uint32_t) data[2] << 8 | data[3];
+}
+
+// Is sequence a newer than b, taking wrap around into account.
+static int _rsoc_chan_seq_gt(uint16_t a, uint16_t b) {
+	return ((a > b) && (a - b <= 32768)) || ((a < b) && (b - a > 32768));
+}
+
+static int _rsoc_chan_send_packet(rsoc_chan_conn_t* conn, const int channel,
+								  const uint16_t msg_seq, const int reliable,
+								  const uint8_t* data, const int data_size) {
+	uint8_t packet[RSOC_CHAN_PACKET_MAX];
+
+	packet[0] = RSOC_CHAN_MAGIC;
+	packet[1] = channel | (conn->has_remote ? RSOC_CHAN_FLAG_ACK : 0);
+	_rsoc_chan_write_u16(packet + 2, conn->local_seq);
+	_rsoc_chan_write_u16(packet + 4, conn->remote_seq);
+	_rsoc_chan_write_u32(packet + 6, conn->ack_bits);
+	_rsoc_chan_write_u16(packet + 10, msg_seq);
+
+	if(data_size > 0) {
+		memcpy(packet + RSOC_CHAN_HEADER_SIZE, data, data_size);
+	}
+
+	if(rsoc_send(conn->sock, packet, RSOC_CHAN_HEADER_SIZE + data_size) < 0) {
+		return RSOC_ERR_CHAN_SOCK;
+	}
+
+	uint64_t now = rsoc_time_us();
+
+	// remember the packet so the ack can be matched to it later.
+	struct rsoc_chan_sent_t* sent =
+		&conn->sent[conn->local_seq & (RSOC_CHAN_SENT_COUNT - 1)];
+	sent->in_use  = 1;
+	sent->acked	  = 0;
+	sent->seq	  = conn->local_seq;
+	sent->sent_us = now;
+	sent->channel = reliable ? channel : -1;
+	sent->msg_seq = msg_seq;
+
+	conn->local_seq++;
+	conn->ack_pending  = 0;
+	conn->last_send_us = now;
+
+	return 0;
+}
+
+static void _rsoc_chan_rtt_sample(rsoc_chan_conn_t* conn, uint64_t rtt_us) {
+	if(conn->srtt_us == 0) {
+		conn->srtt_us	= rtt_us;
+		conn->rttvar_us = rtt_us / 2;
+	}
+	else {
+		uint64_t delta	= conn->srtt_us > rtt_us ? conn->srtt_us - rtt_us
+												 : rtt_us - conn->srtt_us;
+		conn->rttvar_us = (3 * conn->rttvar_us + delta) / 4;
+		conn->srtt_us	= (7 * conn->srtt_us + rtt_us) / 8;
+	}
+
+	conn->rto_us = conn->srtt_us + 4 * conn->rttvar_us;
+	if(conn->rto_us < RSOC_CHAN_RTO_MIN_US) {
+		conn->rto_us = RSOC_CHAN_RTO_MIN_US;
+	}
+	if(conn->rto_us > RSOC_CHAN_RTO_MAX_US) {
+		conn->rto_us = RSOC_CHAN_RTO_MAX_US;
+	}
+}
+
+static void _rsoc_chan_on_ack(rsoc_chan_conn_t* conn, uint16_t seq,
+							  uint64_t now) {
+	struct rsoc_chan_sent_t* sent =
+		&conn->sent[seq & (RSOC_CHAN_SENT_COUNT - 1)];
+	if(sent->in_use == 0 || sent->acked || sent->seq != seq) {
+		return;
+	}
+
+	sent->acked = 1;
+	_rsoc_chan_rtt_sample(conn, now - sent->sent_us);
+	rsoc_stats_rtt(conn->sock, now - sent->sent_us);
+
+	if(sent->channel < 0) {
+		return;
+	}
+
+	// the packet carried a reliable message. it arrived so stop resending it.
+	struct rsoc_chan_message_t* message =
+		&conn->channels[sent->channel]
+			 .send_window[sent->msg_seq & (RSOC_CHAN_WINDOW - 1)];
+	if(message->in_use && message->seq == sent->msg_seq) {
+		message->in_use = 0;
+	}
+}
+
+// Marks seq as received so it gets acked in the next packet we send.
+static void _rsoc_chan_on_remote_seq(rsoc_chan_conn_t* conn, uint16_t seq) {
+	if(conn->has_remote == 0) {
+		conn->has_remote = 1;
+		conn->remote_seq = seq;
+		conn->ack_bits	 = 0;
+		return;
+	}
+
+	if(_rsoc_chan_seq_gt(seq, conn->remote_seq)) {
+		uint16_t shift = seq - conn->remote_seq;
+
+		// slide the window forward. the old newest sequence becomes bit
+		// shift - 1.
+		conn->ack_bits = shift >= 32 ? 0 : conn->ack_bits << shift;
+		if(shift <= 32) {
+			conn->ack_bits |= 1u << (shift - 1);
+		}
+		conn->remote_seq = seq;
+	}
+	else {
+		uint16_t diff = conn->remote_seq - seq;
+		if(diff >= 1 && diff <= 32) {
+			conn->ack_bits |= 1u << (diff - 1);
+		}
+	}
+}
+
+int rsoc_chan_init(rsoc_chan_conn_t* conn, rsoc_socket_t* sock) {
+	if(conn == NULL || sock == NULL) {
+		return RSOC_ERR_CHAN_NULCONN;
+	}
+
+	memset(conn, 0, sizeof(rsoc_chan_conn_t));
+	conn->sock	 = sock;
+	conn->rto_us = RSOC_CHAN_RTO_INITIAL_US;
+
+	return 0;
+}
+
+int rsoc_chan_add(rsoc_chan_conn_t* conn, enum rsoc_chan_type_t type) {
+	if(conn == NULL || conn->sock == NULL) {
+		return RSOC_ERR_CHAN_NULCONN;
+	}
+
+	if(conn->channel_count >= RSOC_CHAN_COUNT ||
+	   (type != RSOC_CHAN_UNRELIABLE && type != RSOC_CHAN_SEQUENCED &&
+		type != RSOC_CHAN_RELIABLE)) {
+		return RSOC_ERR_CHAN_INVALID;
+	}
+
+	struct rsoc_chan_t* chan = &conn->channels[conn->channel_count];
+	memset(chan, 0, sizeof(struct rsoc_chan_t));
+	chan->type = type;
+
+	// only reliable channels keep messages around. allocate their windows
+	// once here so sending and receiving never allocates.
+	if(type == RSOC_CHAN_RELIABLE) {
+		chan->send_window =
+			calloc(RSOC_CHAN_WINDOW, sizeof(struct rsoc_chan_message_t));
+		chan->recv_window =
+			calloc(RSOC_CHAN_WINDOW, sizeof(struct rsoc_chan_message_t));
+
+		if(chan->send_window == NULL || chan->recv_window == NULL) {
+			free(chan->send_window);
+			free(chan->recv_window);
+			chan->send_window = NULL;
+			chan->recv_window = NULL;
+			return RSOC_ERR_CHAN_ALLOC;
+		}
+	}
+
+	return conn->channel_count++;
+}
+
+int rsoc_chan_send(rsoc_chan_conn_t* conn, const int channel,
+				   const uint8_t* data, const int data_size) {
+	if(conn == NULL || conn->sock == NULL) {
+		return RSOC_ERR_CHAN_NULCONN;
+	}
+
+	if(channel < 0 || channel >= conn->channel_count) {
+		return RSOC_ERR_CHAN_INVALID;
+	}
+
+	if(data_size < 0 || data_size > RSOC_CHAN_MESSAGE_MAX) {
+		return RSOC_ERR_CHAN_SIZE;
+	}
+
+	struct rsoc_chan_t* chan = &conn->channels[channel];
+
+	switch(chan->type) {
+		case RSOC_CHAN_UNRELIABLE:
+			return _rsoc_chan_send_packet(conn, channel, 0, 0, data,
+										  data_size);
+
+		case RSOC_CHAN_SEQUENCED:
+			return _rsoc_chan_send_packet(conn, channel, chan->send_seq++, 0,
+										  data, data_size);
+
+		case RSOC_CHAN_RELIABLE: {
+			// a slot is only reused once the message WINDOW sequences ago has
+			// been acked. this also keeps the peer's reorder window big
+			// enough.
+			struct rsoc_chan_message_t* message =
+				&chan->send_window[chan->send_seq & (RSOC_CHAN_WINDOW - 1)];
+			if(message->in_use) {
+				return RSOC_ERR_CHAN_FULL;
+			}
+
+			message->in_use	 = 1;
+			message->seq	 = chan->send_seq++;
+			message->size	 = data_size;
+			message->retries = 0;
+			memcpy(message->data, data, data_size);
+
+			message->sent_us = rsoc_time_us();
+
+			int ret = _rsoc_chan_send_packet(conn, channel, message->seq, 1,
+											 data, data_size);
+
+			// the message is queued either way. if the send failed it just
+			// goes out again when it times out.
+			return ret == RSOC_ERR_CHAN_SOCK ? 0 : ret;
+		}
+	}
+
+	return RSOC_ERR_CHAN_INVALID;
+}
+
+// Delivers the next in-order message sitting in a reliable receive window.
+static int _rsoc_chan_deliver_buffered(rsoc_chan_conn_t* conn, int* channel,
+									   uint8_t* data, const int data_size) {
+	for(int i = 0; i < conn->channel_count; i++) {
+		struct rsoc_chan_t* chan = &conn->channels[i];
+		if(chan->type != RSOC_CHAN_RELIABLE) {
+			continue;
+		}
+
+		struct rsoc_chan_message_t* message =
+			&chan->recv_window[chan->recv_seq & (RSOC_CHAN_WINDOW - 1)];
+		if(message->in_use == 0 || message->seq != chan->recv_seq) {
+			continue;
+		}
+
+		// leave the message where it is so it can be picked up again with a
+		// bigger buffer.
+		if(message->size > data_size) {
+			return RSOC_ERR_CHAN_SIZE;
+		}
+
+		memcpy(data, message->data, message->size);
+		message->in_use = 0;
+		chan->recv_seq++;
+
+		if(channel != NULL) {
+			*channel = i;
+		}
+
+		return message->size;
+	}
+
+	return 0;
+}
+
+int rsoc_chan_receive(rsoc_chan_conn_t* conn, int* channel, uint8_t* data,
+					  const int data_size) {
+	if(conn == NULL || conn->sock == NULL) {
+		return RSOC_ERR_CHAN_NULCONN;
+	}
+
+	uint8_t packet[RSOC_CHAN_PACKET_MAX];
+
+	while(1) {
+		int ret = _rsoc_chan_deliver_buffered(conn, channel, data, data_size);
+		if(ret != 0) {
+			return ret;
+		}
+
+		ret = rsoc_poll(conn->sock, 0);
+		if(ret <= 0) {
+			return ret < 0 ? RSOC_ERR_CHAN_SOCK : 0;
+		}
+
+		int packet_size = rsoc_receive(conn->sock, packet, sizeof(packet));
+		if(packet_size < 0) {
+			return RSOC_ERR_CHAN_SOCK;
+		}
+
+		// ignore anything that isn't ours.
+		if(packet_size < RSOC_CHAN_HEADER_SIZE ||
+		   packet[0] != RSOC_CHAN_MAGIC) {
+			continue;
+		}
+
+		int		 packet_channel = packet[1] & ~RSOC_CHAN_FLAG_ACK;
+		int		 has_ack		= packet[1] & RSOC_CHAN_FLAG_ACK;
+		uint16_t seq			= _rsoc_chan_read_u16(packet + 2);
+		uint16_t ack			= _rsoc_chan_read_u16(packet + 4);
+		uint32_t ack_bits		= _rsoc_chan_read_u32(packet + 6);
+		uint16_t msg_seq		= _rsoc_chan_read_u16(packet + 10);
+
+		uint8_t* payload	  = packet + RSOC_CHAN_HEADER_SIZE;
+		int		 payload_size = packet_size - RSOC_CHAN_HEADER_SIZE;
+
+		// the peer's acks only mean something once it has heard from us.
+		uint64_t now = rsoc_time_us();
+		if(has_ack) {
+			_rsoc_chan_on_ack(conn, ack, now);
+			for(int i = 0; i < 32; i++) {
+				if(ack_bits & (1u << i)) {
+					_rsoc_chan_on_ack(conn, ack - 1 - i, now);
+				}
+			}
+		}
+
+		_rsoc_chan_on_remote_seq(conn, seq);
+		rsoc_stats_seq(conn->sock, seq);
+
+		// bare acks don't get acked themselves, that would never stop.
+		if(packet_channel == RSOC_CHAN_ACK_ONLY ||
+		   packet_channel >= conn->channel_count) {
+			continue;
+		}
+
+		conn->ack_pending = 1;
+
+		struct rsoc_chan_t* chan = &conn->channels[packet_channel];
+
+		if(chan->type == RSOC_CHAN_RELIABLE) {
+			// store it in the window, delivering happens at the top of the
+			// loop once everything before it has arrived. old duplicates
+			// fall outside the window and are dropped.
+			uint16_t distance = msg_seq - chan->recv_seq;
+			if(distance >= RSOC_CHAN_WINDOW) {
+				continue;
+			}
+
+			struct rsoc_chan_message_t* message =
+				&chan->recv_window[msg_seq & (RSOC_CHAN_WINDOW - 1)];
+			if(message->in_use == 0) {
+				message->in_use = 1;
+				message->seq	= msg_seq;
+				message->size	= payload_size;
+				memcpy(message->data, payload, payload_size);
+			}
+
+			continue;
+		}
+
+		if(chan->type == RSOC_CHAN_SEQUENCED) {
+			if(chan->has_recv && ! _rsoc_chan_seq_gt(msg_seq, chan->recv_seq)) {
+				continue;
+			}
+
+			chan->has_recv = 1;
+			chan->recv_seq = msg_seq;
+		}
+
+		if(payload_size > data_size) {
+			return RSOC_ERR_CHAN_SIZE;
+		}
+
+		memcpy(data, payload, payload_size);
+		if(channel != NULL) {
+			*channel = packet_channel;
+		}
+
+		return payload_size;
+	}
+}
+
+int rsoc_chan_update(rsoc_chan_conn_t* conn) {
+	if(conn == NULL || conn->sock == NULL) {
+		return RSOC_ERR_CHAN_NULCONN;
+	}
+
+	uint64_t now = rsoc_time_us();
+
+	// resend reliable messages that haven't been acked in time.
+	for(int i = 0; i < conn->channel_count; i++) {
+		struct rsoc_chan_t* chan = &conn->channels[i];
+		if(chan->type != RSOC_CHAN_RELIABLE) {
+			continue;
+		}
+
+		for(int j = 0; j < RSOC_CHAN_WINDOW; j++) {
+			struct rsoc_chan_message_t* message = &chan->send_window[j];
+			if(message->in_use == 0) {
+				continue;
+			}
+
+			int backoff = message->retries < RSOC_CHAN_BACKOFF_MAX
+							  ? message->retries
+							  : RSOC_CHAN_BACKOFF_MAX;
+			if(now - message->sent_us < conn->rto_us << backoff) {
+				continue;
+			}
+
+			message->sent_us = now;
+			message->retries++;
+			if(_rsoc_chan_send_packet(conn, i, message->seq, 1, message->data,
+									  message->size) < 0) {
+				return RSOC_ERR_CHAN_SOCK;
+			}
+		}
+	}
+
+	if(conn->ack_pending &&
+	   now - conn->last_send_us >= RSOC_CHAN_ACK_INTERVAL_US) {
+		if(_rsoc_chan_send_packet(conn, RSOC_CHAN_ACK_ONLY, 0, 0, NULL, 0) <
+		   0) {
+			return RSOC_ERR_CHAN_SOCK;
+		}
+	}
+
+	return 0;
+}
+
+uint64_t rsoc_chan_rtt(rsoc_chan_conn_t* conn) {
+	return conn->srtt_us;
+}
+
+int rsoc_chan_pending(rsoc_chan_conn_t* conn, const int channel) {
+	if(channel < 0 || channel >= conn->channel_count ||
+	   conn->channels[channel].type != RSOC_CHAN_RELIABLE) {
+		return 0;
+	}
+
+	int pending = 0;
+	for(int i = 0; i < RSOC_CHAN_WINDOW; i++) {
+		pending += conn->channels[channel].send_window[i].in_use;
+	}
+
+	return pending;
+}
+
+int rsoc_chan_close(rsoc_chan_conn_t* conn) {
+	if(conn == NULL) {
+		return RSOC_ERR_CHAN_NULCONN;
+	}
+
+	for(int i = 0; i < conn->channel_count; i++) {
+		free(conn->channels[i].send_window);
+		free(conn->channels[i].recv_window);
+	}
+
+	memset(conn, 0, sizeof(rsoc_chan_conn_t));
+
+	return 0;
+}
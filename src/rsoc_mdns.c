@@ -0,0 +1,782 @@
+#include "rsoc.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+
+#include <WinSock2.h>
+#include <ws2tcpip.h>
+
+#else
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#endif
+
+// Minimal mDNS engine for rsoc_resolve_mdns and rsoc_host_mdns. See rfc 6762
+// for the protocol and rfc 1035 for the packet format it borrows from DNS.
+//
+// Everything goes through one socket bound to 5353 that has joined the mDNS
+// group. Resolving sends at most RSOC_MDNS_QUERY_RETRIES queries and hosting
+// sends two announcements, after that we only ever talk when asked.
+
+#define RSOC_MDNS_ERR(message) fprintf(stderr, "mdns: " message "\n");
+
+#define MDNS_TYPE_A 1
+#define MDNS_TYPE_ANY 255
+#define MDNS_CLASS_IN 1
+// the top bit of the class is the cache-flush bit in answers and the
+// unicast-response bit in questions.
+#define MDNS_CLASS_MASK 0x7FFF
+#define MDNS_CLASS_FLUSH 0x8000
+
+#define MDNS_FLAG_RESPONSE 0x8000
+#define MDNS_FLAG_AUTHORITATIVE 0x0400
+
+#define MDNS_HEADER_SIZE 12
+#define MDNS_PACKET_MAX 1500
+#define MDNS_LABEL_MAX 63
+// maximum number of compression pointers followed in one name. this stops
+// malicious packets from looping us forever.
+#define MDNS_JUMP_MAX 16
+
+// time between the first and second announcement of a hosted name.
+#define MDNS_ANNOUNCE_INTERVAL_US 1000000
+
+static struct {
+	int is_open;
+	int fd;
+
+	struct rsoc_mdns_record_t {
+		char		   name[RSOC_MDNS_NAME_MAX];
+		struct in_addr addr;
+		// zero when the record is unused.
+		uint64_t expires_us;
+	} cache[RSOC_MDNS_CACHE_COUNT];
+
+	struct rsoc_mdns_host_t {
+		char		   name[RSOC_MDNS_NAME_MAX];
+		struct in_addr addr;
+		int			   announce_count;
+		uint64_t	   announce_us;
+	} hosts[RSOC_MDNS_HOST_COUNT];
+} _rsoc_mdns = {0};
+
+static void _rsoc_mdns_close_fd(int fd) {
+#ifdef _WIN32
+	closesocket(fd);
+#else
+	close(fd);
+#endif
+}
+
+static int _rsoc_mdns_open() {
+	if(_rsoc_mdns.is_open) {
+		return 0;
+	}
+
+	int fd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if(fd < 0) {
+		RSOC_MDNS_ERR("failed to create the multicast socket");
+		return RSOC_ERR_MDNS_SOCKET;
+	}
+
+	// other responders (and our own second process when testing on loopback)
+	// also sit on 5353 so the port has to be shared.
+	int opt = 1;
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, (const char*) &opt, sizeof(opt));
+#ifdef SO_REUSEPORT
+	setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, (const char*) &opt, sizeof(opt));
+#endif
+
+	struct sockaddr_in addr = {0};
+	addr.sin_family			= AF_INET;
+	addr.sin_addr.s_addr	= htonl(INADDR_ANY);
+	addr.sin_port			= htons(RSOC_MDNS_PORT);
+	if(bind(fd, (struct sockaddr*) &addr, sizeof(addr)) < 0) {
+		RSOC_MDNS_ERR("failed to bind the multicast socket");
+		_rsoc_mdns_close_fd(fd);
+		return RSOC_ERR_MDNS_SOCKET;
+	}
+
+	struct ip_mreq mreq		   = {0};
+	mreq.imr_multiaddr.s_addr = inet_addr(RSOC_MDNS_ADDR);
+	mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+	if(setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, (const char*) &mreq,
+				  sizeof(mreq)) < 0) {
+		RSOC_MDNS_ERR("failed to join the multicast group");
+		_rsoc_mdns_close_fd(fd);
+		return RSOC_ERR_MDNS_SOCKET;
+	}
+
+	// loopback has to stay on so two processes on one machine can see each
+	// other.
+	unsigned char ttl  = 255;
+	unsigned char loop = 1;
+	setsockopt(fd, IPPROTO_IP, IP_MULTICAST_TTL, (const char*) &ttl,
+			   sizeof(ttl));
+	setsockopt(fd, IPPROTO_IP, IP_MULTICAST_LOOP, (const char*) &loop,
+			   sizeof(loop));
+
+	_rsoc_mdns.fd	   = fd;
+	_rsoc_mdns.is_open = 1;
+
+	return 0;
+}
+
+static int _rsoc_mdns_send(const uint8_t* packet, const int packet_size,
+						   const struct sockaddr_in* to) {
+	struct sockaddr_in group = {0};
+	if(to == NULL) {
+		group.sin_family	  = AF_INET;
+		group.sin_addr.s_addr = inet_addr(RSOC_MDNS_ADDR);
+		group.sin_port		  = htons(RSOC_MDNS_PORT);
+		to					  = &group;
+	}
+
+	int ret = sendto(_rsoc_mdns.fd, (const char*) packet, packet_size, 0,
+					 (const struct sockaddr*) to, sizeof(struct sockaddr_in));
+	if(ret != packet_size) {
+		RSOC_MDNS_ERR("failed to send packet");
+		return RSOC_ERR_MDNS_SEND;
+	}
+
+	return 0;
+}
+
+// Compare two names the way DNS does: ascii case-insensitive and ignoring a
+// trailing dot.
+static int _rsoc_mdns_name_eq(const char* a, const char* b) {
+	for(;; a++, b++) {
+		char ca = (*a >= 'A' && *a <= 'Z') ? *a + ('a' - 'A') : *a;
+		char cb = (*b >= 'A' && *b <= 'Z') ? *b + ('a' - 'A') : *b;
+
+		if(ca == '.' && a[1] == '\0' && cb == '\0') {
+			return 1;
+		}
+		if(cb == '.' && b[1] == '\0' && ca == '\0') {
+			return 1;
+		}
+		if(ca != cb) {
+			return 0;
+		}
+		if(ca == '\0') {
+			return 1;
+		}
+	}
+}
+
+static int _rsoc_mdns_write_u16(uint8_t* packet, const int packet_size,
+								int offset, uint16_t value) {
+	if(offset < 0 || offset + 2 > packet_size) {
+		return -1;
+	}
+
+	packet[offset]	   = value >> 8;
+	packet[offset + 1] = value & 0xFF;
+
+	return offset + 2;
+}
+
+static uint16_t _rsoc_mdns_read_u16(const uint8_t* packet, int offset) {
+	return (uint16_t) (packet[offset] << 8 | packet[offset + 1]);
+}
+
+// Writes name as a list of labels. Returns the offset after the name or a
+// negative value if it doesn't fit or isn't a valid name.
+static int _rsoc_mdns_write_name(uint8_t* packet, const int packet_size,
+								 int offset, const char* name) {
+	if(offset < 0) {
+		return -1;
+	}
+
+	const char* label = name;
+	while(*label != '\0') {
+		const char* end = strchr(label, '.');
+		int label_size	= end == NULL ? (int) strlen(label) : end - label;
+
+		if(label_size == 0 || label_size > MDNS_LABEL_MAX) {
+			return RSOC_ERR_MDNS_NAME;
+		}
+		if(offset + 1 + label_size >= packet_size) {
+			return -1;
+		}
+
+		packet[offset++] = label_size;
+		memcpy(packet + offset, label, label_size);
+		offset += label_size;
+
+		if(end == NULL) {
+			break;
+		}
+		label = end + 1;
+	}
+
+	if(offset >= packet_size) {
+		return -1;
+	}
+	packet[offset++] = 0;
+
+	return offset;
+}
+
+// Reads a possibly compressed name at offset into name as a dotted string.
+// Returns the offset right after the name in the packet or a negative value if
+// the name is malformed.
+static int _rsoc_mdns_read_name(const uint8_t* packet, const int packet_size,
+								int offset, char* name, const int name_size) {
+	int name_offset = 0;
+	int end_offset	= -1;
+	int jumps		= 0;
+
+	while(1) {
+		if(offset >= packet_size) {
+			return -1;
+		}
+
+		uint8_t label_size = packet[offset];
+
+		// the top two bits set means this is a pointer to a name somewhere
+		// earlier in the packet.
+		if((label_size & 0xC0) == 0xC0) {
+			if(offset + 1 >= packet_size || ++jumps > MDNS_JUMP_MAX) {
+				return -1;
+			}
+			if(end_offset < 0) {
+				end_offset = offset + 2;
+			}
+			offset = _rsoc_mdns_read_u16(packet, offset) & 0x3FFF;
+			continue;
+		}
+
+		if(label_size == 0) {
+			offset++;
+			break;
+		}
+
+		if(label_size > MDNS_LABEL_MAX ||
+		   offset + 1 + label_size > packet_size ||
+		   name_offset + label_size + 2 > name_size) {
+			return -1;
+		}
+
+		if(name_offset > 0) {
+			name[name_offset++] = '.';
+		}
+		memcpy(name + name_offset, packet + offset + 1, label_size);
+		name_offset += label_size;
+		offset += 1 + label_size;
+	}
+
+	name[name_offset] = '\0';
+
+	return end_offset < 0 ? offset : end_offset;
+}
+
+static int _rsoc_mdns_write_answer(uint8_t* packet, const int packet_size,
+								   int offset, const char* name,
+								   struct in_addr addr, uint32_t ttl) {
+	offset = _rsoc_mdns_write_name(packet, packet_size, offset, name);
+	offset = _rsoc_mdns_write_u16(packet, packet_size, offset, MDNS_TYPE_A);
+	offset = _rsoc_mdns_write_u16(packet, packet_size, offset,
+								  MDNS_CLASS_IN | MDNS_CLASS_FLUSH);
+	offset = _rsoc_mdns_write_u16(packet, packet_size, offset, ttl >> 16);
+	offset = _rsoc_mdns_write_u16(packet, packet_size, offset, ttl & 0xFFFF);
+	offset = _rsoc_mdns_write_u16(packet, packet_size, offset, 4);
+	if(offset < 0 || offset + 4 > packet_size) {
+		return -1;
+	}
+
+	memcpy(packet + offset, &addr, 4);
+
+	return offset + 4;
+}
+
+static void _rsoc_mdns_cache_put(const char* name, struct in_addr addr,
+								 uint32_t ttl) {
+	uint64_t now = rsoc_time_us();
+
+	// reuse the entry of the same name, otherwise take a free or expired entry
+	// and if there is none, the one that expires first.
+	struct rsoc_mdns_record_t* record = NULL;
+	for(int i = 0; i < RSOC_MDNS_CACHE_COUNT; i++) {
+		struct rsoc_mdns_record_t* curr = &_rsoc_mdns.cache[i];
+
+		if(curr->expires_us != 0 && _rsoc_mdns_name_eq(curr->name, name)) {
+			record = curr;
+			break;
+		}
+
+		if(record == NULL || curr->expires_us < record->expires_us) {
+			record = curr;
+		}
+	}
+
+	// a TTL of zero is a goodbye packet. forget the record.
+	if(ttl == 0) {
+		if(record->expires_us != 0 && _rsoc_mdns_name_eq(record->name, name)) {
+			record->expires_us = 0;
+		}
+		return;
+	}
+
+	snprintf(record->name, sizeof(record->name), "%s", name);
+	record->addr	   = addr;
+	record->expires_us = now + (uint64_t) ttl * 1000000;
+}
+
+static int _rsoc_mdns_cache_get(const char* name, struct in_addr* addr) {
+	uint64_t now = rsoc_time_us();
+
+	for(int i = 0; i < RSOC_MDNS_CACHE_COUNT; i++) {
+		struct rsoc_mdns_record_t* record = &_rsoc_mdns.cache[i];
+
+		if(record->expires_us == 0) {
+			continue;
+		}
+
+		if(record->expires_us <= now) {
+			record->expires_us = 0;
+			continue;
+		}
+
+		if(_rsoc_mdns_name_eq(record->name, name)) {
+			*addr = record->addr;
+			return 0;
+		}
+	}
+
+	return -1;
+}
+
+static int _rsoc_mdns_announce(struct rsoc_mdns_host_t* host, uint32_t ttl) {
+	uint8_t packet[MDNS_PACKET_MAX] = {0};
+
+	int offset = 2;
+	offset	   = _rsoc_mdns_write_u16(packet, sizeof(packet), offset,
+									  MDNS_FLAG_RESPONSE |
+										  MDNS_FLAG_AUTHORITATIVE);
+	offset	   = _rsoc_mdns_write_u16(packet, sizeof(packet), offset, 0);
+	offset	   = _rsoc_mdns_write_u16(packet, sizeof(packet), offset, 1);
+	offset	   = _rsoc_mdns_write_u16(packet, sizeof(packet), offset, 0);
+	offset	   = _rsoc_mdns_write_u16(packet, sizeof(packet), offset, 0);
+	offset	   = _rsoc_mdns_write_answer(packet, sizeof(packet), offset,
+										 host->name, host->addr, ttl);
+	if(offset < 0) {
+		return RSOC_ERR_MDNS_NAME;
+	}
+
+	return _rsoc_mdns_send(packet, offset, NULL);
+}
+
+// Handles a single received packet. Answers go into the cache and questions
+// about our hosted names get a response.
+static int _rsoc_mdns_handle(const uint8_t* packet, const int packet_size,
+							 const struct sockaddr_in* from) {
+	if(packet_size < MDNS_HEADER_SIZE) {
+		return -1;
+	}
+
+	uint16_t id				= _rsoc_mdns_read_u16(packet, 0);
+	uint16_t flags			= _rsoc_mdns_read_u16(packet, 2);
+	int		 question_count = _rsoc_mdns_read_u16(packet, 4);
+	int		 record_count	= _rsoc_mdns_read_u16(packet, 6) +
+					  _rsoc_mdns_read_u16(packet, 8) +
+					  _rsoc_mdns_read_u16(packet, 10);
+
+	char name[RSOC_MDNS_NAME_MAX];
+	int	 offset = MDNS_HEADER_SIZE;
+
+	if(flags & MDNS_FLAG_RESPONSE) {
+		// skip over any questions, responses usually don't have them.
+		for(int i = 0; i < question_count; i++) {
+			offset = _rsoc_mdns_read_name(packet, packet_size, offset, name,
+										  sizeof(name));
+			if(offset < 0 || offset + 4 > packet_size) {
+				return -1;
+			}
+			offset += 4;
+		}
+
+		for(int i = 0; i < record_count; i++) {
+			offset = _rsoc_mdns_read_name(packet, packet_size, offset, name,
+										  sizeof(name));
+			if(offset < 0 || offset + 10 > packet_size) {
+				return -1;
+			}
+
+			uint16_t type		  = _rsoc_mdns_read_u16(packet, offset);
+			uint16_t record_class = _rsoc_mdns_read_u16(packet, offset + 2);
+			uint32_t ttl		  = (uint32_t) _rsoc_mdns_read_u16(packet,
+																   offset + 4)
+							 << 16 |
+						 _rsoc_mdns_read_u16(packet, offset + 6);
+			uint16_t data_size = _rsoc_mdns_read_u16(packet, offset + 8);
+			offset += 10;
+
+			if(offset + data_size > packet_size) {
+				return -1;
+			}
+
+			if(type == MDNS_TYPE_A &&
+			   (record_class & MDNS_CLASS_MASK) == MDNS_CLASS_IN &&
+			   data_size == 4) {
+				struct in_addr addr;
+				memcpy(&addr, packet + offset, 4);
+				_rsoc_mdns_cache_put(name, addr, ttl);
+			}
+
+			offset += data_size;
+		}
+
+		return 0;
+	}
+
+	// a query. collect every name we host that is asked about.
+	struct rsoc_mdns_host_t* answers[RSOC_MDNS_HOST_COUNT];
+	int						 answer_count = 0;
+
+	for(int i = 0; i < question_count; i++) {
+		offset = _rsoc_mdns_read_name(packet, packet_size, offset, name,
+									  sizeof(name));
+		if(offset < 0 || offset + 4 > packet_size) {
+			return -1;
+		}
+
+		uint16_t type		  = _rsoc_mdns_read_u16(packet, offset);
+		uint16_t record_class = _rsoc_mdns_read_u16(packet, offset + 2);
+		offset += 4;
+
+		if((type != MDNS_TYPE_A && type != MDNS_TYPE_ANY) ||
+		   (record_class & MDNS_CLASS_MASK) != MDNS_CLASS_IN) {
+			continue;
+		}
+
+		for(int j = 0; j < RSOC_MDNS_HOST_COUNT; j++) {
+			struct rsoc_mdns_host_t* host = &_rsoc_mdns.hosts[j];
+			if(host->name[0] == '\0' ||
+			   ! _rsoc_mdns_name_eq(host->name, name)) {
+				continue;
+			}
+
+			answers[answer_count++] = host;
+			break;
+		}
+
+		if(answer_count == RSOC_MDNS_HOST_COUNT) {
+			break;
+		}
+	}
+
+	if(answer_count == 0) {
+		return 0;
+	}
+
+	// queries that don't come from port 5353 are legacy unicast queries (rfc
+	// 6762 section 6.7). they get a unicast reply that looks like plain DNS so
+	// the id and the questions have to be repeated.
+	int is_legacy = ntohs(from->sin_port) != RSOC_MDNS_PORT;
+
+	uint8_t response[MDNS_PACKET_MAX] = {0};
+	int		response_offset			  = MDNS_HEADER_SIZE;
+
+	_rsoc_mdns_write_u16(response, sizeof(response), 0, is_legacy ? id : 0);
+	_rsoc_mdns_write_u16(response, sizeof(response), 2,
+						 MDNS_FLAG_RESPONSE | MDNS_FLAG_AUTHORITATIVE);
+	_rsoc_mdns_write_u16(response, sizeof(response), 4,
+						 is_legacy ? answer_count : 0);
+	_rsoc_mdns_write_u16(response, sizeof(response), 6, answer_count);
+
+	for(int i = 0; is_legacy && i < answer_count; i++) {
+		response_offset = _rsoc_mdns_write_name(
+			response, sizeof(response), response_offset, answers[i]->name);
+		response_offset = _rsoc_mdns_write_u16(response, sizeof(response),
+											   response_offset, MDNS_TYPE_A);
+		response_offset = _rsoc_mdns_write_u16(response, sizeof(response),
+											   response_offset, MDNS_CLASS_IN);
+	}
+
+	// legacy resolvers get a short TTL as they never see goodbye packets.
+	for(int i = 0; i < answer_count; i++) {
+		response_offset = _rsoc_mdns_write_answer(
+			response, sizeof(response), response_offset, answers[i]->name,
+			answers[i]->addr, is_legacy ? 10 : RSOC_MDNS_TTL);
+	}
+
+	if(response_offset < 0) {
+		return -1;
+	}
+
+	return _rsoc_mdns_send(response, response_offset, is_legacy ? from : NULL);
+}
+
+// Finds the address other machines should use to reach us by asking the OS
+// which interface it would use to send to the mDNS group.
+static int _rsoc_mdns_local_addr(struct in_addr* addr) {
+	int fd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if(fd < 0) {
+		return -1;
+	}
+
+	struct sockaddr_in group = {0};
+	group.sin_family		 = AF_INET;
+	group.sin_addr.s_addr	 = inet_addr(RSOC_MDNS_ADDR);
+	group.sin_port			 = htons(RSOC_MDNS_PORT);
+
+	struct sockaddr_in local	  = {0};
+	socklen_t		   local_size = sizeof(local);
+
+	if(connect(fd, (struct sockaddr*) &group, sizeof(group)) < 0 ||
+	   getsockname(fd, (struct sockaddr*) &local, &local_size) < 0 ||
+	   local.sin_addr.s_addr == htonl(INADDR_ANY)) {
+		// no route to the group, so only this machine can see us anyway.
+		local.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	}
+
+	_rsoc_mdns_close_fd(fd);
+
+	*addr = local.sin_addr;
+
+	return 0;
+}
+
+int rsoc_mdns_update(const int timeout_ms) {
+	int ret = _rsoc_mdns_open();
+	if(ret < 0) {
+		return ret;
+	}
+
+	// send the follow up announcements of freshly hosted names.
+	uint64_t now = rsoc_time_us();
+	for(int i = 0; i < RSOC_MDNS_HOST_COUNT; i++) {
+		struct rsoc_mdns_host_t* host = &_rsoc_mdns.hosts[i];
+		if(host->name[0] == '\0' || host->announce_count <= 0 ||
+		   host->announce_us > now) {
+			continue;
+		}
+
+		_rsoc_mdns_announce(host, RSOC_MDNS_TTL);
+		host->announce_count--;
+		host->announce_us = now + MDNS_ANNOUNCE_INTERVAL_US;
+	}
+
+	int handled = 0;
+	while(1) {
+		// only wait for the first packet. after that, just drain what's left.
+		int wait_ms = handled == 0 ? timeout_ms : 0;
+
+		fd_set fds;
+		FD_ZERO(&fds);
+		FD_SET(_rsoc_mdns.fd, &fds);
+
+		struct timeval timeout = {0};
+		timeout.tv_sec		   = wait_ms / 1000;
+		timeout.tv_usec		   = (wait_ms % 1000) * 1000;
+
+		ret = select(_rsoc_mdns.fd + 1, &fds, NULL, NULL, &timeout);
+		if(ret < 0) {
+			RSOC_MDNS_ERR("failed to wait on the multicast socket");
+			return RSOC_ERR_MDNS_SOCKET;
+		}
+		if(ret == 0) {
+			break;
+		}
+
+		uint8_t			   packet[MDNS_PACKET_MAX];
+		struct sockaddr_in from		 = {0};
+		socklen_t		   from_size = sizeof(from);
+
+		int packet_size =
+			recvfrom(_rsoc_mdns.fd, (char*) packet, sizeof(packet), 0,
+					 (struct sockaddr*) &from, &from_size);
+		if(packet_size <= 0) {
+			break;
+		}
+
+		_rsoc_mdns_handle(packet, packet_size, &from);
+		handled++;
+	}
+
+	return handled;
+}
+
+int rsoc_mdns_query(const char* name, struct in_addr* addr) {
+	if(name == NULL || name[0] == '\0' || addr == NULL) {
+		return RSOC_ERR_MDNS_NAME;
+	}
+
+	if(_rsoc_mdns_cache_get(name, addr) == 0) {
+		return 0;
+	}
+
+	int ret = _rsoc_mdns_open();
+	if(ret < 0) {
+		return ret;
+	}
+
+	// a one-shot query: id 0, no flags, one question for the A record.
+	uint8_t packet[MDNS_PACKET_MAX] = {0};
+	_rsoc_mdns_write_u16(packet, sizeof(packet), 4, 1);
+
+	int offset = _rsoc_mdns_write_name(packet, sizeof(packet),
+									   MDNS_HEADER_SIZE, name);
+	offset = _rsoc_mdns_write_u16(packet, sizeof(packet), offset, MDNS_TYPE_A);
+	offset =
+		_rsoc_mdns_write_u16(packet, sizeof(packet), offset, MDNS_CLASS_IN);
+	if(offset < 0) {
+		return RSOC_ERR_MDNS_NAME;
+	}
+
+	int wait_ms = RSOC_MDNS_QUERY_TIMEOUT_MS;
+	for(int i = 0; i < RSOC_MDNS_QUERY_RETRIES; i++) {
+		ret = _rsoc_mdns_send(packet, offset, NULL);
+		if(ret < 0) {
+			return ret;
+		}
+
+		uint64_t deadline = rsoc_time_us() + (uint64_t) wait_ms * 1000;
+		for(uint64_t now = rsoc_time_us(); now < deadline;
+			now			 = rsoc_time_us()) {
+			ret = rsoc_mdns_update((int) ((deadline - now + 999) / 1000));
+			if(ret < 0) {
+				return ret;
+			}
+
+			if(_rsoc_mdns_cache_get(name, addr) == 0) {
+				return 0;
+			}
+		}
+
+		wait_ms *= 2;
+	}
+
+	return RSOC_ERR_MDNS_TIMEOUT;
+}
+
+int rsoc_mdns_unhost(const char* name) {
+	for(int i = 0; i < RSOC_MDNS_HOST_COUNT; i++) {
+		struct rsoc_mdns_host_t* host = &_rsoc_mdns.hosts[i];
+		if(host->name[0] == '\0' || ! _rsoc_mdns_name_eq(host->name, name)) {
+			continue;
+		}
+
+		if(_rsoc_mdns.is_open) {
+			_rsoc_mdns_announce(host, 0);
+		}
+
+		memset(host, 0, sizeof(struct rsoc_mdns_host_t));
+		return 0;
+	}
+
+	return -1;
+}
+
+void rsoc_mdns_flush() {
+	memset(_rsoc_mdns.cache, 0, sizeof(_rsoc_mdns.cache));
+}
+
+int rsoc_mdns_close() {
+	for(int i = 0; i < RSOC_MDNS_HOST_COUNT; i++) {
+		if(_rsoc_mdns.hosts[i].name[0] != '\0') {
+			rsoc_mdns_unhost(_rsoc_mdns.hosts[i].name);
+		}
+	}
+
+	if(_rsoc_mdns.is_open) {
+		_rsoc_mdns_close_fd(_rsoc_mdns.fd);
+		_rsoc_mdns.is_open = 0;
+	}
+
+	rsoc_mdns_flush();
+
+	return 0;
+}
+
+// CLIENT FUNCTIONS
+
+int rsoc_resolve_mdns(char* addr, const int addr_size, rsoc_socket_t* sock) {
+	if(sock == NULL) {
+		return RSOC_ERR_RESOLV_NULSOCK;
+	}
+
+	char name[RSOC_MDNS_NAME_MAX];
+	if(addr == NULL || addr_size <= 0 ||
+	   snprintf(name, sizeof(name), "%.*s", addr_size, addr) >=
+		   (int) sizeof(name)) {
+		return RSOC_ERR_MDNS_NAME;
+	}
+
+	struct in_addr ip;
+	int			   ret = rsoc_mdns_query(name, &ip);
+	if(ret < 0) {
+		return ret;
+	}
+
+	char ip_str[INET_ADDRSTRLEN];
+	inet_ntop(AF_INET, &ip, ip_str, sizeof(ip_str));
+
+	return rsoc_resolve_ip(ip_str, sizeof(ip_str), sock->port, sock);
+}
+
+// HOST FUNCTIONS
+
+int rsoc_host_mdns(char* addr, const int addr_size, const int port,
+				   rsoc_socket_t* sock) {
+	char name[RSOC_MDNS_NAME_MAX];
+	if(addr == NULL || addr_size <= 0 ||
+	   snprintf(name, sizeof(name), "%.*s", addr_size, addr) >=
+		   (int) sizeof(name)) {
+		return RSOC_ERR_MDNS_NAME;
+	}
+
+	int ret = rsoc_host(port, sock);
+	if(ret < 0) {
+		return ret;
+	}
+
+	// the socket rsoc_host just opened is closed again on every failure below.
+	ret = _rsoc_mdns_open();
+	if(ret < 0) {
+		rsoc_close(sock);
+		return ret;
+	}
+
+	struct rsoc_mdns_host_t* host = NULL;
+	for(int i = 0; i < RSOC_MDNS_HOST_COUNT; i++) {
+		if(_rsoc_mdns.hosts[i].name[0] == '\0' ||
+		   _rsoc_mdns_name_eq(_rsoc_mdns.hosts[i].name, name)) {
+			host = &_rsoc_mdns.hosts[i];
+			break;
+		}
+	}
+
+	if(host == NULL) {
+		rsoc_close(sock);
+		return RSOC_ERR_MDNS_FULL;
+	}
+
+	snprintf(host->name, sizeof(host->name), "%s", name);
+	_rsoc_mdns_local_addr(&host->addr);
+
+	// announce once now and once more from rsoc_mdns_update a second later.
+	// resolvers that are already waiting get the answer without asking again.
+	ret = _rsoc_mdns_announce(host, RSOC_MDNS_TTL);
+	if(ret < 0) {
+		memset(host, 0, sizeof(struct rsoc_mdns_host_t));
+		rsoc_close(sock);
+		return ret;
+	}
+
+	host->announce_count = 1;
+	host->announce_us	 = rsoc_time_us() + MDNS_ANNOUNCE_INTERVAL_US;
+
+	return 0;
+}
@@ -12,23 +12,18 @@ void on_value(int idx, int amount);
 int main(int arc, char** argv) {
 	printf("inpt version %s\n", inpt_version());
 
-	inpt_state_add("drive");
-	inpt_state_add("drive_lock");
-	inpt_state_add("shoot");
+	// written at exit, open it in ui.perfetto.dev.
+	debug_thread_name("main");
+	debug_trace_start(65536, "inpt_trace.json");
 
-	inpt_act_new_state_change("drive_to_shoot", (char*[]){"drive", "shoot"}, 2,
-							  -1, 7, "shoot", INPT_BTN_PRESSED);
-	inpt_act_new_state_change("shoot_to_drive", (char*[]){"drive", "shoot"}, 2,
-							  -1, 7, "drive", INPT_BTN_RELEASED);
+	// the library logs through the dll's ring, this sets its level.
+	debug_log_level(DEBUG_LOG_DEBUG);
 
-	inpt_act_new_trigger("shoot", (char*[]){"shoot"}, 1, -1, 2,
-						 INPT_BTN_RELEASED);
+	// controllers seen by an earlier run aren't probed again.
+	inpt_hid_cache("inpt_hid.cache");
 
-	inpt_act_new_trigger("drive_forwards", (char*[]){"drive"}, 1, -1, 5,
-						 INPT_BTN_HELD);
-
-	inpt_act_new_trigger("drive_backwards", (char*[]){"drive"}, 1, -1, 4,
-						 INPT_BTN_HELD);
+	// reloaded whenever the file changes, swapped in by inpt_update.
+	inpt_bind_watch("test/bindings.inpt", 250);
 
 	DEBUG_TIME_START("inpt_update");
 	inpt_update();
@@ -68,6 +63,9 @@ int main(int arc, char** argv) {
 		inpt_update();
 		DEBUG_TIME_STOP();
 		if(debug_time_last_ms() > 100.0) {
+			debug_prof_print(stdout);
+			// the library's counters, read from the dll's registry.
+			debug_metrics_print(stdout);
 			exit(0);
 		}
 		// puts("\n");
@@ -5,7 +5,6 @@ LIBS_TEST		=	-lsetupapi						\
 					-llibinpt
 
 SRC			   := $(wildcard test/*.c)
-SRC			   += src/debug.c
 
 .PHONY: test
 
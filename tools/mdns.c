@@ -0,0 +1,59 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rsoc.h"
+
+// Small mDNS tool for testing rsoc_host_mdns and rsoc_resolve_mdns on loopback.
+// Run "mdns host robot.local 5800" in one terminal and
+// "mdns resolve robot.local 5800" in another.
+
+int main(int argc, char** argv) {
+	if(argc < 4) {
+		fprintf(stderr, "usage: %s host|resolve <name> <port>\n", argv[0]);
+		return -1;
+	}
+
+	if(rsoc_init() < 0) {
+		fprintf(stderr, "failed to initialize rsoc.\n");
+		return -1;
+	}
+
+	char* name = argv[2];
+	int	  port = atoi(argv[3]);
+
+	rsoc_socket_t sock = {0};
+	sock.family		   = RSOC_AF_INET;
+	sock.type		   = RSOC_SOCK_DGRAM;
+	sock.protocol	   = RSOC_IPPROTO_UDP;
+	sock.port		   = port;
+
+	if(strcmp(argv[1], "host") == 0) {
+		int ret = rsoc_host_mdns(name, strlen(name) + 1, port, &sock);
+		if(ret < 0) {
+			fprintf(stderr, "failed to host %s (%i).\n", name, ret);
+			return -1;
+		}
+
+		printf("hosting %s on port %i\n", name, port);
+		while(1) {
+			rsoc_mdns_update(1000);
+		}
+	}
+	else if(strcmp(argv[1], "resolve") == 0) {
+		int ret = rsoc_resolve_mdns(name, strlen(name) + 1, &sock);
+		if(ret < 0) {
+			fprintf(stderr, "failed to resolve %s (%i).\n", name, ret);
+			return -1;
+		}
+
+		char ip[INET_ADDRSTRLEN];
+		inet_ntop(AF_INET, &sock.addr.ip4.sin_addr, ip, sizeof(ip));
+		printf("%s is at %s:%i\n", name, ip, port);
+	}
+
+	rsoc_mdns_close();
+	rsoc_close(&sock);
+
+	return 0;
+}
@@ -0,0 +1,202 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rcam.h"
+#include "rsoc.h"
+
+// Camera stream tool for testing rcam on loopback or across a lossy link.
+// "rcam recv 5810" receives and prints the stream stats every second,
+// "rcam send 127.0.0.1 5810 30 2000 a.jpg b.jpg" sends every file as one frame
+// at up to 30 frames per second within a 2000 kbit/s budget, over and over.
+// The files are cut down to stand in for the smaller frames the suggested
+// scale and quality would encode to.
+
+#define RCAM_TOOL_FILE_COUNT 64
+
+static uint8_t* _load(const char* path, int* size) {
+	FILE* file = fopen(path, "rb");
+	if(file == NULL) {
+		return NULL;
+	}
+
+	fseek(file, 0, SEEK_END);
+	long length = ftell(file);
+	fseek(file, 0, SEEK_SET);
+
+	uint8_t* data = NULL;
+	if(length > 0 && length <= RCAM_FRAME_MAX) {
+		data = malloc(length);
+		if(data != NULL && fread(data, 1, length, file) != (size_t) length) {
+			free(data);
+			data = NULL;
+		}
+	}
+
+	fclose(file);
+	*size = (int) length;
+
+	return data;
+}
+
+static int _send(char* ip, int port, int fps, int budget_kbps,
+				 int file_count, char** paths) {
+	uint8_t* frames[RCAM_TOOL_FILE_COUNT];
+	int		 sizes[RCAM_TOOL_FILE_COUNT];
+
+	if(file_count > RCAM_TOOL_FILE_COUNT) {
+		file_count = RCAM_TOOL_FILE_COUNT;
+	}
+
+	for(int i = 0; i < file_count; i++) {
+		frames[i] = _load(paths[i], &sizes[i]);
+		if(frames[i] == NULL) {
+			fprintf(stderr, "failed to load %s.\n", paths[i]);
+			return -1;
+		}
+	}
+
+	rsoc_socket_t sock = {0};
+	sock.family		   = RSOC_AF_INET;
+	sock.type		   = RSOC_SOCK_DGRAM;
+	sock.protocol	   = RSOC_IPPROTO_UDP;
+
+	if(rsoc_resolve_ip(ip, strlen(ip) + 1, port, &sock) < 0) {
+		fprintf(stderr, "failed to connect to %s:%i.\n", ip, port);
+		return -1;
+	}
+
+	rcam_sender_t sender;
+	int			  ret = rcam_sender_init(&sender, &sock, 0);
+	if(ret < 0) {
+		fprintf(stderr, "failed to initialize the sender (%i).\n", ret);
+		return -1;
+	}
+	rcam_sender_budget(&sender, (uint64_t) budget_kbps * 1000, fps);
+
+	rcam_params_t params;
+	rcam_sender_params(&sender, &params);
+
+	uint64_t next	= rsoc_time_us();
+	uint64_t report = next + 1000000;
+	for(int i = 0;;) {
+		uint64_t now = rsoc_time_us();
+		if(now >= next) {
+			// stand in for the encoder, the files are taken as encoded at
+			// full size and quality 90 and cut down to roughly what the
+			// suggested params would encode to.
+			int size = (int) (sizes[i] * params.quality / 90.0 /
+							  (params.scale * params.scale));
+			ret		 = rcam_send_frame(&sender, frames[i], size > 0 ? size : 1,
+									   RCAM_FORMAT_MJPEG, 0, 0);
+			if(ret < 0) {
+				fprintf(stderr, "failed to send frame (%i).\n", ret);
+			}
+
+			i = (i + 1) % file_count;
+			rcam_sender_params(&sender, &params);
+			next += 1000000 / params.fps;
+		}
+
+		rcam_sender_update(&sender);
+
+		if(now >= report) {
+			printf("sent %llu skipped %llu | target %llu kbit/s loss %.1f%% "
+				   "delay %llu us | %i fps scale 1/%i quality %i\n",
+				   (unsigned long long) sender.frames_sent,
+				   (unsigned long long) sender.frames_skipped,
+				   (unsigned long long) params.rate_bps / 1000,
+				   sender.loss * 100.0,
+				   (unsigned long long) sender.queue_delay_us, params.fps,
+				   params.scale, params.quality);
+			report += 1000000;
+		}
+
+		// the pacer needs to run about every millisecond while sending.
+		rsoc_poll(&sock, 1);
+	}
+
+	rcam_sender_free(&sender);
+
+	return 0;
+}
+
+static int _recv(int port) {
+	rsoc_socket_t sock = {0};
+	sock.family		   = RSOC_AF_INET;
+	sock.type		   = RSOC_SOCK_DGRAM;
+	sock.protocol	   = RSOC_IPPROTO_UDP;
+
+	if(rsoc_host(port, &sock) < 0) {
+		fprintf(stderr, "failed to host on port %i.\n", port);
+		return -1;
+	}
+
+	rcam_receiver_t receiver;
+	int				ret = rcam_receiver_init(&receiver, &sock, 0);
+	if(ret < 0) {
+		fprintf(stderr, "failed to initialize the receiver (%i).\n", ret);
+		return -1;
+	}
+
+	uint64_t next  = rsoc_time_us() + 1000000;
+	uint64_t bytes = 0;
+	while(1) {
+		if(rcam_receiver_update(&receiver, 1) < 0) {
+			fprintf(stderr, "failed to receive.\n");
+		}
+
+		rcam_frame_t* frame;
+		while((frame = rcam_receiver_acquire(&receiver)) != NULL) {
+			bytes += frame->size;
+			rcam_receiver_release(&receiver, frame);
+		}
+
+		if(rsoc_time_us() >= next) {
+			rcam_stats_t stats;
+			rcam_receiver_stats(&receiver, &stats);
+			printf("frames %llu dropped %llu late %llu lost %llu | %llu kB/s "
+				   "latency %llu us (avg %llu) jitter %llu us delay %llu us\n",
+				   (unsigned long long) stats.frames_received,
+				   (unsigned long long) stats.frames_dropped,
+				   (unsigned long long) stats.frames_late,
+				   (unsigned long long) stats.fragments_lost,
+				   (unsigned long long) bytes / 1000,
+				   (unsigned long long) stats.latency_us,
+				   (unsigned long long) stats.latency_avg_us,
+				   (unsigned long long) stats.jitter_us,
+				   (unsigned long long) stats.delay_us);
+			bytes = 0;
+			next += 1000000;
+		}
+	}
+
+	rcam_receiver_free(&receiver);
+
+	return 0;
+}
+
+int main(int argc, char** argv) {
+	if(argc < 3 || (strcmp(argv[1], "send") == 0 && argc < 7)) {
+		fprintf(stderr,
+				"usage: %s recv <port>\n"
+				"       %s send <ip> <port> <fps> <kbit/s> <files...>\n",
+				argv[0], argv[0]);
+		return -1;
+	}
+
+	if(rsoc_init() < 0) {
+		fprintf(stderr, "failed to initialize rsoc.\n");
+		return -1;
+	}
+
+	if(strcmp(argv[1], "recv") == 0) {
+		return _recv(atoi(argv[2]));
+	}
+	else if(strcmp(argv[1], "send") == 0) {
+		return _send(argv[2], atoi(argv[3]), atoi(argv[4]), atoi(argv[5]),
+					 argc - 6, argv + 6);
+	}
+
+	return -1;
+}
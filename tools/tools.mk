@@ -0,0 +1,16 @@
+CFLAGS_TOOLS	=	-Wall -pedantic -std=c11 -Iinclude -g -O0 -DWINDOWS -DINPT_STATIC
+LIBS_TOOLS		=	-lws2_32
+
+SRC_TOOLS	   := $(wildcard tools/*.c)
+SRC_RSOC	   := $(wildcard src/rsoc*.c) $(wildcard src/rcam*.c) src/debug.c
+
+.PHONY: tools
+
+# the tools link the rsoc and rcam sources directly as they aren't exported
+# from the dll, and debug.c for the metrics rsoc records. INPT_STATIC keeps
+# debug.h from importing what they link in.
+tools: $(patsubst tools/%.c,bin/%.exe,$(SRC_TOOLS))
+
+bin/%.exe: tools/%.c $(SRC_RSOC)
+	-mkdir bin
+	$(CC) $(CFLAGS_TOOLS) $< $(SRC_RSOC) $(LIBS_TOOLS) -o $@
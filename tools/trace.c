@@ -0,0 +1,238 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "debug.h"
+
+// Turns a binary profiler trace, written by debug_trace_write or at exit by
+// debug_trace_start, into chrome trace event json for chrome://tracing or
+// ui.perfetto.dev. "trace run.bin run.json".
+
+typedef struct trace_zone_t {
+	int	  kind;
+	char* name;
+	char* file;
+	int	  line;
+} trace_zone_t;
+
+static int _read_u8(FILE* file, uint8_t* value) {
+	int c = fgetc(file);
+	if(c == EOF) {
+		return -1;
+	}
+
+	*value = (uint8_t) c;
+	return 0;
+}
+
+static int _read_u16(FILE* file, uint16_t* value) {
+	uint8_t bytes[2];
+	if(fread(bytes, 1, 2, file) != 2) {
+		return -1;
+	}
+
+	*value = bytes[0] | bytes[1] << 8;
+	return 0;
+}
+
+static int _read_u32(FILE* file, uint32_t* value) {
+	uint16_t low, high;
+	if(_read_u16(file, &low) < 0 || _read_u16(file, &high) < 0) {
+		return -1;
+	}
+
+	*value = low | (uint32_t) high << 16;
+	return 0;
+}
+
+static int _read_u64(FILE* file, uint64_t* value) {
+	uint32_t low, high;
+	if(_read_u32(file, &low) < 0 || _read_u32(file, &high) < 0) {
+		return -1;
+	}
+
+	*value = low | (uint64_t) high << 32;
+	return 0;
+}
+
+// Reads a length prefixed string, NULL on a truncated file.
+static char* _read_str(FILE* file) {
+	uint16_t length;
+	if(_read_u16(file, &length) < 0) {
+		return NULL;
+	}
+
+	char* str = malloc(length + 1);
+	if(str == NULL || fread(str, 1, length, file) != length) {
+		free(str);
+		return NULL;
+	}
+	str[length] = '\0';
+
+	return str;
+}
+
+static void _write_str(FILE* file, const char* str) {
+	fputc('"', file);
+	for(; *str != '\0'; str++) {
+		if(*str == '"' || *str == '\\') {
+			fputc('\\', file);
+			fputc(*str, file);
+		}
+		else if((unsigned char) *str < 0x20) {
+			fprintf(file, "\\u%04x", *str);
+		}
+		else {
+			fputc(*str, file);
+		}
+	}
+	fputc('"', file);
+}
+
+static int _convert(FILE* in, FILE* out) {
+	char	 magic[4];
+	uint32_t version;
+	uint64_t ticks_per_s;
+
+	if(fread(magic, 1, 4, in) != 4 ||
+	   memcmp(magic, DEBUG_TRACE_MAGIC, 4) != 0) {
+		fprintf(stderr, "not a trace.\n");
+		return -1;
+	}
+	if(_read_u32(in, &version) < 0 || version != DEBUG_TRACE_VERSION) {
+		fprintf(stderr, "unsupported trace version.\n");
+		return -1;
+	}
+	if(_read_u64(in, &ticks_per_s) < 0 || ticks_per_s == 0) {
+		fprintf(stderr, "truncated trace.\n");
+		return -1;
+	}
+	double us_per_tick = 1000000.0 / ticks_per_s;
+
+	uint32_t zone_count;
+	if(_read_u32(in, &zone_count) < 0 || zone_count > DEBUG_PROF_ZONE_MAX) {
+		fprintf(stderr, "bad zone count.\n");
+		return -1;
+	}
+
+	trace_zone_t zones[DEBUG_PROF_ZONE_MAX] = {0};
+	int			 ret					   = -1;
+	for(uint32_t i = 0; i < zone_count; i++) {
+		uint8_t	 kind;
+		uint32_t line;
+		if(_read_u8(in, &kind) < 0 ||
+		   (zones[i].name = _read_str(in)) == NULL ||
+		   (zones[i].file = _read_str(in)) == NULL ||
+		   _read_u32(in, &line) < 0) {
+			fprintf(stderr, "truncated zone table.\n");
+			goto end;
+		}
+		zones[i].kind = kind;
+		zones[i].line = (int) line;
+	}
+
+	fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n", out);
+
+	uint32_t thread_count;
+	if(_read_u32(in, &thread_count) < 0) {
+		fprintf(stderr, "truncated thread table.\n");
+		goto end;
+	}
+	for(uint32_t i = 0; i < thread_count; i++) {
+		char* name = _read_str(in);
+		if(name == NULL) {
+			fprintf(stderr, "truncated thread table.\n");
+			goto end;
+		}
+
+		if(name[0] != '\0') {
+			fprintf(out,
+					"{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,"
+					"\"tid\":%u,\"args\":{\"name\":",
+					i);
+			_write_str(out, name);
+			fputs("}},\n", out);
+		}
+		free(name);
+	}
+
+	uint64_t event_count;
+	if(_read_u64(in, &event_count) < 0) {
+		fprintf(stderr, "truncated trace.\n");
+		goto end;
+	}
+	for(uint64_t i = 0; i < event_count; i++) {
+		uint64_t start;
+		uint32_t duration;
+		uint16_t zone;
+		uint8_t	 depth, thread;
+		if(_read_u64(in, &start) < 0 || _read_u32(in, &duration) < 0 ||
+		   _read_u16(in, &zone) < 0 || _read_u8(in, &depth) < 0 ||
+		   _read_u8(in, &thread) < 0) {
+			fprintf(stderr, "truncated after %llu events.\n",
+					(unsigned long long) i);
+			break;
+		}
+		if(zone >= zone_count) {
+			continue;
+		}
+
+		fputs("{\"name\":", out);
+		_write_str(out, zones[zone].name);
+		if(zones[zone].kind == DEBUG_ZONE_MARK) {
+			fprintf(out, ",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f",
+					start * us_per_tick);
+		}
+		else {
+			fprintf(out, ",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f",
+					start * us_per_tick, duration * us_per_tick);
+		}
+		fprintf(out, ",\"pid\":1,\"tid\":%u,\"args\":{\"file\":", thread);
+		_write_str(out, zones[zone].file);
+		fprintf(out, ",\"line\":%i}},\n", zones[zone].line);
+	}
+
+	// closes the list without a trailing comma on the last event.
+	fputs("{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":1,"
+		  "\"args\":{\"name\":\"trace\"}}\n]}\n",
+		  out);
+	ret = 0;
+
+end:
+	for(uint32_t i = 0; i < zone_count; i++) {
+		free(zones[i].name);
+		free(zones[i].file);
+	}
+
+	return ret;
+}
+
+int main(int argc, char** argv) {
+	if(argc < 3) {
+		fprintf(stderr, "usage: %s <in.bin> <out.json>\n", argv[0]);
+		return -1;
+	}
+
+	FILE* in = fopen(argv[1], "rb");
+	if(in == NULL) {
+		fprintf(stderr, "failed to open %s.\n", argv[1]);
+		return -1;
+	}
+
+	FILE* out = fopen(argv[2], "w");
+	if(out == NULL) {
+		fprintf(stderr, "failed to open %s.\n", argv[2]);
+		fclose(in);
+		return -1;
+	}
+
+	int ret = _convert(in, out);
+
+	fclose(in);
+	if(fclose(out) != 0) {
+		ret = -1;
+	}
+
+	return ret;
+}